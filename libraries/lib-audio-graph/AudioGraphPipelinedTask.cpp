@@ -0,0 +1,539 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file AudioGraphPipelinedTask.cpp
+
+**********************************************************************/
+#include "AudioGraphPipelinedTask.h"
+#include "AudioGraphBuffers.h"
+#include "AudioGraphSink.h"
+#include "AudioGraphSource.h"
+#include "AudioGraphTask.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+using namespace AudioGraph;
+using Clock = std::chrono::steady_clock;
+
+struct Counters {
+   std::atomic<long long> samples{ 0 };
+   std::atomic<long long> busy{ 0 };
+   std::atomic<long long> waiting{ 0 };
+};
+
+//! One block of samples in transit between stages
+struct Slot {
+   enum class Kind { Data, End };
+
+   Slot(unsigned nChannels, size_t blockSize)
+      : buffers{ nChannels, blockSize, 1 }
+   {}
+
+   const float *Read(unsigned iChannel) const
+   {
+      return reinterpret_cast<const float*>(buffers.GetReadPosition(iChannel));
+   }
+   float *Write(unsigned iChannel)
+   {
+      return &buffers.GetWritePosition(iChannel);
+   }
+
+   Buffers buffers;
+   Kind kind{ Kind::Data };
+   size_t count{ 0 };
+   //! Of the producing source, from the first sample of this slot
+   sampleCount remaining{ 0 };
+};
+
+//! Wakes a thread that waits for either of two queues
+class Doorbell {
+public:
+   long long Count()
+   {
+      auto lock = std::lock_guard{ mMutex };
+      return mCount;
+   }
+
+   void Ring()
+   {
+      {
+         auto lock = std::lock_guard{ mMutex };
+         ++mCount;
+      }
+      mCondition.notify_one();
+   }
+
+   //! Block until rung, if not rung since Count() returned `count`
+   void Wait(long long count, std::atomic<long long> &waiting)
+   {
+      auto lock = std::unique_lock{ mMutex };
+      if (mCount != count)
+         return;
+      const auto start = Clock::now();
+      mCondition.wait(lock, [&]{ return mCount != count; });
+      waiting += std::chrono::duration_cast<std::chrono::nanoseconds>(
+         Clock::now() - start).count();
+   }
+
+private:
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+   long long mCount{ 0 };
+};
+
+//! Bounded single producer, single consumer queue of slots
+/*! Capacity is fixed at construction, so pushing and popping never
+ allocate */
+class SlotQueue {
+public:
+   explicit SlotQueue(size_t capacity) : mRing(capacity) {}
+
+   //! Also ring the doorbell after each push, and when closed
+   void SetDoorbell(Doorbell &doorbell)
+   {
+      mpDoorbell = &doorbell;
+   }
+
+   //! Whether a pop would not block
+   bool Ready()
+   {
+      auto lock = std::lock_guard{ mMutex };
+      return mClosed || mSize > 0;
+   }
+
+   //! Block while full
+   /*! @return false if closed */
+   bool Push(Slot &slot, std::atomic<long long> &waiting)
+   {
+      auto lock = std::unique_lock{ mMutex };
+      Wait(lock, waiting, [this]{ return mClosed || mSize < mRing.size(); });
+      if (mClosed)
+         return false;
+      mRing[(mHead + mSize++) % mRing.size()] = &slot;
+      lock.unlock();
+      mCondition.notify_one();
+      if (mpDoorbell)
+         mpDoorbell->Ring();
+      return true;
+   }
+
+   //! Block while empty
+   /*! @return null if closed */
+   Slot *Pop(std::atomic<long long> &waiting)
+   {
+      auto lock = std::unique_lock{ mMutex };
+      Wait(lock, waiting, [this]{ return mClosed || mSize > 0; });
+      if (mClosed)
+         return nullptr;
+      const auto result = mRing[mHead];
+      mHead = (mHead + 1) % mRing.size();
+      --mSize;
+      lock.unlock();
+      mCondition.notify_one();
+      return result;
+   }
+
+   //! Wake and fail all pushes and pops, now and later
+   void Close()
+   {
+      {
+         auto lock = std::lock_guard{ mMutex };
+         mClosed = true;
+      }
+      mCondition.notify_all();
+      if (mpDoorbell)
+         mpDoorbell->Ring();
+   }
+
+private:
+   template<typename Predicate> void Wait(std::unique_lock<std::mutex> &lock,
+      std::atomic<long long> &waiting, const Predicate &predicate)
+   {
+      if (predicate())
+         return;
+      const auto start = Clock::now();
+      mCondition.wait(lock, predicate);
+      waiting += std::chrono::duration_cast<std::chrono::nanoseconds>(
+         Clock::now() - start).count();
+   }
+
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+   Doorbell *mpDoorbell{};
+   // Guarded by mMutex
+   std::vector<Slot*> mRing;
+   size_t mHead{ 0 };
+   size_t mSize{ 0 };
+   bool mClosed{ false };
+};
+
+//! Connects two stages; the producer takes empty slots from `vacant` and
+//! passes them filled through `filled`, and the consumer returns them
+struct Link {
+   Link(unsigned nChannels, size_t blockSize, size_t depth)
+      : nChannels{ nChannels }, vacant{ depth }, filled{ depth }
+   {
+      // Reserve, so that the addresses of slots are stable
+      slots.reserve(depth);
+      for (size_t ii = 0; ii < depth; ++ii)
+         slots.emplace_back(nChannels, blockSize);
+      for (auto &slot : slots) {
+         std::atomic<long long> unused{ 0 };
+         vacant.Push(slot, unused);
+      }
+   }
+
+   void Close()
+   {
+      vacant.Close();
+      filled.Close();
+   }
+
+   const unsigned nChannels;
+   std::vector<Slot> slots;
+   SlotQueue vacant;
+   SlotQueue filled;
+};
+
+//! Copies what a Task releases to it into a link
+class LinkSink final : public Sink {
+public:
+   LinkSink(Link &link, const Source &source, Counters &counters)
+      : mLink{ link }, mSource{ source }, mCounters{ counters }
+   {}
+
+   bool AcceptsBuffers(const Buffers &buffers) const override
+   {
+      return buffers.Channels() == mLink.nChannels;
+   }
+
+   bool Acquire(Buffers &data) override
+   {
+      // Everything before the position was copied out already, but the
+      // source may have fetched ahead of it
+      if (data.Remaining() < data.BlockSize())
+         data.Rotate();
+      return true;
+   }
+
+   bool Release(const Buffers &data, size_t curBlockSize) override
+   {
+      assert(AcceptsBuffers(data));
+      const auto pSlot = mLink.vacant.Pop(mCounters.waiting);
+      if (!pSlot)
+         return false;
+      auto &slot = *pSlot;
+      assert(curBlockSize <= slot.buffers.BlockSize());
+      const auto positions = data.Positions();
+      for (unsigned iChannel = 0; iChannel < mLink.nChannels; ++iChannel)
+         std::copy(positions[iChannel], positions[iChannel] + curBlockSize,
+            slot.Write(iChannel));
+      slot.kind = Slot::Kind::Data;
+      slot.count = curBlockSize;
+      // Source::Remaining() still counts what was Acquire()d
+      slot.remaining = mSource.Remaining();
+      mCounters.samples += curBlockSize;
+      return mLink.filled.Push(slot, mCounters.waiting);
+   }
+
+   //! Mark the end of the stream
+   bool Finish()
+   {
+      const auto pSlot = mLink.vacant.Pop(mCounters.waiting);
+      if (!pSlot)
+         return false;
+      pSlot->kind = Slot::Kind::End;
+      pSlot->count = 0;
+      pSlot->remaining = 0;
+      return mLink.filled.Push(*pSlot, mCounters.waiting);
+   }
+
+private:
+   Link &mLink;
+   const Source &mSource;
+   Counters &mCounters;
+};
+
+//! Produces what a link delivers, in pieces of any size
+class LinkSource final : public Source {
+public:
+   //! @param countSamples whether to count what is released, if this feeds
+   //! the last stage
+   //! @param oneSlot whether each Acquire() takes no more than one slot,
+   //! so that it does not block if one is ready
+   LinkSource(Link &link, Counters &counters, bool countSamples, bool oneSlot)
+      : mLink{ link }, mCounters{ counters }, mCountSamples{ countSamples }
+      , mOneSlot{ oneSlot }
+   {}
+
+   bool AcceptsBuffers(const Buffers &buffers) const override
+   {
+      return buffers.Channels() == mLink.nChannels;
+   }
+
+   bool AcceptsBlockSize(size_t) const override
+   {
+      return true;
+   }
+
+   std::optional<size_t> Acquire(Buffers &data, size_t bound) override
+   {
+      assert(AcceptsBuffers(data));
+      assert(bound <= data.BlockSize());
+      assert(data.BlockSize() <= data.Remaining());
+      size_t produced = 0;
+      while (produced < bound && !mEnded) {
+         if (!mpSlot) {
+            if (mOneSlot && produced > 0)
+               break;
+            if (!(mpSlot = mLink.filled.Pop(mCounters.waiting)))
+               return {};
+            mOffset = 0;
+            mRemaining = mpSlot->remaining + produced;
+            if (mpSlot->kind == Slot::Kind::End) {
+               mEnded = true;
+               break;
+            }
+         }
+         auto &slot = *mpSlot;
+         const auto count = std::min(bound - produced, slot.count - mOffset);
+         for (unsigned iChannel = 0; iChannel < mLink.nChannels; ++iChannel) {
+            const auto from = slot.Read(iChannel) + mOffset;
+            std::copy(from, from + count,
+               &data.GetWritePosition(iChannel) + produced);
+         }
+         produced += count;
+         mOffset += count;
+         if (mOffset == slot.count) {
+            // Copied out, so recycle at once
+            mpSlot = nullptr;
+            if (!mLink.vacant.Push(slot, mCounters.waiting))
+               return {};
+         }
+      }
+      mLastProduced = produced;
+      return { produced };
+   }
+
+   sampleCount Remaining() const override
+   {
+      return mRemaining;
+   }
+
+   bool Release() override
+   {
+      mRemaining -= mLastProduced;
+      if (mCountSamples)
+         mCounters.samples += mLastProduced;
+      mLastProduced = 0;
+      return true;
+   }
+
+private:
+   Link &mLink;
+   Counters &mCounters;
+   const bool mCountSamples;
+   const bool mOneSlot;
+   Slot *mpSlot{};
+   size_t mOffset{ 0 };
+   size_t mLastProduced{ 0 };
+   sampleCount mRemaining{ 0 };
+   bool mEnded{ false };
+};
+}
+
+struct AudioGraph::PipelinedTask::Impl {
+   Impl(Source &upstream, Buffers &inBuffers, const StageFactory &makeStage,
+      Buffers &outBuffers, Sink &sink, size_t queueDepth, Threading threading)
+      : mThreading{ threading }
+      , mUpstream{ upstream }
+      , mReadBuffers{ inBuffers.Channels(), inBuffers.BlockSize(),
+         inBuffers.BufferSize() / inBuffers.BlockSize() }
+      , mProcessBuffers{ outBuffers.Channels(), outBuffers.BlockSize(),
+         outBuffers.BufferSize() / outBuffers.BlockSize() }
+      , mOutBuffers{ outBuffers }
+      , mSink{ sink }
+      , mInputLink{ inBuffers.Channels(), inBuffers.BlockSize(), queueDepth }
+      , mOutputLink{
+         outBuffers.Channels(), outBuffers.BlockSize(), queueDepth }
+      , mInputSink{ mInputLink, upstream, mCounters[0] }
+      , mInputSource{ mInputLink, mCounters[1], false, false }
+      , mpStage{ makeStage(mInputSource, inBuffers) }
+      , mOutputSource{ mOutputLink, mCounters[2], true,
+         threading == Threading::ProcessOnly }
+   {
+      assert(queueDepth > 0);
+      if (mpStage)
+         mOutputSink.emplace(mOutputLink, *mpStage, mCounters[1]);
+      if (threading == Threading::ProcessOnly) {
+         // Wake the calling thread for either end of the stage
+         mInputLink.vacant.SetDoorbell(mDoorbell);
+         mOutputLink.filled.SetDoorbell(mDoorbell);
+      }
+   }
+
+   //! Read and write by turns on one thread, with no blocking on either
+   //! queue while the other could proceed
+   bool ReadAndWrite()
+   {
+      Task readTask{ mUpstream, mReadBuffers, mInputSink };
+      Task writeTask{ mOutputSource, mOutBuffers, mSink };
+      // As Task::RunLoop() does
+      mReadBuffers.Rewind();
+      mOutBuffers.Rewind();
+      bool reading = true, finishing = false;
+      while (true) {
+         const auto count = mDoorbell.Count();
+         bool progressed = false;
+         // Each RunOnce() pops at most one slot, so it does not block if the
+         // queue is ready
+         if ((reading || finishing) && mInputLink.vacant.Ready()) {
+            progressed = true;
+            if (finishing) {
+               if (!mInputSink.Finish())
+                  return false;
+               finishing = false;
+            }
+            else switch (readTask.RunOnce()) {
+            case Task::Status::More:
+               break;
+            case Task::Status::Done:
+               reading = false;
+               finishing = true;
+               break;
+            default:
+               return false;
+            }
+         }
+         if (mOutputLink.filled.Ready()) {
+            progressed = true;
+            switch (writeTask.RunOnce()) {
+            case Task::Status::More:
+               break;
+            case Task::Status::Done:
+               return true;
+            default:
+               return false;
+            }
+         }
+         if (!progressed)
+            mDoorbell.Wait(count, mCounters[0].waiting);
+      }
+   }
+
+   //! Run one stage; close the links on failure
+   template<typename Body> void Run(size_t iStage, const Body &body)
+   {
+      const auto start = Clock::now();
+      bool ok = false;
+      try {
+         ok = body();
+      }
+      catch (...) {
+         auto lock = std::lock_guard{ mExceptionMutex };
+         if (!mException)
+            mException = std::current_exception();
+      }
+      if (!ok) {
+         mFailed = true;
+         mInputLink.Close();
+         mOutputLink.Close();
+      }
+      auto &counters = mCounters[iStage];
+      counters.busy = std::chrono::duration_cast<std::chrono::nanoseconds>(
+         Clock::now() - start).count() - counters.waiting;
+   }
+
+   const Threading mThreading;
+   Source &mUpstream;
+   Buffers mReadBuffers;
+   Buffers mProcessBuffers;
+   Buffers &mOutBuffers;
+   Sink &mSink;
+
+   Counters mCounters[3];
+   Doorbell mDoorbell;
+   Link mInputLink;
+   Link mOutputLink;
+   LinkSink mInputSink;
+   LinkSource mInputSource;
+   std::unique_ptr<Source> mpStage;
+   std::optional<LinkSink> mOutputSink;
+   LinkSource mOutputSource;
+
+   std::atomic<bool> mFailed{ false };
+   std::mutex mExceptionMutex;
+   std::exception_ptr mException;
+};
+
+AudioGraph::PipelinedTask::PipelinedTask(Source &upstream, Buffers &inBuffers,
+   const StageFactory &makeStage, Buffers &outBuffers, Sink &sink,
+   size_t queueDepth, Threading threading)
+   : mpImpl{ std::make_unique<Impl>(upstream, inBuffers, makeStage,
+      outBuffers, sink, queueDepth, threading) }
+{
+   assert(inBuffers.BlockSize() == outBuffers.BlockSize());
+   assert(upstream.AcceptsBlockSize(inBuffers.BlockSize()));
+   assert(upstream.AcceptsBuffers(inBuffers));
+   assert(sink.AcceptsBuffers(outBuffers));
+}
+
+AudioGraph::PipelinedTask::~PipelinedTask() = default;
+
+bool AudioGraph::PipelinedTask::IsOk() const
+{
+   return mpImpl->mpStage != nullptr;
+}
+
+bool AudioGraph::PipelinedTask::RunLoop()
+{
+   assert(IsOk());
+   auto &impl = *mpImpl;
+
+   std::thread processThread{ [&impl]{
+      impl.Run(1, [&impl]{
+         Task task{ *impl.mpStage, impl.mProcessBuffers, *impl.mOutputSink };
+         return task.RunLoop() && impl.mOutputSink->Finish();
+      });
+   } };
+   if (impl.mThreading == Threading::All) {
+      std::thread writeThread{ [&impl]{
+         impl.Run(2, [&impl]{
+            Task task{ impl.mOutputSource, impl.mOutBuffers, impl.mSink };
+            return task.RunLoop();
+         });
+      } };
+      impl.Run(0, [&impl]{
+         Task task{ impl.mUpstream, impl.mReadBuffers, impl.mInputSink };
+         return task.RunLoop() && impl.mInputSink.Finish();
+      });
+      writeThread.join();
+   }
+   else
+      impl.Run(0, [&impl]{ return impl.ReadAndWrite(); });
+
+   processThread.join();
+   if (impl.mException)
+      std::rethrow_exception(impl.mException);
+   return !impl.mFailed;
+}
+
+auto AudioGraph::PipelinedTask::GetStatistics(Stage stage) const -> Statistics
+{
+   const auto &counters = mpImpl->mCounters[static_cast<unsigned>(stage)];
+   return {
+      counters.samples.load(),
+      std::chrono::nanoseconds{ counters.busy.load() },
+      std::chrono::nanoseconds{ counters.waiting.load() }
+   };
+}
@@ -0,0 +1,105 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file AudioGraphPipelinedTask.h
+
+**********************************************************************/
+#ifndef __AUDACITY_AUDIO_GRAPH_PIPELINED_TASK__
+#define __AUDACITY_AUDIO_GRAPH_PIPELINED_TASK__
+
+#include "SampleCount.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace AudioGraph {
+class Buffers;
+class Sink;
+class Source;
+
+//! Like Task, but reads, processes and writes on up to three threads at once
+/*!
+ The upstream source runs on the calling thread of RunLoop(), so that any
+ polling of progress it does stays there.  The processing stage runs on a
+ thread of its own, and so does the sink, unless it shares the calling thread
+ with the source.  Adjacent stages are connected by bounded single producer,
+ single consumer queues of blocks, all allocated at construction.  Each stage
+ is driven by a Task over Buffers of its own, so sources and sinks see the
+ same sequence of calls as without the pipeline.
+
+ If any stage fails or throws, the queues are closed so that the others stop
+ too, and RunLoop() returns false or rethrows the first exception.
+ */
+class AUDIO_GRAPH_API PipelinedTask {
+public:
+   //! Makes the processing stage, which pulls from `upstream` into `inBuffers`
+   /*! May return null to fail */
+   using StageFactory = std::function<
+      std::unique_ptr<Source>(Source &upstream, Buffers &inBuffers)>;
+
+   //! Stages, in order downstream
+   enum class Stage : unsigned { Read, Process, Write };
+
+   //! Which stages have threads of their own
+   enum class Threading {
+      //! Read, Process and Write each have one
+      All,
+      //! Only Process; Read and Write take turns on the calling thread, as
+      //! they must when the sink writes the sequence that the source reads
+      ProcessOnly,
+   };
+
+   //! Throughput of one stage
+   struct Statistics {
+      //! Passed to the next queue, or to the sink
+      sampleCount samples{ 0 };
+      //! Time running, less time blocked on the queues
+      std::chrono::nanoseconds busy{};
+      //! Time blocked on the queues
+      std::chrono::nanoseconds waiting{};
+   };
+
+   static constexpr size_t DefaultQueueDepth = 4;
+
+   /*!
+    Invokes `makeStage` on the calling thread.
+
+    @param inBuffers given to the stage; the upstream source fills other
+    buffers of the same shape
+    @param queueDepth how many blocks each queue holds
+
+    @pre `inBuffers.BlockSize() == outBuffers.BlockSize()`
+    @pre `upstream.AcceptsBlockSize(inBuffers.BlockSize())`
+    @pre `upstream.AcceptsBuffers(inBuffers)`
+    @pre `sink.AcceptsBuffers(outBuffers)`
+    @pre `queueDepth > 0`
+    */
+   PipelinedTask(Source &upstream, Buffers &inBuffers,
+      const StageFactory &makeStage, Buffers &outBuffers, Sink &sink,
+      size_t queueDepth = DefaultQueueDepth,
+      Threading threading = Threading::All);
+   ~PipelinedTask();
+
+   //! Whether the stage was made
+   bool IsOk() const;
+
+   //! Do the complete copy
+   /*!
+    @return success
+    @pre `IsOk()`
+    */
+   bool RunLoop();
+
+   //! May be called during RunLoop() from another thread; `busy` is updated
+   //! only as each stage ends
+   /*! With Threading::ProcessOnly, the Read stage is busy for the time of
+    Write too */
+   Statistics GetStatistics(Stage stage) const;
+
+private:
+   struct Impl;
+   std::unique_ptr<Impl> mpImpl;
+};
+}
+#endif
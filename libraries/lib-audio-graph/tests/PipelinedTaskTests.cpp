@@ -0,0 +1,257 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PipelinedTaskTests.cpp
+
+**********************************************************************/
+#include "AudioGraphBuffers.h"
+#include "AudioGraphPipelinedTask.h"
+#include "AudioGraphSink.h"
+#include "AudioGraphSource.h"
+#include "AudioGraphTask.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+using namespace AudioGraph;
+
+//! Produces a ramp, in pieces of irregular sizes
+class RampSource final : public Source {
+public:
+   RampSource(unsigned nChannels, size_t length)
+      : mnChannels{ nChannels }, mRemaining{ length }
+   {}
+
+   bool AcceptsBuffers(const Buffers &buffers) const override
+   {
+      return buffers.Channels() == mnChannels;
+   }
+   bool AcceptsBlockSize(size_t) const override { return true; }
+
+   std::optional<size_t> Acquire(Buffers &data, size_t bound) override
+   {
+      // Sometimes short of the bound
+      const auto result = std::min<size_t>(
+         { bound, mRemaining, 1 + (mNext * 7) % bound });
+      for (unsigned iChannel = 0; iChannel < mnChannels; ++iChannel) {
+         const auto p = &data.GetWritePosition(iChannel);
+         for (size_t ii = 0; ii < result; ++ii)
+            p[ii] = (mNext + ii) + 0.5f * iChannel;
+      }
+      mLastProduced = result;
+      return { result };
+   }
+
+   sampleCount Remaining() const override { return mRemaining; }
+
+   bool Release() override
+   {
+      mNext += mLastProduced;
+      mRemaining -= mLastProduced;
+      mLastProduced = 0;
+      return true;
+   }
+
+private:
+   const unsigned mnChannels;
+   size_t mRemaining;
+   size_t mNext{ 0 };
+   size_t mLastProduced{ 0 };
+};
+
+//! Pulls full blocks from upstream through its own buffers, and doubles them
+class DoublingStage final : public Source {
+public:
+   DoublingStage(Source &upstream, Buffers &inBuffers)
+      : mUpstream{ upstream }, mInBuffers{ inBuffers }
+   {
+      mInBuffers.Rewind();
+   }
+
+   bool AcceptsBuffers(const Buffers &) const override { return true; }
+   bool AcceptsBlockSize(size_t) const override { return true; }
+
+   std::optional<size_t> Acquire(Buffers &data, size_t bound) override
+   {
+      // Fill the block, as EffectStage expects of its upstream
+      size_t result = 0;
+      while (result < bound) {
+         const auto oCount = mUpstream.Acquire(mInBuffers, bound - result);
+         if (!oCount)
+            return {};
+         if (*oCount == 0)
+            break;
+         for (unsigned iChannel = 0; iChannel < data.Channels(); ++iChannel) {
+            const auto from = mInBuffers.Positions()[iChannel];
+            std::transform(from, from + *oCount,
+               &data.GetWritePosition(iChannel) + result,
+               [](float x){ return 2 * x; });
+         }
+         result += *oCount;
+         if (!mUpstream.Release())
+            return {};
+         mInBuffers.Advance(*oCount);
+         if (mInBuffers.Remaining() < mInBuffers.BlockSize())
+            mInBuffers.Rotate();
+      }
+      mLastProduced = result;
+      return { result };
+   }
+
+   sampleCount Remaining() const override
+   {
+      return mLastProduced + mUpstream.Remaining();
+   }
+
+   bool Release() override
+   {
+      mLastProduced = 0;
+      return true;
+   }
+
+   bool Terminates() const override { return false; }
+
+private:
+   Source &mUpstream;
+   Buffers &mInBuffers;
+   size_t mLastProduced{ 0 };
+};
+
+class CollectingSink final : public Sink {
+public:
+   explicit CollectingSink(unsigned nChannels, size_t failAfter = SIZE_MAX)
+      : mSamples(nChannels), mFailAfter{ failAfter }
+   {}
+
+   bool AcceptsBuffers(const Buffers &buffers) const override
+   {
+      return buffers.Channels() == mSamples.size();
+   }
+
+   bool Acquire(Buffers &data) override
+   {
+      data.Rewind();
+      return true;
+   }
+
+   bool Release(const Buffers &data, size_t curBlockSize) override
+   {
+      if (std::this_thread::get_id() != mThread)
+         mOnOtherThread = true;
+      if (mSamples[0].size() + curBlockSize > mFailAfter)
+         return false;
+      for (unsigned iChannel = 0; iChannel < mSamples.size(); ++iChannel) {
+         const auto from = data.Positions()[iChannel];
+         mSamples[iChannel].insert(
+            mSamples[iChannel].end(), from, from + curBlockSize);
+      }
+      return true;
+   }
+
+   std::vector<std::vector<float>> mSamples;
+   const size_t mFailAfter;
+   const std::thread::id mThread{ std::this_thread::get_id() };
+   bool mOnOtherThread{ false };
+};
+
+std::vector<std::vector<float>> RunSerially(
+   unsigned nChannels, size_t blockSize, size_t length)
+{
+   RampSource source{ nChannels, length };
+   Buffers inBuffers{ nChannels, blockSize, 4 };
+   DoublingStage stage{ source, inBuffers };
+   Buffers outBuffers{ nChannels, blockSize, 1 };
+   CollectingSink sink{ nChannels };
+   Task task{ stage, outBuffers, sink };
+   REQUIRE(task.RunLoop());
+   return sink.mSamples;
+}
+
+PipelinedTask::StageFactory Doubling()
+{
+   return [](Source &upstream, Buffers &inBuffers) {
+      return std::make_unique<DoublingStage>(upstream, inBuffers);
+   };
+}
+}
+
+TEST_CASE("PipelinedTask produces what Task does", "[PipelinedTask]")
+{
+   using Threading = PipelinedTask::Threading;
+   for (auto threading : { Threading::All, Threading::ProcessOnly })
+   for (unsigned nChannels : { 1, 2 })
+   for (size_t blockSize : { 1, 5, 512 })
+   for (size_t length : { 0, 1, 511, 10000 })
+   for (size_t depth : { 1, 4 }) {
+      RampSource source{ nChannels, length };
+      Buffers inBuffers{ nChannels, blockSize, 4 };
+      Buffers outBuffers{ nChannels, blockSize, 1 };
+      CollectingSink sink{ nChannels };
+      PipelinedTask task{
+         source, inBuffers, Doubling(), outBuffers, sink, depth, threading };
+      REQUIRE(task.IsOk());
+      REQUIRE(task.RunLoop());
+      REQUIRE(sink.mSamples == RunSerially(nChannels, blockSize, length));
+      // The sink may write what the source reads only if on the same thread
+      if (threading == Threading::ProcessOnly)
+         REQUIRE(!sink.mOnOtherThread);
+
+      for (auto stage : { PipelinedTask::Stage::Read,
+         PipelinedTask::Stage::Process, PipelinedTask::Stage::Write })
+         REQUIRE(task.GetStatistics(stage).samples == length);
+   }
+}
+
+TEST_CASE("PipelinedTask stops all stages on failure", "[PipelinedTask]")
+{
+   using Threading = PipelinedTask::Threading;
+   for (auto threading : { Threading::All, Threading::ProcessOnly }) {
+      RampSource source{ 2, 100000 };
+      Buffers inBuffers{ 2, 64, 4 };
+      Buffers outBuffers{ 2, 64, 1 };
+      CollectingSink sink{ 2, 1000 };
+      PipelinedTask task{
+         source, inBuffers, Doubling(), outBuffers, sink, 2, threading };
+      REQUIRE(!task.RunLoop());
+      REQUIRE(sink.mSamples[0].size() <= 1000);
+      REQUIRE(task.GetStatistics(PipelinedTask::Stage::Read).samples < 100000);
+   }
+}
+
+TEST_CASE("PipelinedTask rethrows from a stage", "[PipelinedTask]")
+{
+   RampSource source{ 1, 100000 };
+   Buffers inBuffers{ 1, 64, 4 };
+   Buffers outBuffers{ 1, 64, 1 };
+   CollectingSink sink{ 1 };
+   struct ThrowingStage final : Source {
+      bool AcceptsBuffers(const Buffers &) const override { return true; }
+      bool AcceptsBlockSize(size_t) const override { return true; }
+      std::optional<size_t> Acquire(Buffers &, size_t) override
+      { throw std::runtime_error{ "stage" }; }
+      sampleCount Remaining() const override { return 1; }
+      bool Release() override { return true; }
+   };
+   PipelinedTask task{ source, inBuffers,
+      [](Source &, Buffers &) { return std::make_unique<ThrowingStage>(); },
+      outBuffers, sink };
+   REQUIRE_THROWS_AS(task.RunLoop(), std::runtime_error);
+}
+
+TEST_CASE("PipelinedTask fails if the stage is not made", "[PipelinedTask]")
+{
+   RampSource source{ 1, 100 };
+   Buffers inBuffers{ 1, 64, 4 };
+   Buffers outBuffers{ 1, 64, 1 };
+   CollectingSink sink{ 1 };
+   PipelinedTask task{ source, inBuffers,
+      [](Source &, Buffers &) { return nullptr; }, outBuffers, sink };
+   REQUIRE(!task.IsOk());
+}
@@ -70,6 +70,7 @@ time warp info and AudioIOListener and whether the playback is looped.
 #include <math.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <limits>
 #include <numeric>
 #include <optional>
 
@@ -108,6 +109,8 @@ time warp info and AudioIOListener and whether the playback is looped.
 
 #include "Gain.h"
 
+#include "concurrency/ThreadPool.h"
+
 using std::max;
 using std::min;
 
@@ -734,6 +737,13 @@ int AudioIO::StartStream(const TransportSequences &sequences,
 
    gPrefs->Read(wxT("/AudioIO/SWPlaythrough"), &mSoftwarePlaythrough, false);
    mPauseRec = SoundActivatedRecord.Read();
+   mAudioThreadEventDriven.store(
+      AudioIOEventDrivenThread.Read(), std::memory_order_relaxed);
+   mAudioThreadWakeups.store(0, std::memory_order_relaxed);
+   mAudioThreadSignals.store(0, std::memory_order_relaxed);
+   mMinPlaybackFill.store(
+      std::numeric_limits<size_t>::max(), std::memory_order_relaxed);
+   mAudioThreadStatsStart = std::chrono::steady_clock::now();
    gPrefs->Read(wxT("/AudioIO/Microfades"), &mbMicroFades, false);
    int silenceLevelDB;
    gPrefs->Read(wxT("/AudioIO/SilenceLevel"), &silenceLevelDB, -50);
@@ -788,6 +798,7 @@ int AudioIO::StartStream(const TransportSequences &sequences,
    mPlaybackBuffers.clear();
    mScratchBuffers.clear();
    mScratchPointers.clear();
+   mRealtimeWorkerScratch.clear();
    mPlaybackMixers.clear();
    mCaptureBuffers.clear();
    mResample.clear();
@@ -897,6 +908,7 @@ int AudioIO::StartStream(const TransportSequences &sequences,
    // SequenceBufferExchange will ALWAYS get called from the Audio thread.
    mAudioThreadShouldCallSequenceBufferExchangeOnce
       .store(true, std::memory_order_release);
+   mAudioThreadWakeEvent.Signal();
 
    while( mAudioThreadShouldCallSequenceBufferExchangeOnce
       .load(std::memory_order_acquire)) {
@@ -1083,10 +1095,23 @@ bool AudioIO::AllocateBuffers(
             // Adjust mPlaybackRingBufferSecs correspondingly
             mPlaybackRingBufferSecs = PlaybackPolicy::Duration { playbackBufferSize / mRate };
 
+            // FillPlayBuffers makes progress only when it can put
+            // mPlaybackSamplesToCopy, less a small margin for rounding
+            mPlaybackLowWater = playbackBufferSize -
+               std::min(playbackBufferSize, mPlaybackSamplesToCopy + 10);
+
             mPlaybackBuffers.resize(0);
             mProcessingBuffers.resize(0);
             mMasterBuffers.resize(0);
 
+            mPlaybackMixerBufferIndices.clear();
+            size_t nProcessingBuffers = 0;
+            for (const auto &pSequence : mPlaybackSequences) {
+               mPlaybackMixerBufferIndices.push_back(nProcessingBuffers);
+               nProcessingBuffers += pSequence->NChannels();
+            }
+            AllocatePlaybackMixerPool();
+
             // Always make at least one playback buffer, in case of
             // MIDI playback without any audio
             if(mPlaybackSequences.empty())
@@ -1094,11 +1119,7 @@ bool AudioIO::AllocateBuffers(
             else
             {
                mPlaybackBuffers.resize(mNumPlaybackChannels);
-               mProcessingBuffers.resize(std::accumulate(
-                  mPlaybackSequences.begin(),
-                  mPlaybackSequences.end(),
-                  0, [](int n, auto& seq) { return n + seq->NChannels(); }
-               ));
+               mProcessingBuffers.resize(nProcessingBuffers);
                for(auto& buffer : mProcessingBuffers)
                   buffer.reserve(playbackBufferSize);
 
@@ -1106,16 +1127,35 @@ bool AudioIO::AllocateBuffers(
                for(auto& buffer : mMasterBuffers)
                   buffer.reserve(playbackBufferSize);
 
-               // Number of scratch buffers depends on device playback channels
+               // Number of scratch buffers depends on device playback channels,
+               // and each thread of the pool needs its own
                if (mNumPlaybackChannels > 0) {
-                  mScratchBuffers.resize(mNumPlaybackChannels * 2 + 1);
+                  const auto nWorkers = mPlaybackMixerPool->GetConcurrency();
+                  const auto perWorker = mNumPlaybackChannels * 2 + 1;
+                  mScratchBuffers.resize(nWorkers * perWorker);
                   mScratchPointers.clear();
                   for (auto &buffer : mScratchBuffers) {
                      buffer.Allocate(playbackBufferSize, floatSample);
                      mScratchPointers.push_back(
                         reinterpret_cast<float*>(buffer.ptr()));
                   }
+
+                  // Worker 0, which is the Audio thread, uses the same
+                  // scratch buffers as master processing
+                  mRealtimeWorkerScratch.clear();
+                  for (size_t ii = 0; ii < nWorkers; ++ii) {
+                     const auto first = &mScratchPointers[ii * perWorker];
+                     mRealtimeWorkerScratch.push_back({
+                        first,
+                        first + mNumPlaybackChannels + 1,
+                        first[mNumPlaybackChannels]
+                     });
+                  }
                }
+
+               mRealtimeGroupTasks.resize(mPlaybackSequences.size());
+               mRealtimeGroupSequences.resize(mPlaybackSequences.size());
+               mRealtimeGroupBuffers.resize(nProcessingBuffers);
             }
 
             std::generate(
@@ -1204,6 +1244,9 @@ bool AudioIO::AllocateBuffers(
                return false;
             }
 
+            // DrainRecordBuffers waits for this much
+            mCaptureHighWater = lrint(mMinCaptureSecsToCopy * mRate);
+
             mCaptureBuffers.resize(0);
             mCaptureBuffers.resize(mNumCaptureChannels);
             mResample.resize(0);
@@ -1246,6 +1289,46 @@ bool AudioIO::AllocateBuffers(
    return true;
 }
 
+void AudioIO::AllocatePlaybackMixerPool()
+{
+   using audacity::concurrency::ThreadPool;
+
+   size_t wanted = std::max(0, AudioIOPlaybackMixerThreads.Read());
+   if (wanted == 0)
+      // Leave room for the PortAudio callback and the user interface
+      wanted = ThreadPool::HardwareConcurrency() / 2;
+   // No use in more threads than sequences.  This is called before the
+   // mixers are made, so count the sequences they will mix.
+   const auto nThreads = std::clamp<size_t>(wanted,
+      1, std::max<size_t>(1, mPlaybackSequences.size()));
+
+   if (!mPlaybackMixerPool || mPlaybackMixerPool->GetConcurrency() != nThreads)
+      // The calling thread takes part too
+      mPlaybackMixerPool = std::make_unique<ThreadPool>(nThreads - 1);
+   // Several sequences are mixed in parallel, if more than one thread is
+   // wanted
+   assert(mPlaybackSequences.size() < 2 || wanted < 2 ||
+      mPlaybackMixerPool->GetConcurrency() > 1);
+
+   mPlaybackMixerCounters = std::vector<PlaybackMixerCounters>(nThreads);
+}
+
+std::vector<PlaybackMixerWorkerStats> AudioIO::GetPlaybackMixerStats() const
+{
+   using std::chrono::nanoseconds;
+
+   std::vector<PlaybackMixerWorkerStats> result;
+   result.reserve(mPlaybackMixerCounters.size());
+   for (auto &counters : mPlaybackMixerCounters)
+      result.push_back({
+         counters.slices.load(std::memory_order_relaxed),
+         nanoseconds{ counters.lastSlice.load(std::memory_order_relaxed) },
+         nanoseconds{ counters.maxSlice.load(std::memory_order_relaxed) },
+         nanoseconds{ counters.total.load(std::memory_order_relaxed) },
+      });
+   return result;
+}
+
 void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
 {
    mpTransportState.reset();
@@ -1253,6 +1336,7 @@ void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
    mPlaybackBuffers.clear();
    mScratchBuffers.clear();
    mScratchPointers.clear();
+   mRealtimeWorkerScratch.clear();
    mPlaybackMixers.clear();
    mCaptureBuffers.clear();
    mResample.clear();
@@ -1405,6 +1489,7 @@ void AudioIO::StopStream()
    mPlaybackBuffers.clear();
    mScratchBuffers.clear();
    mScratchPointers.clear();
+   mRealtimeWorkerScratch.clear();
    mPlaybackMixers.clear();
    mPlaybackSchedule.mTimeQueue.Clear();
 
@@ -1614,6 +1699,11 @@ double AudioIO::GetStreamTime()
 //
 //////////////////////////////////////////////////////////////////////
 
+namespace {
+//! Longest sleep of the Audio thread between wake-ups, when event driven
+constexpr std::chrono::milliseconds EventDrivenSleepInterval{ 100 };
+}
+
 //! Sits in a thread loop reading and writing audio.
 void AudioIO::AudioThread(std::atomic<bool> &finish)
 {
@@ -1687,10 +1777,36 @@ void AudioIO::AudioThread(std::atomic<bool> &finish)
          });
       }
 
-      std::this_thread::sleep_until( loopPassStart + interval );
+      if (gAudioIO->mAudioThreadEventDriven.load(std::memory_order_relaxed))
+         // The PortAudio callback and the main thread wake us when there is
+         // something to do; the timeout bounds the delay of anything else
+         gAudioIO->mAudioThreadWakeEvent.WaitFor(
+            std::max<std::chrono::microseconds>(
+               interval, EventDrivenSleepInterval));
+      else
+         std::this_thread::sleep_until( loopPassStart + interval );
+      gAudioIO->mAudioThreadWakeups.fetch_add(1, std::memory_order_relaxed);
    }
 }
 
+AudioThreadStats AudioIO::GetAudioThreadStats() const
+{
+   using namespace std::chrono;
+
+   AudioThreadStats stats;
+   stats.eventDriven = mAudioThreadEventDriven.load(std::memory_order_relaxed);
+   stats.wakeups = mAudioThreadWakeups.load(std::memory_order_relaxed);
+   stats.signals = mAudioThreadSignals.load(std::memory_order_relaxed);
+   const auto elapsed = duration<double>(
+      steady_clock::now() - mAudioThreadStatsStart).count();
+   if (elapsed > 0)
+      stats.wakeupsPerSecond = stats.wakeups / elapsed;
+   const auto minFill = mMinPlaybackFill.load(std::memory_order_relaxed);
+   if (minFill != std::numeric_limits<size_t>::max())
+      stats.minPlaybackFill = minFill;
+   return stats;
+}
+
 size_t AudioIoCallback::MinValue(
    const RingBuffers &buffers, size_t (RingBuffer::*pmf)() const)
 {
@@ -1845,50 +1961,8 @@ bool AudioIO::ProcessPlaybackSlices(
       // atomic variables, the time queue doesn't.
       mPlaybackSchedule.mTimeQueue.Producer(mPlaybackSchedule, slice);
 
-      // mPlaybackMixers correspond one-to-one with mPlaybackSequences
-      size_t iSequence = 0;
-      // mPlaybackBuffers correspond many-to-one with mPlaybackSequences
-      size_t iBuffer = 0;
-      for (auto &mixer : mPlaybackMixers) {
-         // The mixer here isn't actually mixing: it's just doing
-         // resampling, format conversion, and possibly time track
-         // warping
-         if (frames > 0) {
-            size_t produced = 0;
-
-            if (toProduce)
-               produced = mixer->Process(toProduce);
-
-            //wxASSERT(produced <= toProduce);
-            // Copy (non-interleaved) mixer outputs to one or more ring buffers
-            const auto nChannels = mPlaybackSequences[iSequence]->NChannels();
-
-            const auto appendPos = mProcessingBuffers[iBuffer].size();
-            for (size_t j = 0; j < nChannels; ++j)
-            {
-               // mPlaybackBuffers correspond many-to-one with mPlaybackSequences
-               auto& buffer = mProcessingBuffers[iBuffer + j];
-               //Sufficient size should have been reserved in AllocateBuffers
-               //But for some latency values (> aprox. 100ms) pre-allocated
-               //buffer could be not large enough.
-               //Preserve what was written to the buffer during previous pass, don't discard
-               buffer.resize(buffer.size() + frames, 0);
-
-               const auto warpedSamples = mixer->GetBuffer(j);
-               std::copy_n(
-                  reinterpret_cast<const float*>(warpedSamples),
-                  produced,
-                  buffer.data() + appendPos);
-               std::fill_n(
-                  buffer.data() + appendPos + produced,
-                  frames - produced,
-                  .0f);
-            }
-
-            iBuffer += nChannels;
-            ++iSequence;
-         }
-      }
+      if (frames > 0)
+         ProcessPlaybackMixers(frames, toProduce);
 
       available -= frames;
       // wxASSERT(available >= 0); // don't assert on this thread
@@ -1908,61 +1982,65 @@ bool AudioIO::ProcessPlaybackSlices(
    // after all the little slices have been written.
    if (pScope)
    {
-      const auto pointers = stackAllocate(float*, mNumPlaybackChannels);
-
-      int bufferIndex = 0;
-      for(const auto& seq : mPlaybackSequences)
+      size_t nTasks = 0;
+      for(size_t iSequence = 0; iSequence < mPlaybackSequences.size(); ++iSequence)
       {
+         const auto &seq = mPlaybackSequences[iSequence];
          if(!seq)
             continue;//no similar check in convert-to-float part
          const auto channelGroup = seq->FindChannelGroup();
          if(!channelGroup)
             continue;
 
-         // Are there more output device channels than channels of vt?
-         // Such as when a mono sequence is processed for stereo play?
-         // Then supply some non-null fake input buffers, because the
-         // various ProcessBlock overrides of effects may crash without it.
-         // But it would be good to find the fixes to make this unnecessary.
-         auto scratch = &mScratchPointers[mNumPlaybackChannels + 1];
-
+         const auto bufferIndex = mPlaybackMixerBufferIndices[iSequence];
          //skip samples that are already processed
          const auto offset = processingBufferOffsets[bufferIndex];
          //number of newly written samples
          const auto len = mProcessingBuffers[bufferIndex].size() - offset;
+         if(len == 0)
+            continue;
 
-         if(len > 0)
-         {
-            for(unsigned i = 0, cnt = std::min(seq->NChannels(), mNumPlaybackChannels); i < cnt; ++i)
-               pointers[i] = mProcessingBuffers[bufferIndex + i].data() + offset;
+         const auto nChannels = seq->NChannels();
+         const auto pointers = &mRealtimeGroupBuffers[bufferIndex];
+         for(unsigned i = 0; i < nChannels; ++i)
+            pointers[i] = mProcessingBuffers[bufferIndex + i].data() + offset;
+
+         mRealtimeGroupSequences[nTasks] = iSequence;
+         auto &task = mRealtimeGroupTasks[nTasks++];
+         task.group = channelGroup;
+         task.buffers = pointers;
+         task.nChannels = nChannels;
+         task.numSamples = len;
+         task.discardable = 0;
+      }
 
-            for(unsigned i = seq->NChannels(); i < mNumPlaybackChannels; ++i)
-            {
+      // Independent groups are processed concurrently, before the master
+      pScope->ProcessGroups(*mPlaybackMixerPool,
+         mRealtimeGroupTasks.data(), nTasks,
+         mRealtimeWorkerScratch.data(), mNumPlaybackChannels);
 
-               pointers[i] = *scratch++;
-               std::fill_n(pointers[i], len, .0f);
-            }
+      for(size_t iTask = 0; iTask < nTasks; ++iTask)
+      {
+         const auto &task = mRealtimeGroupTasks[iTask];
+         const auto iSequence = mRealtimeGroupSequences[iTask];
+         const auto &seq = mPlaybackSequences[iSequence];
+         const auto bufferIndex = mPlaybackMixerBufferIndices[iSequence];
+         const auto offset = processingBufferOffsets[bufferIndex];
 
-            const auto discardable = pScope->Process(channelGroup, &pointers[0],
-               mScratchPointers.data(),
-               // The single dummy output buffer:
-               mScratchPointers[mNumPlaybackChannels],
-               mNumPlaybackChannels, len);
-            // Check for asynchronous user changes in mute, solo status
-            const auto silenced = SequenceShouldBeSilent(*seq);
-            for(int i = 0; i < seq->NChannels(); ++i)
+         // Check for asynchronous user changes in mute, solo status
+         const auto silenced = SequenceShouldBeSilent(*seq);
+         for(unsigned i = 0; i < task.nChannels; ++i)
+         {
+            auto& buffer = mProcessingBuffers[bufferIndex + i];
+            buffer.erase(buffer.begin() + offset,
+               buffer.begin() + offset + task.discardable);
+            if(silenced)
             {
-               auto& buffer = mProcessingBuffers[bufferIndex + i];
-               buffer.erase(buffer.begin() + offset, buffer.begin() + offset + discardable);
-               if(silenced)
-               {
-                  //TODO: fade out smoothly
-                  std::fill_n(buffer.data() + offset, len - discardable, 0);
-               }
+               //TODO: fade out smoothly
+               std::fill_n(buffer.data() + offset,
+                  task.numSamples - task.discardable, 0);
             }
          }
-
-         bufferIndex += seq->NChannels();
       }
    }
 
@@ -2067,6 +2145,72 @@ bool AudioIO::ProcessPlaybackSlices(
    return progress;
 }
 
+void AudioIO::ProcessPlaybackMixers(size_t frames, size_t toProduce)
+{
+   using Clock = std::chrono::steady_clock;
+
+   for (auto &counters : mPlaybackMixerCounters)
+      counters.sliceTime = 0;
+
+   // The mixers, and the processing buffers they write, are disjoint, so
+   // they can run concurrently.  ParallelFor joins all the workers before
+   // returning, so what follows sees all the buffers complete.
+   mPlaybackMixerPool->ParallelFor(mPlaybackMixers.size(),
+   [&](size_t iSequence, size_t worker) {
+      const auto start = Clock::now();
+      auto &mixer = mPlaybackMixers[iSequence];
+
+      // The mixer here isn't actually mixing: it's just doing
+      // resampling, format conversion, and possibly time track
+      // warping
+      size_t produced = 0;
+      if (toProduce)
+         produced = mixer->Process(toProduce);
+
+      //wxASSERT(produced <= toProduce);
+      // Copy (non-interleaved) mixer outputs to one or more ring buffers
+      const auto nChannels = mPlaybackSequences[iSequence]->NChannels();
+
+      // mPlaybackBuffers correspond many-to-one with mPlaybackSequences
+      const auto iBuffer = mPlaybackMixerBufferIndices[iSequence];
+      const auto appendPos = mProcessingBuffers[iBuffer].size();
+      for (size_t j = 0; j < nChannels; ++j)
+      {
+         auto& buffer = mProcessingBuffers[iBuffer + j];
+         //Sufficient size should have been reserved in AllocateBuffers
+         //But for some latency values (> aprox. 100ms) pre-allocated
+         //buffer could be not large enough.
+         //Preserve what was written to the buffer during previous pass, don't discard
+         buffer.resize(buffer.size() + frames, 0);
+
+         const auto warpedSamples = mixer->GetBuffer(j);
+         std::copy_n(
+            reinterpret_cast<const float*>(warpedSamples),
+            produced,
+            buffer.data() + appendPos);
+         std::fill_n(
+            buffer.data() + appendPos + produced,
+            frames - produced,
+            .0f);
+      }
+
+      mPlaybackMixerCounters[worker].sliceTime +=
+         std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count();
+   });
+
+   for (auto &counters : mPlaybackMixerCounters) {
+      const auto sliceTime = counters.sliceTime;
+      if (sliceTime == 0)
+         continue;
+      counters.slices.fetch_add(1, std::memory_order_relaxed);
+      counters.lastSlice.store(sliceTime, std::memory_order_relaxed);
+      counters.total.fetch_add(sliceTime, std::memory_order_relaxed);
+      if (sliceTime > counters.maxSlice.load(std::memory_order_relaxed))
+         counters.maxSlice.store(sliceTime, std::memory_order_relaxed);
+   }
+}
+
 void AudioIO::DrainRecordBuffers()
 {
    if (mRecordingException || mCaptureSequences.empty())
@@ -2544,6 +2688,7 @@ void AudioIoCallback::DrainInputBuffers(
    if (mPlaybackSchedule.GetPolicy().Done(mPlaybackSchedule, 0)) {
       mCallbackReturn = paComplete;
       mWASAPICallbackCompletionPending.store(true, std::memory_order_release);
+      mAudioThreadWakeEvent.Signal();
    }
 
    // The error likely from a too-busy CPU falling behind real-time data
@@ -2911,11 +3056,35 @@ int AudioIoCallback::AudioCallback(
       statusFlags,
       tempFloats);
 
+   NotifyAudioThread();
+
    SendVuOutputMeterData( outputMeterFloats, framesPerBuffer);
 
    return mCallbackReturn;
 }
 
+void AudioIoCallback::NotifyAudioThread()
+{
+   bool wake = false;
+
+   if (mNumPlaybackChannels > 0 && !mPlaybackBuffers.empty()) {
+      const auto ready = GetCommonlyReadyPlayback();
+      // Only this thread writes the minimum
+      if (ready < mMinPlaybackFill.load(std::memory_order_relaxed))
+         mMinPlaybackFill.store(ready, std::memory_order_relaxed);
+      wake = ready <= mPlaybackLowWater;
+   }
+
+   if (mNumCaptureChannels > 0 && !mCaptureBuffers.empty())
+      wake = wake ||
+         MinValue(mCaptureBuffers, &RingBuffer::AvailForGet) >= mCaptureHighWater;
+
+   if (wake && mAudioThreadEventDriven.load(std::memory_order_relaxed)) {
+      mAudioThreadSignals.fetch_add(1, std::memory_order_relaxed);
+      mAudioThreadWakeEvent.Signal();
+   }
+}
+
 int AudioIoCallback::CallbackDoSeek()
 {
    const int token = mStreamToken;
@@ -2991,6 +3160,7 @@ void AudioIoCallback::CallbackCheckCompletion(
       ext.SignalOtherCompletion();
    callbackReturn = paComplete;
    mWASAPICallbackCompletionPending.store(true, std::memory_order_release);
+   mAudioThreadWakeEvent.Signal();
 }
 
 auto AudioIoCallback::AudioIOExtIterator::operator *() const -> AudioIOExt &
@@ -3004,6 +3174,7 @@ auto AudioIoCallback::AudioIOExtIterator::operator *() const -> AudioIOExt &
 void AudioIoCallback::StartAudioThread()
 {
    mAudioThreadSequenceBufferExchangeLoopRunning.store(true, std::memory_order_release);
+   mAudioThreadWakeEvent.Signal();
 }
 
 void AudioIoCallback::WaitForAudioThreadStarted()
@@ -3019,6 +3190,7 @@ void AudioIoCallback::WaitForAudioThreadStarted()
 void AudioIoCallback::StopAudioThread()
 {
    mAudioThreadSequenceBufferExchangeLoopRunning.store(false, std::memory_order_release);
+   mAudioThreadWakeEvent.Signal();
 }
 
 void AudioIoCallback::WaitForAudioThreadStopped()
@@ -3035,6 +3207,7 @@ void AudioIoCallback::ProcessOnceAndWait(std::chrono::milliseconds sleepTime)
 {
    mAudioThreadShouldCallSequenceBufferExchangeOnce
       .store(true, std::memory_order_release);
+   mAudioThreadWakeEvent.Signal();
 
    while (mAudioThreadShouldCallSequenceBufferExchangeOnce
       .load(std::memory_order_acquire))
@@ -3056,3 +3229,5 @@ bool AudioIO::IsCapturing() const
 }
 
 BoolSetting SoundActivatedRecord{ "/AudioIO/SoundActivatedRecord", false };
+IntSetting AudioIOPlaybackMixerThreads{ "/AudioIO/PlaybackMixerThreads", 0 };
+BoolSetting AudioIOEventDrivenThread{ "/AudioIO/EventDrivenThread", false };
@@ -17,6 +17,7 @@
 #include "AudioIOSequences.h"
 #include "PlaybackSchedule.h" // member variable
 
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -30,6 +31,8 @@
 #include "SampleCount.h"
 #include "SampleFormat.h"
 
+#include "concurrency/WakeEvent.h"
+
 class wxArrayString;
 class AudioIOBase;
 class AudioIO;
@@ -47,6 +50,12 @@ typedef int PaError;
 
 namespace RealtimeEffects {
    class ProcessingScope;
+   struct GroupTask;
+   struct WorkerScratch;
+}
+
+namespace audacity::concurrency {
+   class ThreadPool;
 }
 
 bool ValidateDeviceNames();
@@ -68,6 +77,31 @@ struct AudioIOEvent {
    bool on;
 };
 
+//! Timing of the parallel mixing of playback slices, for one worker
+struct PlaybackMixerWorkerStats {
+   //! Number of slices in which the worker processed at least one sequence
+   unsigned long long slices{};
+   //! Time spent processing sequences in the most recent of those slices
+   std::chrono::nanoseconds lastSlice{};
+   //! Longest time spent processing sequences in one slice
+   std::chrono::nanoseconds maxSlice{};
+   //! Total time spent processing sequences since the stream started
+   std::chrono::nanoseconds total{};
+};
+
+//! How often the Audio thread woke, and how close playback came to underrun
+struct AudioThreadStats {
+   //! Whether the PortAudio callback wakes the thread, or it polls
+   bool eventDriven{};
+   //! Passes of the Audio thread loop since the stream started
+   unsigned long long wakeups{};
+   //! How many of those were requested by the PortAudio callback
+   unsigned long long signals{};
+   double wakeupsPerSecond{};
+   //! Fewest frames the PortAudio callback left in the playback ring buffers
+   size_t minPlaybackFill{};
+};
+
 struct AUDIO_IO_API TransportSequences final {
    ConstPlayableSequences playbackSequences;
    RecordableSequences captureSequences;
@@ -235,6 +269,27 @@ public:
    std::thread mAudioThread;
    std::atomic<bool> mFinishAudioThread{ false };
 
+   //! Wakes the Audio thread early, when it is event driven
+   audacity::concurrency::WakeEvent mAudioThreadWakeEvent;
+   /*! Read by worker threads but unchanging during playback */
+   std::atomic<bool> mAudioThreadEventDriven{ false };
+   //! Callback wakes the Audio thread when no more frames are ready for play
+   /*! Read by a worker thread but unchanging during playback */
+   size_t mPlaybackLowWater{};
+   //! Callback wakes the Audio thread when as many frames were captured
+   /*! Read by a worker thread but unchanging during playback */
+   size_t mCaptureHighWater{};
+
+   // Counters for AudioIO::GetAudioThreadStats()
+   std::atomic<unsigned long long> mAudioThreadWakeups{ 0 };
+   std::atomic<unsigned long long> mAudioThreadSignals{ 0 };
+   //! Written only by the PortAudio callback
+   std::atomic<size_t> mMinPlaybackFill{ 0 };
+   std::chrono::steady_clock::time_point mAudioThreadStatsStart;
+
+   //! Called from the PortAudio callback after the ring buffers are used
+   void NotifyAudioThread();
+
    std::vector<std::unique_ptr<Resample>> mResample;
 
    using RingBuffers = std::vector<std::unique_ptr<RingBuffer>>;
@@ -530,6 +585,17 @@ public:
     */
    double GetStreamTime();
 
+   /** \brief Timing of the playback mixing workers, for the current or
+    * most recent stream
+    *
+    * There is one entry per thread that takes part in mixing, the first being
+    * the Audio thread itself */
+   std::vector<PlaybackMixerWorkerStats> GetPlaybackMixerStats() const;
+
+   //! Wake-ups of the Audio thread and ring buffer fill, since the current
+   //! or most recent stream started
+   AudioThreadStats GetAudioThreadStats() const;
+
    static void AudioThread(std::atomic<bool> &finish);
 
    static void Init();
@@ -578,6 +644,13 @@ private:
       std::optional<RealtimeEffects::ProcessingScope> &pScope,
       size_t available);
 
+   //! Produce one slice of each of mPlaybackMixers into mProcessingBuffers
+   void ProcessPlaybackMixers(size_t frames, size_t toProduce);
+
+   //! (Re)create mPlaybackMixerPool for the number of mPlaybackSequences,
+   //! before mPlaybackMixers are made
+   void AllocatePlaybackMixerPool();
+
    //! Second part of SequenceBufferExchange
    void DrainRecordBuffers();
 
@@ -614,9 +687,40 @@ private:
    std::mutex mPostRecordingActionMutex;
    PostRecordingAction mPostRecordingAction;
 
+   //! Runs the mPlaybackMixers concurrently; kept from one stream to the next
+   std::unique_ptr<audacity::concurrency::ThreadPool> mPlaybackMixerPool;
+
+   //! Index of the first of mProcessingBuffers for each of mPlaybackMixers
+   std::vector<size_t> mPlaybackMixerBufferIndices;
+
+   struct PlaybackMixerCounters {
+      //! Accumulated by one worker within a slice; padded against false sharing
+      alignas(64) std::chrono::nanoseconds::rep sliceTime{};
+      // Written by the Audio thread after each slice, read by the main thread
+      std::atomic<unsigned long long> slices{};
+      std::atomic<std::chrono::nanoseconds::rep> lastSlice{};
+      std::atomic<std::chrono::nanoseconds::rep> maxSlice{};
+      std::atomic<std::chrono::nanoseconds::rep> total{};
+   };
+   //! One per worker of mPlaybackMixerPool
+   std::vector<PlaybackMixerCounters> mPlaybackMixerCounters;
+
+   // Preallocated for the concurrent realtime processing of groups
+   //! One per worker of mPlaybackMixerPool, pointing into mScratchBuffers
+   std::vector<RealtimeEffects::WorkerScratch> mRealtimeWorkerScratch;
+   std::vector<RealtimeEffects::GroupTask> mRealtimeGroupTasks;
+   //! Index into mPlaybackSequences for each of mRealtimeGroupTasks
+   std::vector<size_t> mRealtimeGroupSequences;
+   //! Parallel to mProcessingBuffers, offset to the unprocessed samples
+   std::vector<float *> mRealtimeGroupBuffers;
+
    bool mDelayingActions{ false };
 };
 
 AUDIO_IO_API extern BoolSetting SoundActivatedRecord;
+//! Number of threads that mix playback sequences; 0 to choose automatically
+AUDIO_IO_API extern IntSetting AudioIOPlaybackMixerThreads;
+//! Whether the PortAudio callback wakes the Audio thread, instead of polling
+AUDIO_IO_API extern BoolSetting AudioIOEventDrivenThread;
 
 #endif
@@ -42,6 +42,11 @@ AmplifyBase::Instance::~Instance()
    static_cast<AmplifyBase&>(GetEffect()).DestroyOutputTracks();
 }
 
+bool AmplifyBase::Instance::CanProcessTracksConcurrently() const
+{
+   return true;
+}
+
 AmplifyBase::AmplifyBase()
 {
    mAmp = Amp.def;
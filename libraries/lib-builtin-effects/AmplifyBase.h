@@ -39,6 +39,10 @@ protected:
    {
       using StatefulPerTrackEffect::Instance::Instance;
       ~Instance() override;
+
+      //! ProcessBlock() only reads the ratio, which is not changed while
+      //! processing
+      bool CanProcessTracksConcurrently() const override;
    };
 
 protected:
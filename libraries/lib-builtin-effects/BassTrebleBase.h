@@ -10,6 +10,7 @@
 **********************************************************************/
 #pragma once
 
+#include "Biquad.h"
 #include "PerTrackEffect.h"
 #include "SettingsVisitor.h"
 
@@ -28,10 +29,8 @@ public:
    double bass;
    double gain;
    double slope, hzBass, hzTreble;
-   double a0Bass, a1Bass, a2Bass, b0Bass, b1Bass, b2Bass;
-   double a0Treble, a1Treble, a2Treble, b0Treble, b1Treble, b2Treble;
-   double xn1Bass, xn2Bass, yn1Bass, yn2Bass;
-   double xn1Treble, xn2Treble, yn1Treble, yn2Treble;
+   // Low shelf, then high shelf, indexed by kShelfType
+   Biquad filters[2];
 };
 
 struct BassTrebleSettings
@@ -88,6 +87,8 @@ public:
          EffectSettings& settings, const float* const* inBlock,
          float* const* outBlock, size_t blockLen) override;
 
+      bool CanProcessTracksConcurrently() const override;
+
       bool RealtimeInitialize(EffectSettings& settings, double) override;
 
       bool RealtimeAddProcessor(
@@ -115,7 +116,9 @@ public:
          double& a0, double& a1, double& a2, double& b0, double& b1,
          double& b2);
 
-      static float DoFilter(BassTrebleState& data, float in);
+      //! Set the coefficients of a shelf, normalized so that a0 is 1
+      static void SetShelf(
+         BassTrebleState& data, double gain, int type);
 
       BassTrebleState mState;
       std::vector<BassTrebleBase::Instance> mSlaves;
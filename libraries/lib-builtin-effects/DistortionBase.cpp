@@ -148,6 +148,11 @@ size_t DistortionBase::Instance::ProcessBlock(
    return InstanceProcess(settings, mMaster, inBlock, outBlock, blockLen);
 }
 
+bool DistortionBase::Instance::CanProcessTracksConcurrently() const
+{
+   return true;
+}
+
 bool DistortionBase::Instance::RealtimeInitialize(EffectSettings&, double)
 {
    SetBlockSize(512);
@@ -106,6 +106,8 @@ public:
          EffectSettings& settings, const float* const* inBlock,
          float* const* outBlock, size_t blockLen) override;
 
+      bool CanProcessTracksConcurrently() const override;
+
       bool RealtimeInitialize(EffectSettings& settings, double) override;
 
       bool RealtimeAddProcessor(
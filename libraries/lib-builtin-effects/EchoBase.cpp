@@ -109,3 +109,8 @@ size_t EchoBase::Instance::ProcessBlock(
 
    return blockLen;
 }
+
+bool EchoBase::Instance::CanProcessTracksConcurrently() const
+{
+   return true;
+}
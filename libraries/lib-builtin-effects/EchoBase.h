@@ -62,6 +62,8 @@ public:
          EffectSettings& settings, const float* const* inBlock,
          float* const* outBlock, size_t blockLen) override;
 
+      bool CanProcessTracksConcurrently() const override;
+
       bool ProcessFinalize() noexcept override;
 
       unsigned GetAudioOutCount() const override
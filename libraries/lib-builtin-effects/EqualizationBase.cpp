@@ -4,6 +4,8 @@
 #include "WaveClip.h"
 #include "WaveTrack.h"
 
+#include <algorithm>
+
 const EffectParameterMethods& EqualizationBase::Parameters() const
 {
    static CapturedParameters<
@@ -311,6 +313,10 @@ bool EqualizationBase::Process(EffectInstance&, EffectSettings&)
    mParameters.CalcFilter();
    bool bGoodResult = true;
 
+   audacity::concurrency::ThreadPool pool {
+      audacity::concurrency::ThreadPool::HardwareConcurrency() - 1
+   };
+
    int count = 0;
    for (auto track : outputs.Get().Selected<WaveTrack>())
    {
@@ -341,7 +347,7 @@ bool EqualizationBase::Process(EffectInstance&, EffectSettings&)
             if (idealBlockLen % L != 0)
                idealBlockLen += (L - (idealBlockLen % L));
             auto pNewChannel = *iter0++;
-            Task task { M, idealBlockLen, *pNewChannel };
+            Task task { M, idealBlockLen, *pNewChannel, pool };
             bGoodResult = ProcessOne(task, count, *pChannel, start, len);
             if (!bGoodResult)
                goto done;
@@ -377,8 +383,6 @@ bool EqualizationBase::ProcessOne(
    auto s = start;
 
    auto& buffer = task.buffer;
-   auto& window1 = task.window1;
-   auto& window2 = task.window2;
    auto& thisWindow = task.thisWindow;
    auto& lastWindow = task.lastWindow;
 
@@ -396,25 +400,46 @@ bool EqualizationBase::ProcessOne(
 
       t.GetFloats(buffer.get(), s, block);
 
-      for (size_t i = 0; i < block;
-           i += L) // go through block in lumps of length L
+      // Each window is filtered independently of the others, so all the
+      // windows of the block are filtered at once; only the overlap-add
+      // must go in order
+      const auto nWindows = (block + L - 1) / L;
+      const auto windows = task.windows.get();
+      task.pool.ParallelFor(nWindows, [&](size_t iWindow, size_t worker) {
+         const auto i = iWindow * L;
+         const auto window = windows + iWindow * windowSize;
+         const auto nSamples = std::min<size_t>(L, block - i);
+         // copy the L (or remaining) samples
+         std::copy(&buffer[i], &buffer[i] + nSamples, window);
+         // this includes the padding
+         std::fill(window + nSamples, window + windowSize, 0.0f);
+         mParameters.Filter(
+            windowSize, window, task.scratch.get() + worker * windowSize);
+      });
+
+      for (size_t iWindow = 0; iWindow < nWindows; ++iWindow)
       {
+         const auto i = iWindow * L; // go through block in lumps of length L
+         const auto window = windows + iWindow * windowSize;
+         const auto previous =
+            iWindow == 0 ? lastWindow : window - windowSize;
          wcopy = std::min<size_t>(L, block - i);
-         for (size_t j = 0; j < wcopy; j++)
-            thisWindow[j] = buffer[i + j]; // copy the L (or remaining) samples
-         for (auto j = wcopy; j < windowSize; j++)
-            thisWindow[j] = 0; // this includes the padding
-
-         mParameters.Filter(windowSize, thisWindow);
 
          // Overlap - Add
          for (size_t j = 0; (j < M - 1) && (j < wcopy); j++)
-            buffer[i + j] = thisWindow[j] + lastWindow[L + j];
+            buffer[i + j] = window[j] + previous[L + j];
          for (size_t j = M - 1; j < wcopy; j++)
-            buffer[i + j] = thisWindow[j];
+            buffer[i + j] = window[j];
+      } // next i, lump of this block
 
+      // Keep the last two windows for the next block and for the tail
+      if (nWindows > 1)
+         std::copy(windows + (nWindows - 2) * windowSize,
+            windows + (nWindows - 1) * windowSize, thisWindow);
+      else
          std::swap(thisWindow, lastWindow);
-      } // next i, lump of this block
+      std::copy(windows + (nWindows - 1) * windowSize,
+         windows + nWindows * windowSize, lastWindow);
 
       task.AccumulateSamples((samplePtr)buffer.get(), block);
       len -= block;
@@ -5,6 +5,7 @@
 #include "SampleFormat.h"
 #include "StatefulEffect.h"
 #include "WaveTrack.h"
+#include "concurrency/ThreadPool.h"
 
 struct EqualizationParameters;
 
@@ -52,9 +53,14 @@ protected:
 
    struct Task
    {
-      Task(size_t M, size_t idealBlockLen, WaveChannel& channel)
+      Task(
+         size_t M, size_t idealBlockLen, WaveChannel& channel,
+         audacity::concurrency::ThreadPool& pool)
           : buffer { idealBlockLen }
           , idealBlockLen { idealBlockLen }
+          , windows { (idealBlockLen / (windowSize - (M - 1))) * windowSize }
+          , scratch { pool.GetConcurrency() * windowSize }
+          , pool { pool }
           , output { channel }
           , leftTailRemaining { (M - 1) / 2 }
       {
@@ -77,7 +83,13 @@ protected:
       Floats buffer;
       const size_t idealBlockLen;
 
-      // These pointers are swapped after each FFT window
+      // All the FFT windows of one block, which are filtered concurrently,
+      // and per-worker work space for the filter
+      Floats windows;
+      Floats scratch;
+      audacity::concurrency::ThreadPool& pool;
+
+      // The last window of the previous block, and the window before it
       float* thisWindow { window1.get() };
       float* lastWindow { window2.get() };
 
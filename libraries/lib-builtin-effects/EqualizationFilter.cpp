@@ -97,7 +97,8 @@ bool EqualizationFilter::CalcFilter()
    //transfer to time domain to do the padding and windowing
    Floats outr{ mWindowSize };
    Floats outi{ mWindowSize };
-   InverseRealFFT(mWindowSize, mFilterFuncR.get(), NULL, outr.get()); // To time domain
+   InverseRealFFT(mWindowSize, mFilterFuncR.get(), NULL, outr.get(),
+      hFFT.get()); // To time domain
 
    {
       size_t i = 0;
@@ -141,36 +142,25 @@ bool EqualizationFilter::CalcFilter()
    }
 
    //Back to the frequency domain so we can use it
-   RealFFT(mWindowSize, outr.get(), mFilterFuncR.get(), mFilterFuncI.get());
+   RealFFT(mWindowSize, outr.get(), mFilterFuncR.get(), mFilterFuncI.get(),
+      hFFT.get());
+   mResponse = FFTFilterResponse{
+      hFFT.get(), mFilterFuncR.get(), mFilterFuncI.get() };
 
    return TRUE;
 }
 
 void EqualizationFilter::Filter(size_t len, float *buffer) const
+{
+   Filter(len, buffer, mFFTBuffer.get());
+}
+
+void EqualizationFilter::Filter(
+   size_t len, float *buffer, float *scratch) const
 {
    // Transform a window of the time-domain signal to frequency;
    // Multiply by corresponding coefficients;
    // Inverse transform back to time domain:  that's fast convolution.
-
-   float re,im;
-   // Apply FFT
-   RealFFTf(buffer, hFFT.get());
-   //FFT(len, false, inr, NULL, outr, outi);
-
-   // Apply filter
-   // DC component is purely real
-   mFFTBuffer[0] = buffer[0] * mFilterFuncR[0];
-   for(size_t i = 1; i < (len / 2); i++)
-   {
-      re=buffer[hFFT->BitReversed[i]  ];
-      im=buffer[hFFT->BitReversed[i]+1];
-      mFFTBuffer[2*i  ] = re*mFilterFuncR[i] - im*mFilterFuncI[i];
-      mFFTBuffer[2*i+1] = re*mFilterFuncI[i] + im*mFilterFuncR[i];
-   }
-   // Fs/2 component is purely real
-   mFFTBuffer[1] = buffer[1] * mFilterFuncR[len/2];
-
-   // Inverse FFT and normalization
-   InverseRealFFTf(mFFTBuffer.get(), hFFT.get());
-   ReorderToTime(hFFT.get(), mFFTBuffer.get(), buffer);
+   wxASSERT(len == 2 * hFFT->Points);
+   FilterRealFFTf(buffer, hFFT.get(), mResponse, scratch);
 }
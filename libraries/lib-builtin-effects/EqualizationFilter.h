@@ -42,6 +42,11 @@ struct BUILTIN_EFFECTS_API EqualizationFilter : EqualizationParameters
    //! padded left and right for the tails
    void Filter(size_t len, float *buffer) const;
 
+   //! Same as the above, but using the given `len` floats of work space
+   //! instead of mFFTBuffer, so that several windows may be transformed at
+   //! once on different threads
+   void Filter(size_t len, float *buffer, float *scratch) const;
+
    const Envelope &ChooseEnvelope() const
    { return mLin ? mLinEnvelope : mLogEnvelope; }
    Envelope &ChooseEnvelope()
@@ -52,9 +57,12 @@ struct BUILTIN_EFFECTS_API EqualizationFilter : EqualizationParameters
    { return IsLinear() ? mLinEnvelope : mLogEnvelope; }
 
    Envelope mLinEnvelope, mLogEnvelope;
-   HFFT hFFT{ GetFFT(windowSize) };
+   //! Portable tables, so results are the same on every machine
+   HFFT hFFT{ GetRadix2FFT(windowSize) };
    Floats mFFTBuffer{ windowSize };
    Floats mFilterFuncR{ windowSize }, mFilterFuncI{ windowSize };
+   //! The coefficients above, as Filter() uses them
+   FFTFilterResponse mResponse;
    double mLoFreq{ loFreqI };
    double mHiFreq{ mLoFreq };
    size_t mWindowSize{ windowSize };
@@ -40,7 +40,9 @@
 #include "FFT.h"
 #include "TrackSpectrumTransformer.h"
 #include "WaveTrack.h"
+#include "concurrency/ThreadPool.h"
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 
 // SPECTRAL_SELECTION not to affect this effect for now, as there might be no
@@ -113,6 +115,10 @@ const struct WindowTypesInfo
    // { XO("Hamming, Reciprocal Hamming"),    2, }, // output window is special
 };
 
+// A segment of a channel, reduced on its own thread, is at least this many
+// times as long as the margins it reads before and after its output
+constexpr long long MinSegmentMargins = 16;
+
 enum
 {
    DEFAULT_WINDOW_SIZE_CHOICE = 8, // corresponds to 2048
@@ -181,6 +187,7 @@ struct MyTransformer : TrackSpectrumTransformer
                                     windowSize,     stepsPerWindow,
                                     leadingPadding, trailingPadding }
        , mWorker { worker }
+       , mFreqSmoothingScratch(windowSize / 2 + 1)
    {
    }
    struct MyWindow : public Window
@@ -206,6 +213,8 @@ struct MyTransformer : TrackSpectrumTransformer
    bool DoFinish() override;
 
    NoiseReductionBase::Worker& mWorker;
+   // Each transformer may run on its own thread
+   FloatVector mFreqSmoothingScratch;
 };
 
 //----------------------------------------------------------------------------
@@ -235,12 +244,13 @@ public:
 
    static bool Processor(SpectrumTransformer& transformer);
 
-   void ApplyFreqSmoothing(FloatVector& gains);
+   void ApplyFreqSmoothing(FloatVector& gains, FloatVector& scratch);
    void GatherStatistics(MyTransformer& transformer);
    inline bool
    Classify(MyTransformer& transformer, unsigned nWindows, int band);
    void ReduceNoise(MyTransformer& transformer);
    void FinishTrackStatistics();
+   bool ReportProgress();
 
    const bool mDoProfile;
 
@@ -248,7 +258,6 @@ public:
    const Settings& mSettings;
    Statistics& mStatistics;
 
-   FloatVector mFreqSmoothingScratch;
    const size_t mFreqSmoothingBins;
    // When spectral selection limits the affected band:
    size_t mBinLow;  // inclusive lower bound
@@ -266,11 +275,17 @@ public:
    unsigned mNWindowsToExamine;
    unsigned mCenter;
    unsigned mHistoryLen;
+   unsigned mNReleaseBlocks;
 
    // Following are for progress indicator only:
    unsigned mProgressTrackCount = 0;
    sampleCount mLen = 0;
    sampleCount mProgressWindowCount = 0;
+   // When reducing noise, channels are processed at once, and the windows of
+   // all count together; the thread that started polls them for progress
+   std::atomic<long long> mProgressWindows { 0 };
+   double mTotalLen = 0;
+   std::atomic<bool> mCancelled { false };
 };
 
 const ComponentInterfaceSymbol NoiseReductionBase::Symbol { XO(
@@ -545,6 +560,21 @@ bool NoiseReductionBase::Worker::Process(
    eWindowFunctions inWindowType, eWindowFunctions outWindowType,
    TrackList& tracks, double inT0, double inT1)
 {
+   // Profiling accumulates statistics channel by channel, in order.  Noise
+   // reduction of a channel does not depend on others, so all channels of all
+   // tracks are reduced at once.  Segments read beyond their own output, so
+   // none is pasted back until all are done.
+   struct Output
+   {
+      WaveTrack& track;
+      sampleCount start;
+      sampleCount len;
+      std::vector<TrackSpectrumTransformer::Segment> segments {};
+      std::vector<WaveTrack::Holder> pTempTracks {};
+   };
+   std::vector<Output> outputs;
+   size_t nChannels = 0;
+
    mProgressTrackCount = 0;
    for (auto track : tracks.Selected<WaveTrack>())
    {
@@ -581,41 +611,116 @@ bool NoiseReductionBase::Worker::Process(
          else
             mLen += extra;
 
-         auto t0 = track->LongSamplesToTime(start);
-         auto tLen = track->LongSamplesToTime(len);
-         std::optional<WaveTrack::Holder> ppTempTrack;
-         std::optional<ChannelGroup::ChannelIterator<WaveChannel>> pIter;
-         WaveTrack* pFirstTrack {};
-         if (!mSettings.mDoProfile)
+         if (mDoProfile)
          {
-            ppTempTrack.emplace(track->EmptyCopy());
-            pFirstTrack = ppTempTrack->get();
-            pIter.emplace(pFirstTrack->Channels().begin());
+            for (const auto pChannel : track->Channels())
+            {
+               MyTransformer transformer { *this,
+                                           nullptr,
+                                           false,
+                                           inWindowType,
+                                           outWindowType,
+                                           mSettings.WindowSize(),
+                                           mSettings.StepsPerWindow(),
+                                           false,
+                                           false };
+               if (!transformer.Process(
+                      Processor, *pChannel, mHistoryLen, start, len))
+                  return false;
+               ++mProgressTrackCount;
+            }
+            continue;
          }
-         for (const auto pChannel : track->Channels())
+
+         outputs.push_back({ *track, start, len });
+         nChannels += track->NChannels();
+      }
+   }
+
+   if (!outputs.empty())
+   {
+      using audacity::concurrency::ThreadPool;
+      const auto nThreads = mEffect.mConcurrency ?
+         mEffect.mConcurrency : ThreadPool::HardwareConcurrency();
+
+      // When there are fewer channels than threads, cut long channels into
+      // segments too.  The final gains of a window depend on the spectra of
+      // the windows in the queue with it, and on the release from windows
+      // before, which decays to mNoiseAttenFactor within mNReleaseBlocks.
+      // So segments that read that far beyond their kept output, with some
+      // slack, produce exactly what one pass would.
+      const auto stepsPerWindow = mSettings.StepsPerWindow();
+      const size_t warmUpSteps =
+         stepsPerWindow + 2 * mHistoryLen + mNReleaseBlocks + 1;
+      const size_t lookAheadSteps = stepsPerWindow + mHistoryLen + 1;
+      const auto stepSize = mSettings.StepSize();
+      const long long minSegmentLen =
+         MinSegmentMargins * (warmUpSteps + lookAheadSteps) * stepSize;
+      const auto nSegments = (nThreads + nChannels - 1) / nChannels;
+      const auto extra = (stepsPerWindow - 1) * mSettings.SpectrumSize();
+
+      std::vector<std::unique_ptr<MyTransformer>> transformers;
+      std::vector<TrackSpectrumTransformer::Job> jobs;
+      for (auto& output : outputs)
+      {
+         const auto maxSegments = std::max<long long>(
+            1, output.len.as_long_long() / minSegmentLen);
+         output.segments = TrackSpectrumTransformer::MakeSegments(
+            output.len, stepSize,
+            static_cast<size_t>(std::min<long long>(nSegments, maxSegments)),
+            warmUpSteps, lookAheadSteps);
+         for (const auto& segment : output.segments)
          {
-            auto pOutputTrack = pIter ? *(*pIter)++ : nullptr;
-            MyTransformer transformer { *this,
-                                        pOutputTrack.get(),
-                                        !mSettings.mDoProfile,
-                                        inWindowType,
-                                        outWindowType,
-                                        mSettings.WindowSize(),
-                                        mSettings.StepsPerWindow(),
-                                        !mSettings.mDoProfile,
-                                        !mSettings.mDoProfile };
-            if (!transformer.Process(
-                   Processor, *pChannel, mHistoryLen, start, len))
-               return false;
-            ++mProgressTrackCount;
+            auto pTempTrack = output.track.EmptyCopy();
+            auto iter = pTempTrack->Channels().begin();
+            for (const auto pChannel : output.track.Channels())
+            {
+               auto pOutputTrack = *iter++;
+               transformers.push_back(std::make_unique<MyTransformer>(
+                  *this, pOutputTrack.get(), true, inWindowType,
+                  outWindowType, mSettings.WindowSize(), stepsPerWindow, true,
+                  true));
+               transformers.back()->SetOutputRange(segment.skip, segment.keep);
+               jobs.push_back({ *transformers.back(), *pChannel, mHistoryLen,
+                                output.start + segment.start, segment.len });
+               mTotalLen += (segment.len + extra).as_double();
+            }
+            output.pTempTracks.push_back(std::move(pTempTrack));
          }
-         if (ppTempTrack)
+      }
+
+      // Workers only count windows; this thread updates the Progress meter
+      // and lets the user cancel meanwhile
+      ThreadPool pool { std::min(jobs.size(), nThreads) };
+      const auto poll = [&](const std::vector<size_t>&) {
+         if (mEffect.TotalProgress(std::min(
+                1.0, mProgressWindows.load() * mSettings.StepSize() /
+                        std::max(1.0, mTotalLen))))
+            mCancelled = true;
+         return !mCancelled;
+      };
+      if (!TrackSpectrumTransformer::ProcessParallel(
+             Processor, jobs, pool, poll))
+         return false;
+
+      // Edits of the tracks happen only on this thread, after all reading
+      for (auto& output : outputs)
+      {
+         auto& track = output.track;
+         const auto t0 = track.LongSamplesToTime(output.start);
+         for (size_t ii = 0; ii < output.segments.size(); ++ii)
          {
-            TrackSpectrumTransformer::PostProcess(*pFirstTrack, len);
+            const auto& segment = output.segments[ii];
+            auto& tempTrack = *output.pTempTracks[ii];
+            TrackSpectrumTransformer::PostProcess(tempTrack, segment.keep);
+            const auto first = segment.start + segment.skip;
             constexpr auto preserveSplits = true;
             constexpr auto merge = true;
-            track->ClearAndPaste(
-               t0, t0 + tLen, **ppTempTrack, preserveSplits, merge);
+            track.ClearAndPaste(
+               t0 + track.LongSamplesToTime(first),
+               t0 + track.LongSamplesToTime(first + segment.keep), tempTrack,
+               preserveSplits, merge);
+            output.pTempTracks[ii].reset();
          }
       }
    }
@@ -632,7 +737,8 @@ bool NoiseReductionBase::Worker::Process(
    return true;
 }
 
-void NoiseReductionBase::Worker::ApplyFreqSmoothing(FloatVector& gains)
+void NoiseReductionBase::Worker::ApplyFreqSmoothing(
+   FloatVector& gains, FloatVector& scratch)
 {
    // Given an array of gain mutipliers, average them
    // GEOMETRICALLY.  Don't multiply and take nth root --
@@ -644,7 +750,7 @@ void NoiseReductionBase::Worker::ApplyFreqSmoothing(FloatVector& gains)
    const auto spectrumSize = mSettings.SpectrumSize();
 
    {
-      auto pScratch = mFreqSmoothingScratch.data();
+      auto pScratch = scratch.data();
       std::fill(pScratch, pScratch + spectrumSize, 0.0f);
    }
 
@@ -658,13 +764,13 @@ void NoiseReductionBase::Worker::ApplyFreqSmoothing(FloatVector& gains)
       const int j1 = std::min(spectrumSize - 1, ii + mFreqSmoothingBins);
       for (int jj = j0; jj <= j1; ++jj)
       {
-         mFreqSmoothingScratch[ii] += gains[jj];
+         scratch[ii] += gains[jj];
       }
-      mFreqSmoothingScratch[ii] /= (j1 - j0 + 1);
+      scratch[ii] /= (j1 - j0 + 1);
    }
 
    for (size_t ii = 0; ii < spectrumSize; ++ii)
-      gains[ii] = exp(mFreqSmoothingScratch[ii]);
+      gains[ii] = exp(scratch[ii]);
 }
 
 NoiseReductionBase::Worker::Worker(
@@ -680,7 +786,6 @@ NoiseReductionBase::Worker::Worker(
     , mSettings { settings }
     , mStatistics { statistics }
 
-    , mFreqSmoothingScratch(mSettings.SpectrumSize())
     , mFreqSmoothingBins { size_t(std::max(0.0, settings.mFreqSmoothingBands)) }
     , mBinLow { 0 }
     , mBinHigh { mSettings.SpectrumSize() }
@@ -709,13 +814,13 @@ NoiseReductionBase::Worker::Worker(
    const double noiseGain = -settings.mNoiseGain;
    const unsigned nAttackBlocks =
       1 + (int)(settings.mAttackTime * sampleRate / mSettings.StepSize());
-   const unsigned nReleaseBlocks =
+   mNReleaseBlocks =
       1 + (int)(settings.mReleaseTime * sampleRate / mSettings.StepSize());
    // Applies to amplitudes, divide by 20:
    mNoiseAttenFactor = DB_TO_LINEAR(noiseGain);
    // Apply to gain factors which apply to amplitudes, divide by 20:
    mOneBlockAttack = DB_TO_LINEAR(noiseGain / nAttackBlocks);
-   mOneBlockRelease = DB_TO_LINEAR(noiseGain / nReleaseBlocks);
+   mOneBlockRelease = DB_TO_LINEAR(noiseGain / mNReleaseBlocks);
    // Applies to power, divide by 10:
    mOldSensitivityFactor = pow(10.0, settings.mOldSensitivity / 10.0);
 
@@ -774,10 +879,13 @@ bool NoiseReductionBase::Worker::Processor(SpectrumTransformer& trans)
       *pSpectrum = nyquist * nyquist;
    }
 
-   if (worker.mDoProfile)
-      worker.GatherStatistics(transformer);
-   else
+   if (!worker.mDoProfile)
+   {
       worker.ReduceNoise(transformer);
+      return worker.ReportProgress();
+   }
+
+   worker.GatherStatistics(transformer);
 
    // Update the Progress meter, let user cancel
    return !worker.mEffect.TrackProgress(
@@ -788,6 +896,13 @@ bool NoiseReductionBase::Worker::Processor(SpectrumTransformer& trans)
                  worker.mLen.as_double()));
 }
 
+bool NoiseReductionBase::Worker::ReportProgress()
+{
+   // Counted for the thread that polls progress
+   mProgressWindows.fetch_add(1, std::memory_order_relaxed);
+   return !mCancelled.load(std::memory_order_relaxed);
+}
+
 void NoiseReductionBase::Worker::FinishTrackStatistics()
 {
    const auto windows = mStatistics.mTrackWindows;
@@ -1023,7 +1138,7 @@ void NoiseReductionBase::Worker::ReduceNoise(MyTransformer& transformer)
       if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
          // Apply frequency smoothing to output gain
          // Gains are not less than mNoiseAttenFactor
-         ApplyFreqSmoothing(record.mGains);
+         ApplyFreqSmoothing(record.mGains, transformer.mFreqSmoothingScratch);
 
       // Apply gain to FFT
       {
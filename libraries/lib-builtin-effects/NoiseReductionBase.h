@@ -115,4 +115,6 @@ public:
 protected:
    std::unique_ptr<Settings> mSettings;
    std::unique_ptr<Statistics> mStatistics;
+   //! Most threads to reduce noise at once, or 0 for the hardware's number
+   size_t mConcurrency { 0 };
 };
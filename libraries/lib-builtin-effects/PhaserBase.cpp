@@ -112,6 +112,11 @@ size_t PhaserBase::Instance::ProcessBlock(
    return InstanceProcess(settings, mState, inBlock, outBlock, blockLen);
 }
 
+bool PhaserBase::Instance::CanProcessTracksConcurrently() const
+{
+   return true;
+}
+
 bool PhaserBase::Instance::RealtimeInitialize(EffectSettings&, double)
 {
    SetBlockSize(512);
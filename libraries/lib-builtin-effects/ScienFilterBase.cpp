@@ -144,13 +144,8 @@ size_t ScienFilterBase::ProcessBlock(
    EffectSettings&, const float* const* inBlock, float* const* outBlock,
    size_t blockLen)
 {
-   const float* ibuf = inBlock[0];
-   for (int iPair = 0; iPair < (mOrder + 1) / 2; iPair++)
-   {
-      mpBiquad[iPair].Process(ibuf, outBlock[0], blockLen);
-      ibuf = outBlock[0];
-   }
-
+   Biquad::ProcessCascade(
+      mpBiquad.get(), (mOrder + 1) / 2, inBlock[0], outBlock[0], blockLen);
    return blockLen;
 }
 
@@ -0,0 +1,103 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  AmplifyTests.cpp
+
+**********************************************************************/
+#include "AmplifyBase.h"
+
+#include "MockSampleBlockFactory.h"
+#include "MockedAudio.h"
+#include "MockedPrefs.h"
+#include "Project.h"
+#include "ViewInfo.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+MockedPrefs prefs;
+MockedAudio audio;
+
+constexpr int sampleRate = 44100;
+constexpr size_t len = sampleRate;
+
+class TestAmplify final : public AmplifyBase
+{
+public:
+   std::shared_ptr<EffectInstance> MakeInstance() const override
+   {
+      return std::make_shared<Instance>(const_cast<TestAmplify&>(*this));
+   }
+};
+
+//! A second of a sine, in one clip sped up by a quarter
+std::shared_ptr<WaveTrack>
+MakeStretchedTrack(const SampleBlockFactoryPtr& factory)
+{
+   const auto track = WaveTrack::Create(factory, floatSample, sampleRate);
+   std::vector<float> samples(len);
+   for (size_t ii = 0; ii < len; ++ii)
+      samples[ii] = 0.5f * std::sin(ii * 0.05f);
+   (*track->Channels().begin())
+      ->Append(reinterpret_cast<constSamplePtr>(samples.data()), floatSample,
+               len);
+   track->Flush();
+   track->GetClip(0)->StretchBy(0.8);
+   return track;
+}
+
+std::vector<float> GetSamples(const WaveTrack& track)
+{
+   REQUIRE(track.NIntervals() == 1);
+   REQUIRE(!track.GetClip(0)->HasPitchOrSpeed());
+   std::vector<float> samples(
+      track.TimeToLongSamples(track.GetEndTime()).as_size_t());
+   (*track.Channels().begin())->GetFloats(samples.data(), 0, samples.size());
+   return samples;
+}
+} // namespace
+
+TEST_CASE("Amplify of tracks with pitch and speed, processed concurrently")
+{
+   const auto project = AudacityProject::Create();
+   auto& tracks = TrackList::Get(*project);
+   const auto factory = std::make_shared<MockSampleBlockFactory>();
+
+   // Several selected tracks, so that each batch makes more instances of the
+   // effect than the given one
+   constexpr auto nTracks = 5;
+   for (auto ii = 0; ii < nTracks; ++ii)
+      tracks.Add(MakeStretchedTrack(factory))->SetSelected(true);
+   const auto duration = (*tracks.begin())->GetEndTime();
+
+   // What the effect should do: render, then multiply by the default ratio
+   const auto reference = MakeStretchedTrack(factory);
+   reference->ApplyPitchAndSpeed({}, {});
+   auto expected = GetSamples(*reference);
+   for (auto& sample : expected)
+      sample *= 0.9f;
+
+   TestAmplify effect;
+   EffectSettings settings;
+   NotifyingSelectedRegion region;
+   region.setTimes(0, duration);
+   REQUIRE(effect.DoEffect(
+      settings, EffectBase::DefaultInstanceFinder(effect), sampleRate,
+      &tracks, nullptr, region, 0, nullptr));
+
+   REQUIRE(tracks.Size() == nTracks);
+   for (const auto pTrack : tracks.Any<const WaveTrack>())
+   {
+      const auto samples = GetSamples(*pTrack);
+      REQUIRE(samples.size() == expected.size());
+      for (size_t ii = 0; ii < samples.size(); ++ii)
+         REQUIRE(samples[ii] == Approx(expected[ii]).margin(1e-6));
+   }
+}
@@ -0,0 +1,157 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  EqualizationTests.cpp
+
+**********************************************************************/
+#include "EqualizationBase.h"
+
+#include "MockSampleBlockFactory.h"
+#include "MockedAudio.h"
+#include "MockedPrefs.h"
+#include "Project.h"
+#include "RealFFTf.h"
+#include "ViewInfo.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+MockedPrefs prefs;
+MockedAudio audio;
+
+constexpr int sampleRate = 44100;
+// Several blocks, each of several FFT windows, and a partial window
+constexpr size_t len = 5 * sampleRate + 123;
+
+class TestEqualization final : public EqualizationBase
+{
+public:
+   //! Shape the curve directly, not from the curves file
+   bool Init() override
+   {
+      mParameters.mHiFreq = sampleRate / 2.0;
+      mParameters.mLoFreq = EqualizationFilter::loFreqI;
+      auto& env = mParameters.ChooseEnvelope();
+      env.Flatten(0.);
+      env.SetTrackLen(1.0);
+      env.InsertOrReplace(0.0, -6.0);
+      env.InsertOrReplace(0.4, 9.0);
+      env.InsertOrReplace(0.7, -12.0);
+      env.InsertOrReplace(1.0, 0.0);
+      return true;
+   }
+
+   EqualizationFilter& GetFilter() { return mParameters; }
+};
+
+std::vector<float> MakeSamples()
+{
+   std::vector<float> samples(len);
+   for (size_t ii = 0; ii < len; ++ii)
+      samples[ii] = 0.3f * std::sin(ii * 0.05f) + 0.2f * std::sin(ii * 1.3f);
+   return samples;
+}
+
+std::vector<float> GetSamples(const WaveTrack& track)
+{
+   REQUIRE(track.NIntervals() == 1);
+   std::vector<float> samples(
+      track.TimeToLongSamples(track.GetEndTime()).as_size_t());
+   (*track.Channels().begin())->GetFloats(samples.data(), 0, samples.size());
+   return samples;
+}
+
+//! Overlap-add, one window after another, as Equalization did before its
+//! windows were filtered concurrently, with the original multiplication
+std::vector<float> Reference(
+   const std::vector<float>& samples, const EqualizationFilter& filter)
+{
+   constexpr auto windowSize = EqualizationFilter::windowSize;
+   const auto M = filter.mM;
+   const auto L = windowSize - (M - 1);
+   const auto hFFT = GetFFT(windowSize);
+   const auto points = hFFT->Points;
+   const auto real = filter.mFilterFuncR.get();
+   const auto imag = filter.mFilterFuncI.get();
+   const int* br = hFFT->BitReversed.get();
+
+   // The whole filtered signal, with tails at both ends
+   std::vector<float> stream(len + L + M - 1);
+   std::vector<float> window(windowSize), scratch(windowSize);
+   for (size_t i = 0; i < len; i += L) {
+      const auto nSamples = std::min(L, len - i);
+      std::copy(&samples[i], &samples[i] + nSamples, window.begin());
+      std::fill(window.begin() + nSamples, window.end(), 0.0f);
+
+      const auto buffer = window.data();
+      RealFFTf(buffer, hFFT.get());
+      scratch[0] = buffer[0] * real[0];
+      for (size_t j = 1; j < points; j++) {
+         const auto re = buffer[br[j]];
+         const auto im = buffer[br[j] + 1];
+         scratch[2 * j] = re * real[j] - im * imag[j];
+         scratch[2 * j + 1] = re * imag[j] + im * real[j];
+      }
+      scratch[1] = buffer[1] * real[points];
+      InverseRealFFTf(scratch.data(), hFFT.get());
+      ReorderToTime(hFFT.get(), scratch.data(), buffer);
+
+      // At most one earlier window overlaps each sample
+      for (size_t j = 0; j < L + M - 1; ++j)
+         stream[i + j] += window[j];
+   }
+   // Drop the left tail, and the right tail, as the effect does
+   return { stream.begin() + (M - 1) / 2, stream.begin() + (M - 1) / 2 + len };
+}
+} // namespace
+
+TEST_CASE("Equalization output is the same as before, to the bit")
+{
+   const auto project = AudacityProject::Create();
+   auto& tracks = TrackList::Get(*project);
+   const auto factory = std::make_shared<MockSampleBlockFactory>();
+
+   const auto samples = MakeSamples();
+   const auto track = WaveTrack::Create(factory, floatSample, sampleRate);
+   (*track->Channels().begin())
+      ->Append(reinterpret_cast<constSamplePtr>(samples.data()), floatSample,
+               len);
+   track->Flush();
+   tracks.Add(track)->SetSelected(true);
+
+   TestEqualization effect;
+   EffectSettings settings;
+   NotifyingSelectedRegion region;
+   region.setTimes(0, track->GetEndTime());
+   REQUIRE(effect.DoEffect(
+      settings, EffectBase::DefaultInstanceFinder(effect), sampleRate,
+      &tracks, nullptr, region, 0, nullptr));
+
+   // The coefficients don't depend on the transform that is available
+   auto& filter = effect.GetFilter();
+   constexpr auto windowSize = EqualizationFilter::windowSize;
+   const std::vector<float> real(
+      filter.mFilterFuncR.get(), filter.mFilterFuncR.get() + windowSize);
+   const std::vector<float> imag(
+      filter.mFilterFuncI.get(), filter.mFilterFuncI.get() + windowSize);
+   ForceScalarFFT(true);
+   filter.CalcFilter();
+   for (size_t ii = 0; ii < windowSize; ++ii) {
+      REQUIRE(filter.mFilterFuncR[ii] == real[ii]);
+      REQUIRE(filter.mFilterFuncI[ii] == imag[ii]);
+   }
+   const auto expected = Reference(samples, filter);
+   ForceScalarFFT(false);
+
+   const auto result = GetSamples(**tracks.Any<const WaveTrack>().begin());
+   REQUIRE(result.size() == expected.size());
+   for (size_t ii = 0; ii < result.size(); ++ii)
+      REQUIRE(result[ii] == expected[ii]);
+}
@@ -0,0 +1,106 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  NoiseReductionTests.cpp
+
+**********************************************************************/
+#include "NoiseReductionBase.h"
+
+#include "MockSampleBlockFactory.h"
+#include "MockedAudio.h"
+#include "MockedPrefs.h"
+#include "Project.h"
+#include "ViewInfo.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+MockedPrefs prefs;
+MockedAudio audio;
+
+constexpr int sampleRate = 44100;
+// Long enough that, with default settings, each channel is cut into four
+// segments when four threads are allowed
+constexpr size_t len = 30 * sampleRate;
+constexpr double noiseDuration = 2.0;
+
+class TestNoiseReduction final : public NoiseReductionBase
+{
+public:
+   explicit TestNoiseReduction(size_t concurrency)
+   {
+      mConcurrency = concurrency;
+   }
+};
+
+//! Noise throughout, and a tone after the noise profile
+std::vector<float> MakeSamples()
+{
+   std::mt19937 engine { 0 };
+   std::uniform_real_distribution<float> distribution { -0.05f, 0.05f };
+   std::vector<float> samples(len);
+   for (size_t ii = 0; ii < len; ++ii)
+   {
+      samples[ii] = distribution(engine);
+      if (ii >= noiseDuration * sampleRate)
+         samples[ii] += 0.5f * std::sin(ii * 0.05f);
+   }
+   return samples;
+}
+
+std::vector<float> GetSamples(const WaveTrack& track)
+{
+   std::vector<float> samples(
+      track.TimeToLongSamples(track.GetEndTime()).as_size_t());
+   (*track.Channels().begin())->GetFloats(samples.data(), 0, samples.size());
+   return samples;
+}
+
+//! Profile the noise, then reduce it in the whole track
+std::vector<float> ReduceNoise(size_t concurrency)
+{
+   const auto project = AudacityProject::Create();
+   auto& tracks = TrackList::Get(*project);
+   const auto factory = std::make_shared<MockSampleBlockFactory>();
+   const auto samples = MakeSamples();
+   const auto track = WaveTrack::Create(factory, floatSample, sampleRate);
+   (*track->Channels().begin())
+      ->Append(reinterpret_cast<constSamplePtr>(samples.data()), floatSample,
+               len);
+   track->Flush();
+   tracks.Add(track)->SetSelected(true);
+
+   TestNoiseReduction effect { concurrency };
+   EffectSettings settings;
+   for (const auto t1 : { noiseDuration, track->GetEndTime() })
+   {
+      NotifyingSelectedRegion region;
+      region.setTimes(0, t1);
+      REQUIRE(effect.DoEffect(
+         settings, EffectBase::DefaultInstanceFinder(effect), sampleRate,
+         &tracks, nullptr, region, 0, nullptr));
+   }
+   return GetSamples(**tracks.Any<const WaveTrack>().begin());
+}
+} // namespace
+
+TEST_CASE("Noise reduction in segments is the same as in one pass")
+{
+   const auto whole = ReduceNoise(1);
+   REQUIRE(whole.size() == len);
+   // Noise was reduced
+   REQUIRE(whole != MakeSamples());
+
+   const auto segmented = ReduceNoise(4);
+   REQUIRE(segmented.size() == whole.size());
+   for (size_t ii = 0; ii < whole.size(); ++ii)
+      REQUIRE(segmented[ii] == whole[ii]);
+}
@@ -205,6 +205,11 @@ bool EffectInstance::NeedsDither() const
    return true;
 }
 
+bool EffectInstance::CanProcessTracksConcurrently() const
+{
+   return false;
+}
+
 EffectInstanceWithBlockSize::~EffectInstanceWithBlockSize() = default;
 
 size_t EffectInstanceWithBlockSize::GetBlockSize() const
@@ -571,6 +571,17 @@ public:
     to a narrower sample format */
    virtual bool NeedsDither() const;
 
+   //! If true, other instances of the effect may process other tracks at the
+   //! same time as this one
+   /*!
+    Then ProcessBlock() may be called on a worker thread, and must neither
+    change state shared with other instances nor interact with the user.
+    ProcessInitialize() and ProcessFinalize() are still called on the main
+    thread.
+    Default implementation returns false
+    */
+   virtual bool CanProcessTracksConcurrently() const;
+
    //! Called at start of destructive processing, for each (mono/stereo) track
    //! Default implementation does nothing, returns true
    /*!
@@ -0,0 +1,227 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: ThreadPool.cpp
+ * SPDX-FileContributor: Tenacity contributors
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace audacity::concurrency
+{
+namespace
+{
+// Lets a nested ParallelFor run inline instead of deadlocking
+thread_local const ThreadPool* tCurrentPool = nullptr;
+thread_local size_t tCurrentWorker = 0;
+
+struct CurrentPoolScope final
+{
+   CurrentPoolScope(const ThreadPool* pool, size_t worker)
+       : mPreviousPool { tCurrentPool }
+       , mPreviousWorker { tCurrentWorker }
+   {
+      tCurrentPool = pool;
+      tCurrentWorker = worker;
+   }
+
+   ~CurrentPoolScope()
+   {
+      tCurrentPool = mPreviousPool;
+      tCurrentWorker = mPreviousWorker;
+   }
+
+   const ThreadPool* const mPreviousPool;
+   const size_t mPreviousWorker;
+};
+} // namespace
+
+ThreadPool::ThreadPool(size_t nThreads)
+{
+   mThreads.reserve(nThreads);
+   for (size_t i = 0; i < nThreads; ++i)
+      mThreads.emplace_back([this, i] { WorkerLoop(i + 1); });
+}
+
+ThreadPool::~ThreadPool()
+{
+   {
+      auto lock = std::lock_guard { mMutex };
+      mStop = true;
+   }
+   mWakeCondition.notify_all();
+
+   for (auto& thread : mThreads)
+      thread.join();
+}
+
+size_t ThreadPool::HardwareConcurrency() noexcept
+{
+   return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::Run(size_t count, Body body, void* context)
+{
+   if (count == 0)
+      return;
+
+   if (tCurrentPool == this || mThreads.empty() || count == 1)
+   {
+      const auto worker = tCurrentPool == this ? tCurrentWorker : 0;
+      for (size_t i = 0; i < count; ++i)
+         body(context, i, worker);
+      return;
+   }
+
+   auto runLock = std::lock_guard { mRunMutex };
+
+   Start(count, body, context);
+
+   Drain(0);
+
+   std::exception_ptr exception;
+   {
+      // Every index is claimed now.  Workers that did not wake up in time
+      // must not join any more, and those that did must be waited for.
+      auto lock = std::unique_lock { mMutex };
+      mAccepting = false;
+      mDoneCondition.wait(lock, [this] { return mActiveWorkers == 0; });
+      std::swap(exception, mException);
+   }
+
+   if (exception)
+      std::rethrow_exception(exception);
+}
+
+void ThreadPool::RunPolling(
+   size_t count, Body body, void* context, PollBody poll, void* pollContext,
+   std::chrono::milliseconds interval)
+{
+   if (count == 0)
+      return;
+
+   if (tCurrentPool == this || mThreads.empty())
+   {
+      const auto worker = tCurrentPool == this ? tCurrentWorker : 0;
+      for (size_t i = 0; i < count; ++i)
+      {
+         poll(pollContext);
+         body(context, i, worker);
+      }
+      return;
+   }
+
+   auto runLock = std::lock_guard { mRunMutex };
+
+   Start(count, body, context);
+
+   std::exception_ptr exception;
+   {
+      // Done when every index is claimed, or the loop failed, and no worker
+      // is still busy.  A worker claims indices only while counted active.
+      auto lock = std::unique_lock { mMutex };
+      const auto done = [this] {
+         return mActiveWorkers == 0 &&
+                (mFailed.load(std::memory_order_relaxed) ||
+                 mNext.load(std::memory_order_relaxed) >= mCount);
+      };
+      while (!mDoneCondition.wait_for(lock, interval, done))
+      {
+         if (exception)
+            continue;
+         lock.unlock();
+         try
+         {
+            poll(pollContext);
+         }
+         catch (...)
+         {
+            exception = std::current_exception();
+            mFailed.store(true, std::memory_order_relaxed);
+         }
+         lock.lock();
+      }
+      mAccepting = false;
+      if (!exception)
+         std::swap(exception, mException);
+   }
+
+   if (exception)
+      std::rethrow_exception(exception);
+}
+
+void ThreadPool::Start(size_t count, Body body, void* context)
+{
+   {
+      auto lock = std::lock_guard { mMutex };
+      mBody = body;
+      mContext = context;
+      mCount = count;
+      mNext.store(0, std::memory_order_relaxed);
+      mFailed.store(false, std::memory_order_relaxed);
+      mException = nullptr;
+      mAccepting = true;
+      ++mGeneration;
+   }
+   mWakeCondition.notify_all();
+}
+
+void ThreadPool::Drain(size_t worker)
+{
+   CurrentPoolScope scope { this, worker };
+
+   while (!mFailed.load(std::memory_order_relaxed))
+   {
+      const auto index = mNext.fetch_add(1, std::memory_order_relaxed);
+      if (index >= mCount)
+         break;
+
+      try
+      {
+         mBody(mContext, index, worker);
+      }
+      catch (...)
+      {
+         auto lock = std::lock_guard { mMutex };
+         if (!mException)
+            mException = std::current_exception();
+         mFailed.store(true, std::memory_order_relaxed);
+      }
+   }
+}
+
+void ThreadPool::WorkerLoop(size_t worker)
+{
+   unsigned long long seenGeneration = 0;
+
+   while (true)
+   {
+      {
+         auto lock = std::unique_lock { mMutex };
+         mWakeCondition.wait(
+            lock,
+            [&] { return mStop || mGeneration != seenGeneration; });
+
+         if (mStop)
+            return;
+
+         seenGeneration = mGeneration;
+         if (!mAccepting)
+            continue;
+
+         ++mActiveWorkers;
+      }
+
+      Drain(worker);
+
+      bool last;
+      {
+         auto lock = std::lock_guard { mMutex };
+         last = --mActiveWorkers == 0;
+      }
+      if (last)
+         mDoneCondition.notify_one();
+   }
+}
+} // namespace audacity::concurrency
@@ -0,0 +1,134 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: ThreadPool.h
+ * SPDX-FileContributor: Tenacity contributors
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace audacity::concurrency
+{
+//! A fixed set of worker threads for fork-join data parallelism
+/*!
+ ParallelFor() hands out the indices of a loop to the workers and to the
+ calling thread, and returns only after every index was processed.  Indices
+ are claimed one at a time from a shared counter, so a worker that finishes
+ early takes over what remains of the others' share.
+
+ No memory is allocated by ParallelFor(), which makes it usable from the
+ audio thread.  Only one loop runs at a time; concurrent callers are
+ serialized, and a nested call from inside a loop body runs inline.
+ */
+class CONCURRENCY_API ThreadPool final
+{
+public:
+   //! Start `nThreads` worker threads, in addition to the calling thread
+   explicit ThreadPool(size_t nThreads);
+   ~ThreadPool();
+
+   ThreadPool(const ThreadPool&)            = delete;
+   ThreadPool(ThreadPool&&)                 = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+   ThreadPool& operator=(ThreadPool&&)      = delete;
+
+   //! Number of threads taking part in ParallelFor, including the caller
+   size_t GetConcurrency() const noexcept { return mThreads.size() + 1; }
+
+   //! std::thread::hardware_concurrency(), but never zero
+   static size_t HardwareConcurrency() noexcept;
+
+   //! Invoke `f(index, worker)` for every index in [0, count)
+   /*!
+    `worker` is in [0, GetConcurrency()) and identifies the thread that runs
+    the call, so that the body may use per-worker scratch space without
+    locking; the calling thread is always worker 0.
+
+    If any call throws, the remaining unclaimed indices are skipped and the
+    first exception is rethrown after all workers have stopped.
+    */
+   template <typename Function>
+   void ParallelFor(size_t count, Function&& f)
+   {
+      using F = std::remove_reference_t<Function>;
+      Run(
+         count,
+         [](void* context, size_t index, size_t worker)
+         { (*static_cast<F*>(context))(index, worker); },
+         const_cast<void*>(static_cast<const void*>(&f)));
+   }
+
+   //! Like ParallelFor(), but the calling thread takes no indices, and
+   //! instead calls `poll()` about every `interval` until all are processed
+   /*!
+    For long loops started from the main thread, which must keep showing
+    progress and checking for cancellation meanwhile.  `worker` is then in
+    [1, GetConcurrency()).
+
+    `poll` may throw to stop the loop: the remaining unclaimed indices are
+    skipped, and its exception is rethrown after all workers have stopped.
+    If there are no worker threads, or the call is nested, the loop runs on
+    the calling thread, with `poll()` called before each index.
+    */
+   template <typename Function, typename Poll>
+   void ParallelForPolling(
+      size_t count, Function&& f, Poll&& poll,
+      std::chrono::milliseconds interval)
+   {
+      using F = std::remove_reference_t<Function>;
+      using P = std::remove_reference_t<Poll>;
+      RunPolling(
+         count,
+         [](void* context, size_t index, size_t worker)
+         { (*static_cast<F*>(context))(index, worker); },
+         const_cast<void*>(static_cast<const void*>(&f)),
+         [](void* context) { (*static_cast<P*>(context))(); },
+         const_cast<void*>(static_cast<const void*>(&poll)), interval);
+   }
+
+private:
+   using Body = void (*)(void* context, size_t index, size_t worker);
+   using PollBody = void (*)(void* context);
+
+   void Run(size_t count, Body body, void* context);
+   void RunPolling(
+      size_t count, Body body, void* context, PollBody poll,
+      void* pollContext, std::chrono::milliseconds interval);
+   void Start(size_t count, Body body, void* context);
+   void Drain(size_t worker);
+   void WorkerLoop(size_t worker);
+
+   std::vector<std::thread> mThreads;
+
+   //! Serializes calls of Run from different threads
+   std::mutex mRunMutex;
+
+   std::mutex mMutex;
+   std::condition_variable mWakeCondition;
+   std::condition_variable mDoneCondition;
+
+   // Guarded by mMutex
+   unsigned long long mGeneration { 0 };
+   size_t mActiveWorkers { 0 };
+   bool mAccepting { false };
+   bool mStop { false };
+   std::exception_ptr mException;
+
+   // Describe the current loop; written before mGeneration is incremented
+   Body mBody { nullptr };
+   void* mContext { nullptr };
+   size_t mCount { 0 };
+
+   std::atomic<size_t> mNext { 0 };
+   std::atomic<bool> mFailed { false };
+}; // class ThreadPool
+} // namespace audacity::concurrency
@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: WakeEvent.cpp
+ * SPDX-FileContributor: Tenacity contributors
+ */
+
+#include "WakeEvent.h"
+
+#if defined(__linux__)
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <time.h>
+#  include <unistd.h>
+#elif defined(_WIN32)
+#  include <windows.h>
+#endif
+
+namespace audacity::concurrency
+{
+namespace
+{
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+#if defined(__linux__)
+void WaitWhileEqual(
+   std::atomic<uint32_t>& address, uint32_t value,
+   std::chrono::microseconds timeout) noexcept
+{
+   using namespace std::chrono;
+   const auto secs = duration_cast<seconds>(timeout);
+   timespec ts;
+   ts.tv_sec = secs.count();
+   ts.tv_nsec = duration_cast<nanoseconds>(timeout - secs).count();
+   syscall(
+      SYS_futex, reinterpret_cast<uint32_t*>(&address), FUTEX_WAIT_PRIVATE,
+      value, &ts, nullptr, 0);
+}
+
+void WakeOne(std::atomic<uint32_t>& address) noexcept
+{
+   syscall(
+      SYS_futex, reinterpret_cast<uint32_t*>(&address), FUTEX_WAKE_PRIVATE,
+      1, nullptr, nullptr, 0);
+}
+#elif defined(_WIN32)
+void WaitWhileEqual(
+   std::atomic<uint32_t>& address, uint32_t value,
+   std::chrono::microseconds timeout) noexcept
+{
+   using namespace std::chrono;
+   const auto ms = duration_cast<milliseconds>(timeout + 999us).count();
+   ::WaitOnAddress(
+      reinterpret_cast<volatile VOID*>(&address), &value, sizeof(value),
+      static_cast<DWORD>(ms));
+}
+
+void WakeOne(std::atomic<uint32_t>& address) noexcept
+{
+   ::WakeByAddressSingle(reinterpret_cast<PVOID>(&address));
+}
+#endif
+} // namespace
+
+void WakeEvent::Signal() noexcept
+{
+   if (mState.exchange(Signaled, std::memory_order_release) != Sleeping)
+      return;
+
+#if defined(__linux__) || defined(_WIN32)
+   WakeOne(mState);
+#else
+   mCondition.notify_one();
+#endif
+}
+
+bool WakeEvent::WaitFor(std::chrono::microseconds timeout) noexcept
+{
+   auto expected = static_cast<uint32_t>(Clear);
+   if (!mState.compare_exchange_strong(
+          expected, Sleeping, std::memory_order_acquire))
+   {
+      // Already signaled; consume it without sleeping
+      mState.store(Clear, std::memory_order_relaxed);
+      return true;
+   }
+
+   // Returns early if Signal() already replaced Sleeping
+#if defined(__linux__) || defined(_WIN32)
+   WaitWhileEqual(mState, Sleeping, timeout);
+#else
+   {
+      auto lock = std::unique_lock { mMutex };
+      mCondition.wait_for(
+         lock, timeout,
+         [this] {
+            return mState.load(std::memory_order_relaxed) != Sleeping;
+         });
+   }
+#endif
+
+   return mState.exchange(Clear, std::memory_order_acquire) == Signaled;
+}
+} // namespace audacity::concurrency
@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: WakeEvent.h
+ * SPDX-FileContributor: Tenacity contributors
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if !defined(__linux__) && !defined(_WIN32)
+#  include <condition_variable>
+#  include <mutex>
+#endif
+
+namespace audacity::concurrency
+{
+//! An auto-resetting event that one thread waits on and any thread signals
+/*!
+ Signal() never blocks or takes a lock, so a realtime thread such as the
+ PortAudio callback may call it.  When nobody waits it costs one atomic
+ exchange; otherwise it wakes the waiter with a futex (Linux) or
+ WakeByAddressSingle (Windows).  Elsewhere a condition variable is notified
+ without locking its mutex, so a wake-up may occasionally be late by up to
+ the waiter's timeout.
+
+ Only one thread may wait at a time.
+ */
+class CONCURRENCY_API WakeEvent final
+{
+public:
+   WakeEvent() = default;
+   WakeEvent(const WakeEvent&)            = delete;
+   WakeEvent& operator=(const WakeEvent&) = delete;
+
+   //! Set the event, waking the waiter if it sleeps
+   void Signal() noexcept;
+
+   //! Wait until the event is set or the timeout elapses, then reset it
+   /*!
+    @return whether the event was set
+    */
+   bool WaitFor(std::chrono::microseconds timeout) noexcept;
+
+private:
+   enum : uint32_t
+   {
+      Clear,
+      Signaled,
+      Sleeping,
+   };
+
+   std::atomic<uint32_t> mState { Clear };
+
+#if !defined(__linux__) && !defined(_WIN32)
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+#endif
+}; // class WakeEvent
+} // namespace audacity::concurrency
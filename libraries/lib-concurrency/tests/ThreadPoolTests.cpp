@@ -0,0 +1,162 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: ThreadPoolTests.cpp
+ * SPDX-FileContributor: Tenacity contributors
+ */
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "concurrency/ThreadPool.h"
+
+using namespace audacity::concurrency;
+
+TEST_CASE("ThreadPool visits every index once", "[ThreadPool]")
+{
+   ThreadPool pool { 3 };
+   REQUIRE(pool.GetConcurrency() == 4);
+
+   for (size_t count : { 0, 1, 2, 7, 1000 })
+   {
+      std::vector<std::atomic<int>> visits(count);
+      std::vector<std::atomic<int>> workers(pool.GetConcurrency());
+
+      pool.ParallelFor(
+         count,
+         [&](size_t index, size_t worker)
+         {
+            ++visits[index];
+            ++workers[worker];
+         });
+
+      for (auto& visit : visits)
+         REQUIRE(visit == 1);
+
+      const auto total = std::accumulate(
+         workers.begin(), workers.end(), size_t { 0 },
+         [](size_t sum, auto& value) { return sum + value.load(); });
+      REQUIRE(total == count);
+   }
+}
+
+TEST_CASE("ThreadPool runs nested loops inline", "[ThreadPool]")
+{
+   ThreadPool pool { 2 };
+   std::atomic<int> calls { 0 };
+   std::atomic<int> mismatches { 0 };
+
+   pool.ParallelFor(
+      4,
+      [&](size_t, size_t outerWorker)
+      {
+         pool.ParallelFor(
+            4,
+            [&](size_t, size_t innerWorker)
+            {
+               if (innerWorker != outerWorker)
+                  ++mismatches;
+               ++calls;
+            });
+      });
+
+   REQUIRE(calls == 16);
+   REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("ThreadPool rethrows the first exception", "[ThreadPool]")
+{
+   ThreadPool pool { 2 };
+
+   REQUIRE_THROWS_AS(
+      pool.ParallelFor(
+         100,
+         [](size_t index, size_t)
+         {
+            if (index == 42)
+               throw std::runtime_error("fail");
+         }),
+      std::runtime_error);
+
+   // The pool remains usable
+   std::atomic<int> calls { 0 };
+   pool.ParallelFor(10, [&](size_t, size_t) { ++calls; });
+   REQUIRE(calls == 10);
+}
+
+TEST_CASE("ThreadPool without workers runs on the caller", "[ThreadPool]")
+{
+   ThreadPool pool { 0 };
+   const auto caller = std::this_thread::get_id();
+
+   pool.ParallelFor(
+      5,
+      [&](size_t, size_t worker)
+      {
+         REQUIRE(worker == 0);
+         REQUIRE(std::this_thread::get_id() == caller);
+      });
+}
+
+TEST_CASE("ThreadPool polls while workers run the loop", "[ThreadPool]")
+{
+   using namespace std::chrono_literals;
+   ThreadPool pool { 3 };
+   const auto caller = std::this_thread::get_id();
+
+   std::vector<std::atomic<int>> visits(20);
+   std::atomic<int> onCaller { 0 };
+   int polls = 0;
+   pool.ParallelForPolling(
+      visits.size(),
+      [&](size_t index, size_t worker)
+      {
+         if (worker == 0 || std::this_thread::get_id() == caller)
+            ++onCaller;
+         std::this_thread::sleep_for(5ms);
+         ++visits[index];
+      },
+      [&] { ++polls; }, 1ms);
+
+   for (auto& visit : visits)
+      REQUIRE(visit == 1);
+   REQUIRE(onCaller == 0);
+   REQUIRE(polls > 0);
+
+   SECTION("and stops when polling throws")
+   {
+      std::atomic<int> calls { 0 };
+      REQUIRE_THROWS_AS(
+         pool.ParallelForPolling(
+            1000,
+            [&](size_t, size_t)
+            {
+               std::this_thread::sleep_for(1ms);
+               ++calls;
+            },
+            [] { throw std::runtime_error("cancel"); }, 1ms),
+         std::runtime_error);
+      REQUIRE(calls < 1000);
+
+      // The pool remains usable
+      calls = 0;
+      pool.ParallelForPolling(
+         10, [&](size_t, size_t) { ++calls; }, [] {}, 1ms);
+      REQUIRE(calls == 10);
+   }
+}
+
+TEST_CASE("ThreadPool without workers polls between indices", "[ThreadPool]")
+{
+   using namespace std::chrono_literals;
+   ThreadPool pool { 0 };
+   std::vector<int> events;
+   pool.ParallelForPolling(
+      3, [&](size_t index, size_t) { events.push_back(int(index)); },
+      [&] { events.push_back(-1); }, 1ms);
+   REQUIRE(events == std::vector<int> { -1, 0, -1, 1, -1, 2 });
+}
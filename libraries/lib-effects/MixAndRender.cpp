@@ -235,3 +235,10 @@ static WaveTrackIORegistry::ObjectWriterEntry waveTrackWriter {
 [](const WaveTrack &track, auto &xmlFile) {
    RealtimeEffectList::Get(track).WriteXML(xmlFile);
 } };
+
+// Effect states write the settings of their plugins, which is safe only on
+// the main thread
+static WaveTrack::XMLNeedsMainThread::Scope waveTrackNeedsMainThread {
+[](const WaveTrack &track) {
+   return RealtimeEffectList::Get(track).GetStatesCount() > 0;
+} };
@@ -22,6 +22,7 @@
 #include "EffectOutputTracks.h"
 
 #include "AudioGraphBuffers.h"
+#include "AudioGraphPipelinedTask.h"
 #include "AudioGraphTask.h"
 #include "EffectStage.h"
 #include "SyncLock.h"
@@ -30,6 +31,10 @@
 #include "WaveTrack.h"
 #include "WaveTrackSink.h"
 #include "WideSampleSource.h"
+#include "concurrency/ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
 
 PerTrackEffect::Instance::~Instance() = default;
 
@@ -74,14 +79,23 @@ bool PerTrackEffect::Process(
       pOutputs = &outputs.emplace(*mTracks, GetType(),
          EffectOutputTracks::TimeInterval{ mT0, mT1 }, true);
 
+   // Instances that can be reused in each pass; the first is the given one.
+   // Any others are destroyed only after the outputs are committed, because
+   // destroying an instance may destroy the pre-formed output tracks
+   Instances recycledInstances{
+      std::dynamic_pointer_cast<EffectInstanceEx>(instance.shared_from_this())
+   };
+
    bool bGoodResult = true;
    // mPass = 1;
    if (DoPass1()) {
       auto &myInstance = dynamic_cast<Instance&>(instance);
-      bGoodResult = pThis->ProcessPass(pOutputs->Get(), myInstance, settings);
+      bGoodResult = pThis->ProcessPass(
+         pOutputs->Get(), myInstance, settings, recycledInstances);
       // mPass = 2;
       if (bGoodResult && DoPass2())
-         bGoodResult = pThis->ProcessPass(pOutputs->Get(), myInstance, settings);
+         bGoodResult = pThis->ProcessPass(
+            pOutputs->Get(), myInstance, settings, recycledInstances);
    }
    if (bGoodResult)
       pOutputs->Commit();
@@ -90,7 +104,8 @@ bool PerTrackEffect::Process(
 }
 
 bool PerTrackEffect::ProcessPass(TrackList &outputs,
-   Instance &instance, EffectSettings &settings)
+   Instance &instance, EffectSettings &settings,
+   Instances &recycledInstances)
 {
    const auto duration = settings.extra.GetDuration();
    bool bGoodResult = true;
@@ -110,12 +125,17 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
    if (numAudioOut < 1)
       return false;
 
-   // Instances that can be reused in each loop pass
-   std::vector<std::shared_ptr<EffectInstance>> recycledInstances{
-      // First one is the given one; any others pushed onto here are
-      // discarded when we exit
-      std::dynamic_pointer_cast<EffectInstanceEx>(instance.shared_from_this())
-   };
+   if (isProcessor && instance.CanProcessTracksConcurrently() &&
+       audacity::concurrency::ThreadPool::HardwareConcurrency() > 1 &&
+       outputs.Selected<const WaveTrack>().size() > 1)
+      return ProcessPassConcurrently(
+         outputs, instance, settings, recycledInstances);
+
+   // Otherwise process each track on another thread than reading and
+   // writing, if the instance allows processing away from the main thread
+   const bool pipelined = (isProcessor || isGenerator) &&
+      instance.CanProcessTracksConcurrently() &&
+      audacity::concurrency::ThreadPool::HardwareConcurrency() > 1;
 
    const bool multichannel = numAudioIn > 1;
    int iChannel = 0;
@@ -292,7 +312,7 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
                return recycledInstances.emplace_back(MakeInstance());
          };
          bGoodResult = ProcessTrack(channel, factory, settings, source, sink,
-            genLength, sampleRate, wt, inBuffers, outBuffers);
+            genLength, sampleRate, wt, inBuffers, outBuffers, pipelined);
          if (bGoodResult) {
             sink.Flush(outBuffers);
             bGoodResult = sink.IsOk();
@@ -355,12 +375,164 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
    return bGoodResult;
 }
 
+bool PerTrackEffect::ProcessPassConcurrently(TrackList &outputs,
+   Instance &instance, EffectSettings &settings,
+   Instances &recycledInstances)
+{
+   const auto duration = settings.extra.GetDuration();
+   const auto numAudioIn = instance.GetAudioInCount();
+   const auto numAudioOut = instance.GetAudioOutCount();
+   const bool multichannel = numAudioIn > 1;
+   const auto effectiveFormat =
+      instance.NeedsDither() ? widestSampleFormat : narrowestSampleFormat;
+
+   // One (mono or stereo) channel group of a track, from source to sink
+   struct Pass {
+      Buffers inBuffers, outBuffers;
+      //! Of the source, when progress was last reported
+      sampleCount position;
+      std::unique_ptr<WideSampleSource> pSource;
+      std::unique_ptr<WaveTrackSink> pSink;
+      std::unique_ptr<EffectStage> pStage;
+   };
+
+   using audacity::concurrency::ThreadPool;
+   std::vector<WaveTrack *> tracks;
+   for (auto pTrack : outputs.Any()) {
+      const auto pWaveTrack = track_cast<WaveTrack *>(pTrack);
+      if (pWaveTrack && pWaveTrack->GetSelected())
+         tracks.push_back(pWaveTrack);
+      else if (SyncLock::IsSyncLockSelected(*pTrack))
+         pTrack->SyncLockAdjust(mT1, mT0 + duration);
+   }
+
+   // Samples of all tracks and channel groups, for progress
+   double total = 0;
+   for (const auto pTrack : tracks) {
+      sampleCount start = 0, len = 0;
+      GetBounds(*pTrack, &start, &len);
+      total += len.as_double() * (multichannel ? 1 : pTrack->NChannels());
+   }
+   std::atomic<long long> done{ 0 };
+   std::atomic<bool> cancelled{ false };
+
+   // The calling thread processes no track, but reports progress meanwhile
+   ThreadPool pool{
+      std::min(tracks.size(), ThreadPool::HardwareConcurrency()) };
+   const auto batchSize = pool.GetConcurrency() - 1;
+   for (size_t first = 0; first < tracks.size(); first += batchSize) {
+      const auto last = std::min(tracks.size(), first + batchSize);
+
+      // Set up on this thread, where the instances are initialized, and
+      // where they may interact with the user
+      std::vector<std::vector<std::unique_ptr<Pass>>> batch(last - first);
+      size_t nInstances = 0;
+      const auto factory = [&] {
+         auto index = nInstances++;
+         if (index < recycledInstances.size())
+            return recycledInstances[index];
+         else
+            return recycledInstances.emplace_back(MakeInstance());
+      };
+      for (auto ii = first; ii < last; ++ii) {
+         auto &wt = *tracks[ii];
+         const auto visitChannel = [&](WaveChannel &chan, int channel) {
+            ChannelName map[3];
+            const auto numChannels =
+               MakeChannelMap(wt.NChannels(), channel, map);
+            WaveChannel *pRight{};
+            if (multichannel && numChannels == 2)
+               // TODO: more-than-two-channels
+               pRight = (*wt.Channels().rbegin()).get();
+
+            sampleCount start = 0, len = 0;
+            GetBounds(wt, &start, &len);
+            if (len > 0 && numAudioIn < 1)
+               return false;
+
+            const auto max = wt.GetMaxBlockSize() * 2;
+            const auto blockSize = instance.SetBlockSize(max);
+            if (blockSize == 0)
+               return false;
+            const auto bufferSize =
+               ((max + (blockSize - 1)) / blockSize) * blockSize;
+
+            auto &pass = *batch[ii - first].emplace_back(
+               std::make_unique<Pass>());
+            pass.position = start;
+            // New buffers are zeroed, as unused input channels must be
+            pass.inBuffers.Reinit(std::max(1u, numAudioIn), blockSize,
+               std::max<size_t>(1, bufferSize / blockSize));
+            pass.outBuffers.Reinit(numAudioOut, blockSize,
+               (bufferSize / blockSize) + 1);
+
+            const auto pollUser = [&, pPass = &pass](sampleCount inPos) {
+               done += (inPos - pPass->position).as_long_long();
+               pPass->position = inPos;
+               return !cancelled;
+            };
+            WideSampleSequence *pSeq = &chan;
+            if (pRight)
+               pSeq = &wt;
+            pass.pSource = std::make_unique<WideSampleSource>(
+               *pSeq, size_t(pRight ? 2 : 1), start, len, pollUser);
+            pass.pSink = std::make_unique<WaveTrackSink>(
+               chan, pRight, nullptr, start, true, effectiveFormat);
+            pass.pStage = EffectStage::Create(channel,
+               static_cast<const WideSampleSequence&>(wt).NChannels(),
+               *pass.pSource, pass.inBuffers, factory, settings,
+               wt.GetRate(), std::nullopt);
+            return pass.pStage != nullptr;
+         };
+         if (multichannel) {
+            if (!visitChannel(**wt.Channels().begin(), -1))
+               return false;
+         }
+         else {
+            int iChannel = 0;
+            for (const auto pChannel : wt.Channels())
+               if (!visitChannel(*pChannel, iChannel++))
+                  return false;
+         }
+      }
+
+      // Run the passes of each track in turn, tracks at once; only this
+      // thread may update the progress indicator
+      std::atomic<bool> failed{ false };
+      const auto poll = [&]{
+         if (TotalProgress(done / std::max(1.0, total)))
+            cancelled = true;
+      };
+      pool.ParallelForPolling(batch.size(), [&](size_t ii, size_t) {
+         for (auto &pPass : batch[ii]) {
+            if (failed)
+               return;
+            auto &pass = *pPass;
+            AudioGraph::Task task{
+               *pass.pStage, pass.outBuffers, *pass.pSink };
+            if (!task.RunLoop()) {
+               failed = true;
+               return;
+            }
+            pass.pSink->Flush(pass.outBuffers);
+            if (!pass.pSink->IsOk())
+               failed = true;
+         }
+      }, poll, std::chrono::milliseconds{ 50 });
+      // Instances are finalized here, as the passes are destroyed
+      if (failed)
+         return false;
+   }
+
+   return true;
+}
+
 bool PerTrackEffect::ProcessTrack(int channel, const Factory &factory,
    EffectSettings &settings,
    AudioGraph::Source &upstream, AudioGraph::Sink &sink,
    std::optional<sampleCount> genLength,
    const double sampleRate, const SampleTrack &wt,
-   Buffers &inBuffers, Buffers &outBuffers)
+   Buffers &inBuffers, Buffers &outBuffers, bool pipelined)
 {
    assert(upstream.AcceptsBuffers(inBuffers));
    assert(sink.AcceptsBuffers(outBuffers));
@@ -369,14 +541,32 @@ bool PerTrackEffect::ProcessTrack(int channel, const Factory &factory,
    assert(upstream.AcceptsBlockSize(blockSize));
    assert(blockSize == outBuffers.BlockSize());
 
-   auto pSource = EffectStage::Create(
-      channel, static_cast<const WideSampleSequence&>(wt).NChannels(), upstream,
-      inBuffers, factory, settings, sampleRate, genLength);
+   const auto makeStage = [&](AudioGraph::Source &source, Buffers &buffers
+   ) -> std::unique_ptr<AudioGraph::Source> {
+      auto pSource = EffectStage::Create(
+         channel, static_cast<const WideSampleSequence&>(wt).NChannels(),
+         source, buffers, factory, settings, sampleRate, genLength);
+      if (pSource) {
+         assert(pSource->AcceptsBlockSize(blockSize)); // post of ctor
+         assert(pSource->AcceptsBuffers(outBuffers));
+      }
+      return pSource;
+   };
+
+   if (pipelined) {
+      // Generators write new tracks, so writing may have a thread of its own;
+      // but the sink of a processor overwrites the blocks of the sequence that
+      // the source reads, and must stay on the same thread
+      using Threading = AudioGraph::PipelinedTask::Threading;
+      AudioGraph::PipelinedTask task{ upstream, inBuffers, makeStage,
+         outBuffers, sink, AudioGraph::PipelinedTask::DefaultQueueDepth,
+         genLength ? Threading::All : Threading::ProcessOnly };
+      return task.IsOk() && task.RunLoop();
+   }
+
+   const auto pSource = makeStage(upstream, inBuffers);
    if (!pSource)
       return false;
-   assert(pSource->AcceptsBlockSize(blockSize)); // post of ctor
-   assert(pSource->AcceptsBuffers(outBuffers));
-
    AudioGraph::Task task{ *pSource, outBuffers, sink };
    return task.RunLoop();
 }
@@ -21,6 +21,7 @@
 #include "SampleCount.h"
 #include <functional>
 #include <memory>
+#include <vector>
 
 class EffectOutputTracks;
 class SampleTrack;
@@ -77,12 +78,29 @@ protected:
 private:
    using Buffers = AudioGraph::Buffers;
 
+   //! Instances for the channels, reused in each pass and each batch
+   using Instances = std::vector<std::shared_ptr<EffectInstance>>;
+
    bool ProcessPass(TrackList &outputs,
-      Instance &instance, EffectSettings &settings);
+      Instance &instance, EffectSettings &settings,
+      Instances &recycledInstances);
+   //! ProcessPass() for an instance that CanProcessTracksConcurrently(),
+   //! when the effect is not a generator
+   /*!
+    Selected tracks are processed in batches, one track per thread.  Each
+    batch is set up and finalized on the calling thread, which meanwhile
+    reports the total progress over all tracks.  Cancellation stops all of
+    them.
+    */
+   bool ProcessPassConcurrently(TrackList &outputs,
+      Instance &instance, EffectSettings &settings,
+      Instances &recycledInstances);
    using Factory = std::function<std::shared_ptr<EffectInstance>()>;
    /*!
     Previous contents of inBuffers and outBuffers are ignored
     @param channel selects one channel if non-negative; else all channels
+    @param pipelined whether to process on another thread than reading, using
+    AudioGraph::PipelinedTask; writing also has its own thread if generating
 
     @pre `source.AcceptsBuffers(inBuffers)`
     @pre `source.AcceptsBlockSize(inBuffers.BlockSize())`
@@ -96,7 +114,7 @@ private:
       AudioGraph::Source &source, AudioGraph::Sink &sink,
       std::optional<sampleCount> genLength,
       double sampleRate, const SampleTrack &wt,
-      Buffers &inBuffers, Buffers &outBuffers);
+      Buffers &inBuffers, Buffers &outBuffers, bool pipelined);
 
    // TODO: put this in struct EffectContext? (Which doesn't exist yet)
    mutable std::shared_ptr<EffectOutputTracks> mpOutputTracks;
@@ -225,16 +225,19 @@ void FFT(size_t NumSamples,
  * This is merely a wrapper of RealFFTf() from RealFFTf.h.
  */
 
-void RealFFT(size_t NumSamples, const float *RealIn, float *RealOut, float *ImagOut)
+void RealFFT(size_t NumSamples, const float *RealIn, float *RealOut, float *ImagOut,
+   const FFTParam *hFFT)
 {
-   auto hFFT = GetFFT(NumSamples);
+   HFFT shared;
+   if (!hFFT)
+      hFFT = (shared = GetFFT(NumSamples)).get();
    Floats pFFT{ NumSamples };
    // Copy the data into the processing buffer
    for(size_t i = 0; i < NumSamples; i++)
       pFFT[i] = RealIn[i];
 
    // Perform the FFT
-   RealFFTf(pFFT.get(), hFFT.get());
+   RealFFTf(pFFT.get(), hFFT);
 
    // Copy the data into the real and imaginary outputs
    for (size_t i = 1; i<(NumSamples / 2); i++) {
@@ -264,9 +267,11 @@ void RealFFT(size_t NumSamples, const float *RealIn, float *RealOut, float *Imag
  * This is merely a wrapper of InverseRealFFTf() from RealFFTf.h.
  */
 void InverseRealFFT(size_t NumSamples, const float *RealIn, const float *ImagIn,
-		    float *RealOut)
+		    float *RealOut, const FFTParam *hFFT)
 {
-   auto hFFT = GetFFT(NumSamples);
+   HFFT shared;
+   if (!hFFT)
+      hFFT = (shared = GetFFT(NumSamples)).get();
    Floats pFFT{ NumSamples };
    // Copy the data into the processing buffer
    for (size_t i = 0; i < (NumSamples / 2); i++)
@@ -282,10 +287,10 @@ void InverseRealFFT(size_t NumSamples, const float *RealIn, const float *ImagIn,
    pFFT[1] = RealIn[NumSamples / 2];
 
    // Perform the FFT
-   InverseRealFFTf(pFFT.get(), hFFT.get());
+   InverseRealFFTf(pFFT.get(), hFFT);
 
    // Copy the data to the (purely real) output buffer
-   ReorderToTime(hFFT.get(), pFFT.get(), RealOut);
+   ReorderToTime(hFFT, pFFT.get(), RealOut);
 }
 
 /*
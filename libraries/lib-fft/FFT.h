@@ -35,6 +35,7 @@
 #include <wx/defs.h>
 
 class TranslatableString;
+struct FFTParam;
 
 /*
   Salvo Ventura - November 2006
@@ -71,20 +72,23 @@ void PowerSpectrum(size_t NumSamples, const float *In, float *Out);
  * want complex data as output.  The output arrays are the
  * same length as the input, but will be conjugate-symmetric
  * NumSamples must be a power of two.
+ * hFFT, if given, must be tables for NumSamples; else shared ones are used.
  */
 
 FFT_API
 void RealFFT(size_t NumSamples,
-             const float *RealIn, float *RealOut, float *ImagOut);
+             const float *RealIn, float *RealOut, float *ImagOut,
+             const FFTParam *hFFT = nullptr);
 
 /*
  * Computes an Inverse FFT when the input data is conjugate symmetric
  * so the output is purely real.  NumSamples must be a power of
- * two.
+ * two.  hFFT is as for RealFFT.
  */
 FFT_API
 void InverseRealFFT(size_t NumSamples,
-		    const float *RealIn, const float *ImagIn, float *RealOut);
+		    const float *RealIn, const float *ImagIn, float *RealOut,
+		    const FFTParam *hFFT = nullptr);
 
 /*
  * Computes a FFT of complex input and returns complex output.
@@ -38,21 +38,122 @@
 
 #include "RealFFTf.h"
 
+#include <atomic>
 #include <vector>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include <wx/thread.h>
 
+#include <pffft.h>
+
 #ifndef M_PI
 #define	M_PI		3.14159265358979323846  /* pi */
 #endif
 
+namespace {
+
+// pffft is used only where it is vectorized, and for sizes at least this,
+// below which rearranging its results costs more than it saves
+constexpr size_t MinVectorizedSize = 64;
+
+std::atomic<bool> forceScalar{ false };
+
+// Aligned buffers for pffft, one set per thread, because tables are shared
+class PffftBuffers
+{
+public:
+   ~PffftBuffers()
+   {
+      pffft_aligned_free(mData);
+   }
+
+   // Room for n floats, and after it, n more for pffft's work area
+   float *Get(size_t n)
+   {
+      if (n > mSize) {
+         pffft_aligned_free(mData);
+         mData = static_cast<float*>(
+            pffft_aligned_malloc(2 * n * sizeof(float)));
+         mSize = mData ? n : 0;
+      }
+      return mData;
+   }
+
+private:
+   float *mData{};
+   size_t mSize{};
+};
+
+float *GetPffftBuffers(size_t n)
+{
+   static thread_local PffftBuffers buffers;
+   return buffers.Get(n);
+}
+
+bool UseVectorized(const FFTParam *h)
+{
+   return h->pSetup && !forceScalar.load(std::memory_order_relaxed);
+}
+
+void RealFFTfRadix2(fft_type *buffer, const FFTParam *h);
+void InverseRealFFTfRadix2(fft_type *buffer, const FFTParam *h);
+
+// Transform with pffft, then put results where the radix-2 code would:
+// interleaved bins in bit-reversed order, with the Fs/2 bin in place of the
+// imaginary part of DC
+bool RealFFTfVectorized(fft_type *buffer, const FFTParam *h)
+{
+   const auto points = h->Points;
+   const auto data = GetPffftBuffers(2 * points);
+   if (!data)
+      return false;
+   const auto work = data + 2 * points;
+
+   memcpy(data, buffer, 2 * points * sizeof(float));
+   pffft_transform_ordered(h->pSetup.get(), data, data, work, PFFFT_FORWARD);
+
+   // pffft's ordered real spectrum also begins with DC and Fs/2
+   buffer[0] = data[0];
+   buffer[1] = data[1];
+   const int *br = h->BitReversed.get();
+   for (size_t i = 1; i < points; ++i) {
+      buffer[br[i]    ] = data[2 * i    ];
+      buffer[br[i] + 1] = data[2 * i + 1];
+   }
+   return true;
+}
+
+bool InverseRealFFTfVectorized(fft_type *buffer, const FFTParam *h)
+{
+   const auto points = h->Points;
+   const auto data = GetPffftBuffers(2 * points);
+   if (!data)
+      return false;
+   const auto work = data + 2 * points;
+
+   // The input is already ordered as pffft wants it
+   memcpy(data, buffer, 2 * points * sizeof(float));
+   pffft_transform_ordered(h->pSetup.get(), data, data, work, PFFFT_BACKWARD);
+
+   // pffft does not scale the inverse, as the radix-2 code does
+   const fft_type scale = 1.0f / (2 * points);
+   const int *br = h->BitReversed.get();
+   for (size_t i = 0; i < points; ++i) {
+      buffer[br[i]    ] = data[2 * i    ] * scale;
+      buffer[br[i] + 1] = data[2 * i + 1] * scale;
+   }
+   return true;
+}
+
+}
+
 /*
 *  Initialize the Sine table and Twiddle pointers (bit-reversed pointers)
 *  for the FFT routine.
 */
-HFFT InitializeFFT(size_t fftlen)
+HFFT InitializeFFT(size_t fftlen, bool vectorized = true)
 {
    int temp;
    HFFT h{ safenew FFTParam };
@@ -90,6 +191,10 @@ HFFT InitializeFFT(size_t fftlen)
          h->pow2Bits = i;
 #endif
 
+   if (vectorized && pffft_simd_size() > 1 && fftlen >= MinVectorizedSize)
+      h->pSetup.reset(pffft_new_setup(fftlen, PFFFT_REAL),
+         pffft_destroy_setup);
+
    return h;
 }
 
@@ -126,6 +231,11 @@ HFFT GetFFT(size_t fftlen)
    }
 }
 
+HFFT GetRadix2FFT(size_t fftlen)
+{
+   return InitializeFFT(fftlen, false);
+}
+
 /* Release a previously requested handle to the FFT tables */
 void FFTDeleter::operator() (FFTParam *hFFT) const
 {
@@ -159,6 +269,13 @@ void FFTDeleter::operator() (FFTParam *hFFT) const
 *        good when using fixed point arithmetic)
 */
 void RealFFTf(fft_type *buffer, const FFTParam *h)
+{
+   if (!(UseVectorized(h) && RealFFTfVectorized(buffer, h)))
+      RealFFTfRadix2(buffer, h);
+}
+
+namespace {
+void RealFFTfRadix2(fft_type *buffer, const FFTParam *h)
 {
    fft_type *A,*B;
    const fft_type *sptr;
@@ -239,6 +356,7 @@ void RealFFTf(fft_type *buffer, const FFTParam *h)
    buffer[0]+=buffer[1];
    buffer[1]=v1;
 }
+}
 
 
 /* Description: This routine performs an inverse FFT to real data.
@@ -261,6 +379,13 @@ void RealFFTf(fft_type *buffer, const FFTParam *h)
 *        good when using fixed point arithmetic)
 */
 void InverseRealFFTf(fft_type *buffer, const FFTParam *h)
+{
+   if (!(UseVectorized(h) && InverseRealFFTfVectorized(buffer, h)))
+      InverseRealFFTfRadix2(buffer, h);
+}
+
+namespace {
+void InverseRealFFTfRadix2(fft_type *buffer, const FFTParam *h)
 {
    fft_type *A,*B;
    const fft_type *sptr;
@@ -342,6 +467,7 @@ void InverseRealFFTf(fft_type *buffer, const FFTParam *h)
       ButterfliesPerGroup >>= 1;
    }
 }
+}
 
 void ReorderToFreq(const FFTParam *hFFT, const fft_type *buffer,
 		   fft_type *RealOut, fft_type *ImagOut)
@@ -365,3 +491,55 @@ void ReorderToTime(const FFTParam *hFFT, const fft_type *buffer, fft_type *TimeO
       TimeOut[i*2+1]=buffer[hFFT->BitReversed[i]+1];
    }
 }
+
+FFTFilterResponse::FFTFilterResponse() = default;
+FFTFilterResponse::FFTFilterResponse(FFTFilterResponse&&) = default;
+FFTFilterResponse &FFTFilterResponse::operator=(FFTFilterResponse&&) = default;
+FFTFilterResponse::~FFTFilterResponse() = default;
+
+FFTFilterResponse::FFTFilterResponse(
+   const FFTParam *h, const fft_type *real, const fft_type *imag)
+   : mReal(real, real + h->Points + 1)
+   , mImag(imag, imag + h->Points + 1)
+{
+}
+
+void FilterRealFFTf(fft_type *buffer, const FFTParam *h,
+   const FFTFilterResponse &response, fft_type *scratch)
+{
+   // The multiplication is scalar, in the order it always was, so that
+   // results are the same to the bit as before, with the same tables
+   const auto points = h->Points;
+   const auto &real = response.mReal;
+   const auto &imag = response.mImag;
+   const int *br = h->BitReversed.get();
+   fft_type re, im;
+
+   RealFFTf(buffer, h);
+
+   // DC component is purely real
+   scratch[0] = buffer[0] * real[0];
+   for (size_t i = 1; i < points; i++)
+   {
+      re = buffer[br[i]    ];
+      im = buffer[br[i] + 1];
+      scratch[2 * i    ] = re * real[i] - im * imag[i];
+      scratch[2 * i + 1] = re * imag[i] + im * real[i];
+   }
+   // Fs/2 component is purely real
+   scratch[1] = buffer[1] * real[points];
+
+   // Inverse FFT and normalization
+   InverseRealFFTf(scratch, h);
+   ReorderToTime(h, scratch, buffer);
+}
+
+const char *GetFFTImplementation(const FFTParam *hFFT)
+{
+   return UseVectorized(hFFT) ? "pffft" : "radix-2";
+}
+
+void ForceScalarFFT(bool force)
+{
+   forceScalar.store(force, std::memory_order_relaxed);
+}
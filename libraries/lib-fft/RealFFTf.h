@@ -3,11 +3,18 @@
 
 #include "MemoryX.h"
 
+#include <vector>
+
+struct PFFFT_Setup;
+
 using fft_type = float;
 struct FFTParam {
    ArrayOf<int> BitReversed;
    ArrayOf<fft_type> SinTable;
    size_t Points;
+   //! If not null, RealFFTf() and InverseRealFFTf() use this vectorized
+   //! implementation, and then rearrange results as the radix-2 code would
+   std::shared_ptr<PFFFT_Setup> pSetup;
 #ifdef EXPERIMENTAL_EQ_SSE_THREADED
    int pow2Bits;
 #endif
@@ -22,11 +29,51 @@ using HFFT = std::unique_ptr<
 >;
 
 FFT_API HFFT GetFFT(size_t);
+//! Tables for the portable radix-2 code only, not shared
+/*! Transforms with these give the same results, to the bit, whatever the
+ instruction set */
+FFT_API HFFT GetRadix2FFT(size_t);
 FFT_API void RealFFTf(fft_type *, const FFTParam *);
 FFT_API void InverseRealFFTf(fft_type *, const FFTParam *);
 FFT_API void ReorderToTime(const FFTParam *hFFT, const fft_type *buffer, fft_type *TimeOut);
 FFT_API void ReorderToFreq(const FFTParam *hFFT, const fft_type *buffer,
 		   fft_type *RealOut, fft_type *ImagOut);
 
+//! Frequency response of a filter, prepared for FilterRealFFTf()
+class FFT_API FFTFilterResponse final
+{
+public:
+   FFTFilterResponse();
+   //! `real` and `imag` give the response of the bins from DC to Fs/2, so
+   //! each has `h->Points + 1` values; the imaginary parts of DC and Fs/2
+   //! are ignored
+   FFTFilterResponse(
+      const FFTParam *h, const fft_type *real, const fft_type *imag);
+   FFTFilterResponse(FFTFilterResponse&&);
+   FFTFilterResponse &operator=(FFTFilterResponse&&);
+   ~FFTFilterResponse();
+
+private:
+   friend FFT_API void FilterRealFFTf(fft_type *, const FFTParam *,
+      const FFTFilterResponse &, fft_type *);
+
+   std::vector<fft_type> mReal, mImag;
+};
+
+//! Fast convolution: transform `2 * h->Points` samples in place to
+//! frequency, multiply by the response, and transform back to time
+/*! `scratch` has room for `2 * h->Points` values.  The response must have
+ been prepared with the same tables. */
+FFT_API void FilterRealFFTf(fft_type *buffer, const FFTParam *h,
+   const FFTFilterResponse &response, fft_type *scratch);
+
+//! Name of the implementation that transforms with these tables, for
+//! diagnostics
+FFT_API const char *GetFFTImplementation(const FFTParam *);
+
+//! Use the portable radix-2 code only, or restore the run time choice
+/*! For testing and benchmarking */
+FFT_API void ForceScalarFFT(bool force);
+
 #endif
 
@@ -0,0 +1,215 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  RealFFTfTests.cpp
+
+**********************************************************************/
+#include "RealFFTf.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<float> RandomSamples(size_t count)
+{
+   std::mt19937 engine { 0 };
+   std::uniform_real_distribution<float> distribution { -1.f, 1.f };
+   std::vector<float> samples(count);
+   for (auto& sample : samples)
+      sample = distribution(engine);
+   return samples;
+}
+
+std::vector<float> Forward(std::vector<float> buffer, bool scalar)
+{
+   const auto hFFT = GetFFT(buffer.size());
+   ForceScalarFFT(scalar);
+   RealFFTf(buffer.data(), hFFT.get());
+   ForceScalarFFT(false);
+   return buffer;
+}
+
+std::vector<float> Inverse(std::vector<float> buffer, bool scalar)
+{
+   const auto hFFT = GetFFT(buffer.size());
+   ForceScalarFFT(scalar);
+   InverseRealFFTf(buffer.data(), hFFT.get());
+   ForceScalarFFT(false);
+   std::vector<float> result(buffer.size());
+   ReorderToTime(hFFT.get(), buffer.data(), result.data());
+   return result;
+}
+
+// Bins in order, as the inverse takes them
+std::vector<float> Reorder(const std::vector<float>& buffer)
+{
+   const auto hFFT = GetFFT(buffer.size());
+   std::vector<float> result(buffer.size());
+   result[0] = buffer[0];
+   result[1] = buffer[1];
+   for (size_t i = 1; i < hFFT->Points; ++i) {
+      result[2 * i] = buffer[hFFT->BitReversed[i]];
+      result[2 * i + 1] = buffer[hFFT->BitReversed[i] + 1];
+   }
+   return result;
+}
+
+float MaxDifference(const std::vector<float>& a, const std::vector<float>& b)
+{
+   float result = 0;
+   for (size_t i = 0; i < a.size(); ++i)
+      result = std::max(result, std::abs(a[i] - b[i]));
+   return result;
+}
+} // namespace
+
+TEST_CASE("RealFFTf implementations agree")
+{
+   for (size_t size = 8; size <= 65536; size *= 2) {
+      const auto samples = RandomSamples(size);
+      const auto scalar = Forward(samples, true);
+      const auto chosen = Forward(samples, false);
+      // Bins of unit random samples have magnitudes about sqrt(size)
+      REQUIRE(MaxDifference(scalar, chosen) < 1e-5f * size);
+   }
+}
+
+TEST_CASE("InverseRealFFTf undoes RealFFTf")
+{
+   for (size_t size = 8; size <= 65536; size *= 2) {
+      const auto samples = RandomSamples(size);
+      for (const auto scalar : { true, false }) {
+         const auto result =
+            Inverse(Reorder(Forward(samples, scalar)), scalar);
+         REQUIRE(MaxDifference(samples, result) < 1e-5f * std::log2(size));
+      }
+   }
+}
+
+TEST_CASE("RealFFTf of a cosine")
+{
+   constexpr size_t size = 1024, bin = 37;
+   std::vector<float> samples(size);
+   for (size_t i = 0; i < size; ++i)
+      samples[i] = std::cos(2 * M_PI * bin * i / size);
+   for (const auto scalar : { true, false }) {
+      const auto result = Reorder(Forward(samples, scalar));
+      REQUIRE(result[2 * bin] == Approx(size / 2).margin(1e-3));
+      REQUIRE(result[2 * bin + 1] == Approx(0).margin(1e-3));
+      REQUIRE(result[2 * (bin + 1)] == Approx(0).margin(1e-3));
+   }
+}
+
+TEST_CASE("FilterRealFFTf convolves")
+{
+   for (size_t size = 8; size <= 16384; size *= 4) {
+      const auto samples = RandomSamples(size);
+      // A short impulse response, and its frequency response
+      std::vector<float> impulse(size);
+      for (size_t i = 0; i < std::min<size_t>(size, 5); ++i)
+         impulse[i] = 1.0f / (i + 1);
+      const auto hFFT = GetFFT(size);
+      const auto bins = Reorder(Forward(impulse, true));
+      std::vector<float> real(hFFT->Points + 1), imag(hFFT->Points + 1);
+      real[0] = bins[0];
+      real[hFFT->Points] = bins[1];
+      for (size_t i = 1; i < hFFT->Points; ++i) {
+         real[i] = bins[2 * i];
+         imag[i] = bins[2 * i + 1];
+      }
+      const FFTFilterResponse response{ hFFT.get(), real.data(), imag.data() };
+
+      // Circular convolution, computed directly
+      std::vector<float> expected(size);
+      for (size_t i = 0; i < size; ++i)
+         for (size_t j = 0; j < 5 && j < size; ++j)
+            expected[i] += impulse[j] * samples[(i + size - j) % size];
+
+      for (const auto scalar : { true, false }) {
+         auto result = samples;
+         std::vector<float> scratch(size);
+         ForceScalarFFT(scalar);
+         FilterRealFFTf(result.data(), hFFT.get(), response, scratch.data());
+         ForceScalarFFT(false);
+         REQUIRE(MaxDifference(expected, result) < 1e-5f * std::log2(size));
+      }
+   }
+}
+
+TEST_CASE("Radix-2 tables give the same results, to the bit, anywhere")
+{
+   for (size_t size = 8; size <= 16384; size *= 2) {
+      const auto samples = RandomSamples(size);
+      const auto expected = Forward(samples, true);
+      const auto hFFT = GetRadix2FFT(size);
+      REQUIRE(std::string{ GetFFTImplementation(hFFT.get()) } == "radix-2");
+      auto result = samples;
+      RealFFTf(result.data(), hFFT.get());
+      REQUIRE(result == expected);
+
+      // The filter multiplies as it always did, in the same order
+      std::vector<float> real(hFFT->Points + 1), imag(hFFT->Points + 1);
+      for (size_t i = 0; i <= hFFT->Points; ++i) {
+         real[i] = samples[i];
+         imag[i] = i % hFFT->Points ? samples[size - 1 - i] : 0;
+      }
+      const FFTFilterResponse response{ hFFT.get(), real.data(), imag.data() };
+      const int *br = hFFT->BitReversed.get();
+      std::vector<float> scratch(size);
+      auto buffer = samples;
+      RealFFTf(buffer.data(), hFFT.get());
+      scratch[0] = buffer[0] * real[0];
+      for (size_t i = 1; i < hFFT->Points; i++) {
+         const auto re = buffer[br[i]];
+         const auto im = buffer[br[i] + 1];
+         scratch[2 * i] = re * real[i] - im * imag[i];
+         scratch[2 * i + 1] = re * imag[i] + im * real[i];
+      }
+      scratch[1] = buffer[1] * real[hFFT->Points];
+      InverseRealFFTf(scratch.data(), hFFT.get());
+      ReorderToTime(hFFT.get(), scratch.data(), buffer.data());
+
+      for (const auto scalar : { true, false }) {
+         result = samples;
+         ForceScalarFFT(scalar);
+         FilterRealFFTf(result.data(), hFFT.get(), response, scratch.data());
+         ForceScalarFFT(false);
+         REQUIRE(result == buffer);
+      }
+   }
+}
+
+TEST_CASE("RealFFTf benchmark", "[!benchmark]")
+{
+   for (size_t size = 64; size <= 65536; size *= 2) {
+      auto samples = RandomSamples(size);
+      const auto hFFT = GetFFT(size);
+      const auto iterations = (1 << 24) / size;
+      const auto time = [&](bool scalar) {
+         ForceScalarFFT(scalar);
+         const auto start = std::chrono::steady_clock::now();
+         for (size_t ii = 0; ii < iterations; ++ii) {
+            RealFFTf(samples.data(), hFFT.get());
+            InverseRealFFTf(samples.data(), hFFT.get());
+         }
+         ForceScalarFFT(false);
+         return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+      };
+      const auto scalarTime = time(true);
+      const auto chosenTime = time(false);
+      std::cout << "RealFFTf size " << size << ": radix-2 " << scalarTime
+                << " s, " << GetFFTImplementation(hFFT.get()) << " "
+                << chosenTime << " s\n";
+   }
+}
@@ -11,9 +11,16 @@ Max Maisel
 
 #include "Biquad.h"
 
+#include <algorithm>
 #include <cmath>
 #include <wx/utils.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BIQUAD_SSE2
+#include <emmintrin.h>
+#endif
+
 #define square(a) ((a)*(a))
 #define PI M_PI
 
@@ -41,6 +48,177 @@ void Biquad::Process(const float* pfIn, float* pfOut, int iNumSamples)
       *pfOut++ = ProcessOne(*pfIn++);
 }
 
+namespace {
+//! How many samples the second of a pair of sections runs behind the first
+constexpr size_t PairDelay = 4;
+
+#ifdef BIQUAD_SSE2
+//! Two biquads, one per vector lane, computing exactly as
+//! Biquad::ProcessOne() does
+struct BiquadLanes
+{
+   BiquadLanes() = default;
+   BiquadLanes(const Biquad &f0, const Biquad &f1)
+      : b0{ _mm_set_pd(f1.fNumerCoeffs[Biquad::B0], f0.fNumerCoeffs[Biquad::B0]) }
+      , b1{ _mm_set_pd(f1.fNumerCoeffs[Biquad::B1], f0.fNumerCoeffs[Biquad::B1]) }
+      , b2{ _mm_set_pd(f1.fNumerCoeffs[Biquad::B2], f0.fNumerCoeffs[Biquad::B2]) }
+      , a1{ _mm_set_pd(f1.fDenomCoeffs[Biquad::A1], f0.fDenomCoeffs[Biquad::A1]) }
+      , a2{ _mm_set_pd(f1.fDenomCoeffs[Biquad::A2], f0.fDenomCoeffs[Biquad::A2]) }
+      , prevIn{ _mm_set_pd(f1.fPrevIn, f0.fPrevIn) }
+      , prevPrevIn{ _mm_set_pd(f1.fPrevPrevIn, f0.fPrevPrevIn) }
+      , prevOut{ _mm_set_pd(f1.fPrevOut, f0.fPrevOut) }
+      , prevPrevOut{ _mm_set_pd(f1.fPrevPrevOut, f0.fPrevPrevOut) }
+   {}
+
+   void Store(Biquad &f0, Biquad &f1) const
+   {
+      _mm_storel_pd(&f0.fPrevIn, prevIn);
+      _mm_storeh_pd(&f1.fPrevIn, prevIn);
+      _mm_storel_pd(&f0.fPrevPrevIn, prevPrevIn);
+      _mm_storeh_pd(&f1.fPrevPrevIn, prevPrevIn);
+      _mm_storel_pd(&f0.fPrevOut, prevOut);
+      _mm_storeh_pd(&f1.fPrevOut, prevOut);
+      _mm_storel_pd(&f0.fPrevPrevOut, prevPrevOut);
+      _mm_storeh_pd(&f1.fPrevPrevOut, prevPrevOut);
+   }
+
+   //! @param in single precision values in the low two lanes
+   //! @return output rounded to single precision, in the low two lanes
+   __m128 ProcessOne(__m128 in)
+   {
+      const auto wide = _mm_cvtps_pd(in);
+      auto out = _mm_mul_pd(wide, b0);
+      out = _mm_add_pd(out, _mm_mul_pd(prevIn, b1));
+      out = _mm_add_pd(out, _mm_mul_pd(prevPrevIn, b2));
+      out = _mm_sub_pd(out, _mm_mul_pd(prevOut, a1));
+      out = _mm_sub_pd(out, _mm_mul_pd(prevPrevOut, a2));
+      prevPrevIn = prevIn;
+      prevIn = wide;
+      prevPrevOut = prevOut;
+      prevOut = out;
+      return _mm_cvtpd_ps(out);
+   }
+
+   __m128d b0, b1, b2, a1, a2;
+   __m128d prevIn, prevPrevIn, prevOut, prevPrevOut;
+};
+
+//! Apply f0 then f1, running f1 some samples behind f0 in the other lane
+/*!
+ The second section reads back what the first wrote to pfOut, rather than
+ taking it from a register, so that the conversions and the whole of the
+ first section's sum are not in the recursion of the loop.
+ */
+void ProcessPair(Biquad &f0, Biquad &f1,
+   const float* pfIn, float* pfOut, size_t len)
+{
+   if (len <= PairDelay) {
+      f0.Process(pfIn, pfOut, static_cast<int>(len));
+      f1.Process(pfOut, pfOut, static_cast<int>(len));
+      return;
+   }
+   // Only the first section has samples to take at first
+   f0.Process(pfIn, pfOut, PairDelay);
+   BiquadLanes lanes{ f0, f1 };
+   for (size_t i = PairDelay; i < len; ++i) {
+      // Sample i enters f0 while sample i - PairDelay enters f1
+      const auto out = lanes.ProcessOne(_mm_unpacklo_ps(
+         _mm_load_ss(&pfIn[i]), _mm_load_ss(&pfOut[i - PairDelay])));
+      _mm_store_ss(&pfOut[i], out);
+      _mm_store_ss(&pfOut[i - PairDelay], _mm_shuffle_ps(out, out, 1));
+   }
+   lanes.Store(f0, f1);
+   // And only the second section has samples to take at last
+   const auto rest = pfOut + len - PairDelay;
+   f1.Process(rest, rest, PairDelay);
+}
+
+//! Sections applied together to each sample of a pair of channels
+constexpr size_t MaxChained = 4;
+
+void ProcessChannelPair(Biquad* pSections0, Biquad* pSections1,
+   size_t nSections, const float* pfIn0, const float* pfIn1,
+   float* pfOut0, float* pfOut1, size_t len)
+{
+   BiquadLanes lanes[MaxChained];
+   for (size_t iSection = 0; iSection < nSections; iSection += MaxChained) {
+      const auto nChained = std::min(MaxChained, nSections - iSection);
+      for (size_t j = 0; j < nChained; ++j)
+         lanes[j] = { pSections0[iSection + j], pSections1[iSection + j] };
+      for (size_t i = 0; i < len; ++i) {
+         auto value = _mm_unpacklo_ps(_mm_load_ss(&pfIn0[i]),
+            _mm_load_ss(&pfIn1[i]));
+         for (size_t j = 0; j < nChained; ++j)
+            value = lanes[j].ProcessOne(value);
+         _mm_store_ss(&pfOut0[i], value);
+         _mm_store_ss(&pfOut1[i], _mm_shuffle_ps(value, value, 1));
+      }
+      for (size_t j = 0; j < nChained; ++j)
+         lanes[j].Store(pSections0[iSection + j], pSections1[iSection + j]);
+      pfIn0 = pfOut0;
+      pfIn1 = pfOut1;
+   }
+}
+#else
+//! Apply f0 then f1, running f1 some samples behind f0 so that the two
+//! recursions may overlap
+void ProcessPair(Biquad &f0, Biquad &f1,
+   const float* pfIn, float* pfOut, size_t len)
+{
+   if (len <= PairDelay) {
+      f0.Process(pfIn, pfOut, static_cast<int>(len));
+      f1.Process(pfOut, pfOut, static_cast<int>(len));
+      return;
+   }
+   // Work on copies, which the compiler can keep in registers
+   auto s0 = f0, s1 = f1;
+   s0.Process(pfIn, pfOut, PairDelay);
+   for (size_t i = PairDelay; i < len; ++i) {
+      pfOut[i] = s0.ProcessOne(pfIn[i]);
+      pfOut[i - PairDelay] = s1.ProcessOne(pfOut[i - PairDelay]);
+   }
+   const auto rest = pfOut + len - PairDelay;
+   s1.Process(rest, rest, PairDelay);
+   f0 = s0;
+   f1 = s1;
+}
+#endif
+}
+
+void Biquad::ProcessCascade(Biquad* pSections, size_t nSections,
+   const float* pfIn, float* pfOut, size_t len)
+{
+   if (nSections == 0) {
+      std::copy(pfIn, pfIn + len, pfOut);
+      return;
+   }
+   size_t iSection = 0;
+   for (; iSection + 1 < nSections; iSection += 2) {
+      ProcessPair(pSections[iSection], pSections[iSection + 1],
+         pfIn, pfOut, len);
+      pfIn = pfOut;
+   }
+   if (iSection < nSections)
+      pSections[iSection].Process(pfIn, pfOut, static_cast<int>(len));
+}
+
+void Biquad::ProcessCascades(Biquad* const* ppSections, size_t nSections,
+   size_t nChannels, const float* const* ppIn, float* const* ppOut,
+   size_t len)
+{
+   size_t iChannel = 0;
+#ifdef BIQUAD_SSE2
+   if (nSections > 0)
+      for (; iChannel + 1 < nChannels; iChannel += 2)
+         ProcessChannelPair(ppSections[iChannel], ppSections[iChannel + 1],
+            nSections, ppIn[iChannel], ppIn[iChannel + 1],
+            ppOut[iChannel], ppOut[iChannel + 1], len);
+#endif
+   for (; iChannel < nChannels; ++iChannel)
+      ProcessCascade(ppSections[iChannel], nSections,
+         ppIn[iChannel], ppOut[iChannel], len);
+}
+
 const double Biquad::s_fChebyCoeffs[MAX_Order][MAX_Order + 1] =
 {
    // For Chebyshev polynomials of the first kind (see http://en.wikipedia.org/wiki/Chebyshev_polynomial)
@@ -21,6 +21,24 @@ struct MATH_API Biquad
    void Reset();
    void Process(const float* pfIn, float* pfOut, int iNumSamples);
 
+   /// Apply sections in order, with results identical to calling Process()
+   /// of each in turn
+   /*!
+    Sections are taken in pairs, which run in one pass, one sample apart, so
+    that their recursions overlap.  pfIn may equal pfOut.
+    */
+   static void ProcessCascade(Biquad* pSections, size_t nSections,
+      const float* pfIn, float* pfOut, size_t len);
+
+   /// ProcessCascade() for several channels, each with its own sections
+   /*!
+    Channels are taken in pairs, one per vector lane; an odd channel is done
+    alone.  Inputs may equal outputs.
+    */
+   static void ProcessCascades(Biquad* const* ppSections, size_t nSections,
+      size_t nChannels, const float* const* ppIn, float* const* ppOut,
+      size_t len);
+
    enum
    {
       /// Numerator coefficient indices
@@ -9,13 +9,37 @@ Max Maisel
 ***********************************************************************/
 
 #include "EBUR128.h"
+#include <algorithm>
 #include <cstring>
 
-EBUR128::EBUR128(double rate, size_t channels)
+namespace {
+// Polyphase FIR interpolating by 4, from ITU-R BS.1770-4 Annex 2
+constexpr float TruePeakCoeffs[4][12] = {
+   {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,
+      0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+      0.9721679687500f, -0.1022949218750f,  0.0476074218750f,
+     -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+   { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,
+      0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+      0.7797851562500f, -0.2003173828125f,  0.1015625000000f,
+     -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+   { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,
+      0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+      0.4650878906250f, -0.1665039062500f,  0.0891113281250f,
+     -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+   { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,
+      0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+      0.1373291015625f, -0.0594482421875f,  0.0332031250000f,
+     -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+}
+
+EBUR128::EBUR128(double rate, size_t channels, bool truePeak)
    : mChannelCount{ channels }
    , mRate{ rate }
    , mBlockSize( ceil(0.4 * mRate) ) // 400 ms blocks
    , mBlockOverlap( ceil(0.1 * mRate) ) // 100 ms overlap
+   , mMeasureTruePeak{ truePeak }
 {
    mLoudnessHist.reinit(HIST_BIN_COUNT, false);
    mBlockRingBuffer.reinit(mBlockSize);
@@ -29,6 +53,21 @@ EBUR128::EBUR128(double rate, size_t channels)
       mWeightingFilter[channel][0].Reset();
       mWeightingFilter[channel][1].Reset();
    }
+
+   mWeighted.reinit(mChannelCount);
+   mSections.reinit(mChannelCount);
+   mWeightedPointers.reinit(mChannelCount);
+   for (size_t channel = 0; channel < mChannelCount; ++channel) {
+      mWeighted[channel].reinit(ChunkSize);
+      mSections[channel] = mWeightingFilter[channel].get();
+      mWeightedPointers[channel] = mWeighted[channel].get();
+   }
+   mPower.reinit(ChunkSize);
+   if (mMeasureTruePeak) {
+      mTruePeakInput.reinit(mChannelCount);
+      for (size_t channel = 0; channel < mChannelCount; ++channel)
+         mTruePeakInput[channel].reinit(TruePeakTaps - 1 + ChunkSize, true);
+   }
 }
 
 // fs: sample rate
@@ -112,6 +151,79 @@ void EBUR128::NextSample()
    ++mSampleCount;
 }
 
+void EBUR128::ProcessBlock(const float *const *buffers, size_t len)
+{
+   ArrayOf<const float*> offsetBuffers{ mChannelCount };
+   for (size_t done = 0; done < len;) {
+      const auto chunkLen = std::min(ChunkSize, len - done);
+      for (size_t channel = 0; channel < mChannelCount; ++channel)
+         offsetBuffers[channel] = buffers[channel] + done;
+      WeightChannels(offsetBuffers.get(), chunkLen);
+      if (mMeasureTruePeak)
+         MeasureTruePeak(offsetBuffers.get(), chunkLen);
+
+      // Fill the ring buffer, stopping where NextSample() would complete
+      // a block or close the ring
+      for (size_t i = 0; i < chunkLen;) {
+         const auto count = std::min({ chunkLen - i,
+            mBlockOverlap - mBlockRingPos % mBlockOverlap,
+            mBlockSize - mBlockRingPos });
+         std::copy(&mPower[i], &mPower[i] + count,
+            &mBlockRingBuffer[mBlockRingPos]);
+         i += count;
+         mBlockRingPos += count;
+         mBlockRingSize += count;
+         mSampleCount += count;
+         if (mBlockRingPos % mBlockOverlap == 0 && mBlockRingSize >= mBlockSize)
+            AddBlockToHistogram(mBlockSize);
+         if (mBlockRingPos == mBlockSize)
+            mBlockRingPos = 0;
+      }
+      done += chunkLen;
+   }
+}
+
+void EBUR128::WeightChannels(const float *const *buffers, size_t len)
+{
+   // The filters are recursive, so this vectorizes across channels, and
+   // across the two filters of a channel
+   Biquad::ProcessCascades(mSections.get(), 2, mChannelCount, buffers,
+      mWeightedPointers.get(), len);
+
+   // Add the power of additional channels to the power of first channel,
+   // in the same order as ProcessSampleFromChannel()
+   for (size_t channel = 0; channel < mChannelCount; ++channel) {
+      const auto weighted = mWeighted[channel].get();
+      if (channel == 0)
+         for (size_t i = 0; i < len; ++i)
+            mPower[i] = double(weighted[i]) * weighted[i];
+      else
+         for (size_t i = 0; i < len; ++i)
+            mPower[i] += double(weighted[i]) * weighted[i];
+   }
+}
+
+void EBUR128::MeasureTruePeak(const float *const *buffers, size_t len)
+{
+   constexpr auto history = TruePeakTaps - 1;
+   float peak = mTruePeak;
+   for (size_t channel = 0; channel < mChannelCount; ++channel) {
+      const auto input = mTruePeakInput[channel].get();
+      std::copy(buffers[channel], buffers[channel] + len, input + history);
+      for (const auto &coeffs : TruePeakCoeffs)
+         for (size_t i = 0; i < len; ++i) {
+            // input[i + history] is the newest sample
+            float sum = 0;
+            for (size_t j = 0; j < TruePeakTaps; ++j)
+               sum += coeffs[j] * input[i + history - j];
+            peak = std::max(peak, std::abs(sum));
+         }
+      // Keep the history for the next chunk
+      std::copy(input + len, input + len + history, input);
+   }
+   mTruePeak = peak;
+}
+
 double EBUR128::IntegrativeLoudness()
 {
    // EBU R128: z_i = mean square without root
@@ -21,7 +21,10 @@ Max Maisel
 class MATH_API EBUR128
 {
 public:
-   EBUR128(double rate, size_t channels);
+   /*!
+    @param truePeak whether ProcessBlock() also measures the true peak
+    */
+   EBUR128(double rate, size_t channels, bool truePeak = false);
    EBUR128(const EBUR128&) = delete;
    EBUR128(EBUR128&&) = delete;
    ~EBUR128() = default;
@@ -29,6 +32,19 @@ public:
    static ArrayOf<Biquad> CalcWeightingFilter(double fs);
    void ProcessSampleFromChannel(float x_in, size_t channel) const;
    void NextSample();
+
+   //! Process `len` samples of every channel at once
+   /*!
+    Gives the same result as ProcessSampleFromChannel() for each channel
+    followed by NextSample(), sample by sample, but faster.
+    @param buffers one pointer to `len` samples for each channel
+    */
+   void ProcessBlock(const float *const *buffers, size_t len);
+
+   //! Greatest absolute value of the signal oversampled 4x, as in
+   //! ITU-R BS.1770 Annex 2, of the samples passed to ProcessBlock()
+   /*! Zero unless enabled in the constructor */
+   double TruePeak() const { return mTruePeak; }
    double IntegrativeLoudness();
    inline double IntegrativeLoudnessToLUFS(double loudness)
       { return 10 * log10(loudness); }
@@ -36,6 +52,14 @@ public:
 private:
    void HistogramSums(size_t start_idx, double& sum_v, long int& sum_c) const;
    void AddBlockToHistogram(size_t validLen);
+   //! Store the K-weighted power of `len` <= ChunkSize samples in mPower
+   void WeightChannels(const float *const *buffers, size_t len);
+   void MeasureTruePeak(const float *const *buffers, size_t len);
+
+   //! ProcessBlock() works on pieces of at most this many samples
+   static constexpr size_t ChunkSize = 1024;
+   //! Taps of each phase of the true peak interpolation filter
+   static constexpr size_t TruePeakTaps = 12;
 
    static constexpr size_t HIST_BIN_COUNT = 65536;
    /// EBU R128 absolute threshold
@@ -55,6 +79,21 @@ private:
    /// CHANNEL = LEFT/RIGHT (0/1) and
    /// FILTER  = HSF/HPF    (0/1)
    ArrayOf<ArrayOf<Biquad>> mWeightingFilter;
+
+   //! Work space of ProcessBlock(): K-weighted samples of each channel,
+   //! and the sum over channels of their squares
+   ArrayOf<Floats> mWeighted;
+   Doubles mPower;
+   //! Pointers into mWeightingFilter and mWeighted, for
+   //! Biquad::ProcessCascades()
+   ArrayOf<Biquad*> mSections;
+   ArrayOf<float*> mWeightedPointers;
+
+   //! For each channel, the last TruePeakTaps - 1 samples, followed by
+   //! room for a chunk
+   ArrayOf<Floats> mTruePeakInput;
+   double mTruePeak{ 0 };
+   const bool mMeasureTruePeak;
 };
 
 #endif
@@ -29,6 +29,10 @@
 
 #include <soxr.h>
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
 Resample::Resample(const bool useBestMethod, const double dMinFactor, const double dMaxFactor)
 {
    this->SetMethod(useBestMethod);
@@ -111,6 +115,56 @@ std::pair<size_t, size_t>
    return { idone, odone };
 }
 
+namespace {
+//! Input samples, at a conversion ratio of at most 1, more than enough for
+//! the longest filters of soxr to settle
+constexpr long long MarginSamples = 1 << 15;
+//! A segment must be this many times longer than a margin to be worth its
+//! warm-up
+constexpr long long MinSegmentMargins = 16;
+}
+
+auto Resample::MakeSegments(
+   int fromRate, int toRate, sampleCount inLen, size_t nSegments)
+   -> std::vector<Segment>
+{
+   // Input samples at multiples of period have outputs falling on them, at
+   // multiples of outPeriod
+   const auto divisor = std::gcd(fromRate, toRate);
+   const long long period = fromRate / divisor;
+   const long long outPeriod = toRate / divisor;
+
+   // Filters are longer, in input samples, when reducing the rate
+   const auto stretch = std::max(1.0, double(fromRate) / toRate);
+   const auto margin = period *
+      static_cast<long long>(std::ceil(MarginSamples * stretch / period));
+   const auto len = inLen.as_long_long();
+   nSegments = static_cast<size_t>(std::clamp<long long>(
+      len / (MinSegmentMargins * margin), 1, std::max<size_t>(1, nSegments)));
+   if (nSegments == 1)
+      return { { 0, inLen, 0, {} } };
+
+   std::vector<Segment> result;
+   result.reserve(nSegments);
+   for (size_t ii = 0; ii < nSegments; ++ii) {
+      const auto boundary = [&](size_t jj) {
+         return len * static_cast<long long>(jj)
+            / static_cast<long long>(nSegments) / period * period;
+      };
+      const auto start = boundary(ii);
+      const auto inStart = std::max(0LL, start - margin);
+      const sampleCount skip = (start - inStart) / period * outPeriod;
+      if (ii + 1 == nSegments)
+         result.push_back({ inStart, inLen, skip, {} });
+      else {
+         const auto end = boundary(ii + 1);
+         result.push_back({ inStart, std::min(len, end + margin), skip,
+            sampleCount{ (end - start) / period * outPeriod } });
+      }
+   }
+   return result;
+}
+
 void Resample::SetMethod(const bool useBestMethod)
 {
    if (useBestMethod)
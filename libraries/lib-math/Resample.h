@@ -12,7 +12,10 @@
 #ifndef __AUDACITY_RESAMPLE_H__
 #define __AUDACITY_RESAMPLE_H__
 
+#include "SampleCount.h"
 #include "SampleFormat.h"
+#include <optional>
+#include <vector>
 
 template< typename Enum > class EnumSetting;
 
@@ -78,6 +81,30 @@ class MATH_API Resample final
                         float       *outBuffer,
                         size_t       outBufferLen);
 
+   //! A part of a constant-rate conversion that can be done apart from the
+   //! others, by a new Resample
+   struct Segment {
+      //! Range of input to feed, the last of it with lastFlag set
+      sampleCount inStart, inEnd;
+      //! How many outputs to discard first, made while warming up
+      sampleCount skip;
+      //! How many outputs to keep after those; all, if absent
+      std::optional<sampleCount> keep;
+   };
+
+   /** @brief Cut a constant-rate conversion of a long input into segments
+    *
+    * Boundaries fall at multiples of the input period where whole outputs
+    * fall too.  Each segment also feeds some input before and after what it
+    * keeps, long enough for the filters to settle, so that the kept outputs,
+    * concatenated, match one pass within float tolerance.
+    @param nSegments most segments wanted; fewer are made if input is short
+    @return at least one segment; just one, feeding all input, if the input
+    is too short to cut
+   */
+   static std::vector<Segment> MakeSegments(
+      int fromRate, int toRate, sampleCount inLen, size_t nSegments);
+
  protected:
    void SetMethod(const bool useBestMethod);
 
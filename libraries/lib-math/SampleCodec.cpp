@@ -0,0 +1,493 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SampleCodec.cpp
+
+**********************************************************************/
+
+#include "SampleCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace SampleCodec {
+namespace {
+
+// Layout of an encoded block, all little endian:
+//    4 bytes   number of samples
+//    1 byte    Domain
+//    3 bytes   reserved, zero
+//    4 bytes   offset of each frame from the start of the block
+//    frames
+// A frame is:
+//    1 byte    predictor order, or VerbatimFrame
+//    4 bytes   for each warm-up sample (as many as the order), or for each
+//              sample of a verbatim frame
+//    then, for each partition with residuals, a 5 bit Rice parameter and the
+//    Rice codes, padded to a byte at the end of the frame
+constexpr size_t HeaderSize = 8;
+constexpr size_t FrameSize = 4096;
+constexpr size_t PartitionSize = 256;
+constexpr unsigned MaxOrder = 4;
+constexpr uint8_t VerbatimFrame = 0xFF;
+constexpr unsigned RiceParameterBits = 5;
+constexpr unsigned MaxRiceParameter = 30;
+// Quotients this large are written as this many zeros, then all the bits of
+// the value, so that outliers cost no more than 57 bits
+constexpr unsigned EscapeQuotient = 24;
+
+//! What the coded integers are
+enum Domain : uint8_t {
+   Integer = 0, //!< The samples, which are int16Sample or int24Sample
+   Float16 = 15, //!< float samples times 2^15
+   Float24 = 23, //!< float samples times 2^23
+};
+
+void PutU32(std::vector<unsigned char> &out, uint32_t value)
+{
+   for (auto shift : { 0, 8, 16, 24 })
+      out.push_back(static_cast<unsigned char>(value >> shift));
+}
+
+void SetU32(unsigned char *p, uint32_t value)
+{
+   for (auto shift : { 0, 8, 16, 24 })
+      *p++ = static_cast<unsigned char>(value >> shift);
+}
+
+uint32_t GetU32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+unsigned CountLeadingZeros(uint32_t x)
+{
+   // x is not zero
+#if defined(_MSC_VER)
+   unsigned long index;
+   _BitScanReverse(&index, x);
+   return 31 - index;
+#else
+   return __builtin_clz(x);
+#endif
+}
+
+class BitWriter final
+{
+public:
+   explicit BitWriter(std::vector<unsigned char> &out) : mOut{ out } {}
+
+   //! Write the low n bits of value, n <= 32
+   void Write(uint32_t value, unsigned n)
+   {
+      const auto mask = (uint64_t{ 1 } << n) - 1;
+      mBuffer = (mBuffer << n) | (value & mask);
+      mCount += n;
+      while (mCount >= 8)
+      {
+         mCount -= 8;
+         mOut.push_back(static_cast<unsigned char>(mBuffer >> mCount));
+      }
+   }
+
+   void WriteRice(uint32_t value, unsigned k)
+   {
+      const auto quotient = value >> k;
+      if (quotient < EscapeQuotient)
+      {
+         // Quotient in unary: zeros, then a one
+         Write(1, quotient + 1);
+         Write(value, k);
+      }
+      else
+      {
+         Write(0, EscapeQuotient);
+         Write(value, 32);
+      }
+   }
+
+   //! Pad to a byte
+   void Flush()
+   {
+      if (mCount > 0)
+         Write(0, 8 - mCount);
+   }
+
+private:
+   std::vector<unsigned char> &mOut;
+   uint64_t mBuffer{};
+   unsigned mCount{};
+};
+
+//! Reads zeros past the end, and remembers having done so
+class BitReader final
+{
+public:
+   BitReader(const unsigned char *begin, const unsigned char *end)
+      : mNext{ begin }, mEnd{ end }
+   {}
+
+   //! Read n bits, n <= 32
+   uint32_t Read(unsigned n)
+   {
+      Fill(n);
+      mCount -= n;
+      return static_cast<uint32_t>(
+         (mBuffer >> mCount) & ((uint64_t{ 1 } << n) - 1));
+   }
+
+   uint32_t ReadRice(unsigned k)
+   {
+      // Look at enough bits for the longest unary quotient and its one
+      Fill(EscapeQuotient + 1);
+      const auto window = static_cast<uint32_t>(
+         (mBuffer >> (mCount - (EscapeQuotient + 1))) &
+         ((1u << (EscapeQuotient + 1)) - 1));
+      if ((window >> 1) == 0)
+      {
+         mCount -= EscapeQuotient;
+         return Read(32);
+      }
+      const auto quotient =
+         CountLeadingZeros(window) - (32 - (EscapeQuotient + 1));
+      mCount -= quotient + 1;
+      return (quotient << k) | Read(k);
+   }
+
+   //! Whether more bits were read than there are
+   bool Overrun() const
+   {
+      return mPadding * 8 > mCount;
+   }
+
+private:
+   void Fill(unsigned n)
+   {
+      while (mCount < n)
+      {
+         unsigned char byte = 0;
+         if (mNext != mEnd)
+            byte = *mNext++;
+         else
+            ++mPadding;
+         mBuffer = (mBuffer << 8) | byte;
+         mCount += 8;
+      }
+   }
+
+   const unsigned char *mNext;
+   const unsigned char *const mEnd;
+   uint64_t mBuffer{};
+   unsigned mCount{};
+   size_t mPadding{};
+};
+
+uint32_t ZigZag(int64_t residual)
+{
+   return static_cast<uint32_t>(
+      (static_cast<uint64_t>(residual) << 1) ^
+      static_cast<uint64_t>(residual >> 63));
+}
+
+int32_t UnZigZag(uint32_t value)
+{
+   return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+template<unsigned Order> int64_t Predict(const int32_t *x)
+{
+   // x points at the sample to predict
+   if constexpr (Order == 0)
+      return 0;
+   else if constexpr (Order == 1)
+      return x[-1];
+   else if constexpr (Order == 2)
+      return 2 * int64_t{ x[-1] } - x[-2];
+   else if constexpr (Order == 3)
+      return 3 * (int64_t{ x[-1] } - x[-2]) + x[-3];
+   else
+      return 4 * (int64_t{ x[-1] } + x[-3]) - 6 * int64_t{ x[-2] } - x[-4];
+}
+
+int64_t Residual(unsigned order, const int32_t *x)
+{
+   switch (order) {
+   case 0: return x[0] - Predict<0>(x);
+   case 1: return x[0] - Predict<1>(x);
+   case 2: return x[0] - Predict<2>(x);
+   case 3: return x[0] - Predict<3>(x);
+   default: return x[0] - Predict<4>(x);
+   }
+}
+
+//! Choose the Rice parameter near log2 of the mean
+unsigned RiceParameter(uint64_t sum, size_t count)
+{
+   unsigned k = 0;
+   while (k < MaxRiceParameter && (uint64_t{ count } << (k + 1)) <= sum)
+      ++k;
+   return k;
+}
+
+//! Estimate of bits for residuals from their sum and count
+uint64_t RiceBits(uint64_t sum, size_t count)
+{
+   const auto k = RiceParameter(sum, count);
+   return (sum >> k) + count * (k + 1);
+}
+
+void EncodeVerbatim(
+   const int32_t *x, size_t n, std::vector<unsigned char> &out)
+{
+   out.push_back(VerbatimFrame);
+   for (size_t ii = 0; ii < n; ++ii)
+      PutU32(out, static_cast<uint32_t>(x[ii]));
+}
+
+void EncodeFrame(const int32_t *x, size_t n, std::vector<unsigned char> &out)
+{
+   // Choose the order with the smallest sum of magnitudes of residuals,
+   // comparing all orders over the same samples
+   const auto maxOrder = static_cast<unsigned>(std::min<size_t>(MaxOrder, n));
+   uint64_t sums[MaxOrder + 1]{};
+   for (size_t ii = maxOrder; ii < n; ++ii)
+      for (unsigned order = 0; order <= maxOrder; ++order)
+         sums[order] += std::abs(Residual(order, x + ii));
+   unsigned order = 0;
+   for (unsigned oo = 1; oo <= maxOrder; ++oo)
+      if (sums[oo] < sums[order])
+         order = oo;
+
+   // Residuals must fit 32 bits, and the frame must be smaller than verbatim
+   uint64_t bits = 8 + 32 * order;
+   for (size_t begin = 0; begin < n; begin += PartitionSize)
+   {
+      const auto first = std::max<size_t>(begin, order);
+      const auto last = std::min(begin + PartitionSize, n);
+      if (first >= last)
+         continue;
+      uint64_t sum = 0;
+      for (auto ii = first; ii < last; ++ii)
+      {
+         const auto residual = Residual(order, x + ii);
+         if (residual < INT32_MIN || residual > INT32_MAX)
+            return EncodeVerbatim(x, n, out);
+         sum += ZigZag(residual);
+      }
+      bits += RiceParameterBits + RiceBits(sum, last - first);
+   }
+   if (bits >= 8 + 32 * n)
+      return EncodeVerbatim(x, n, out);
+
+   out.push_back(static_cast<unsigned char>(order));
+   for (unsigned ii = 0; ii < order; ++ii)
+      PutU32(out, static_cast<uint32_t>(x[ii]));
+
+   BitWriter writer{ out };
+   for (size_t begin = 0; begin < n; begin += PartitionSize)
+   {
+      const auto first = std::max<size_t>(begin, order);
+      const auto last = std::min(begin + PartitionSize, n);
+      if (first >= last)
+         continue;
+      uint64_t sum = 0;
+      for (auto ii = first; ii < last; ++ii)
+         sum += ZigZag(Residual(order, x + ii));
+      const auto k = RiceParameter(sum, last - first);
+      writer.Write(k, RiceParameterBits);
+      for (auto ii = first; ii < last; ++ii)
+         writer.WriteRice(ZigZag(Residual(order, x + ii)), k);
+   }
+   writer.Flush();
+}
+
+template<unsigned Order>
+void DecodeResiduals(BitReader &reader, int32_t *x, size_t first, size_t last)
+{
+   const auto k = reader.Read(RiceParameterBits);
+   for (auto ii = first; ii < last; ++ii)
+      x[ii] = static_cast<int32_t>(
+         UnZigZag(reader.ReadRice(k)) + Predict<Order>(x + ii));
+}
+
+bool DecodeFrame(const unsigned char *p, const unsigned char *end,
+   size_t n, int32_t *x)
+{
+   if (p == end)
+      return false;
+   const unsigned order = *p++;
+   if (order == VerbatimFrame)
+   {
+      if (static_cast<size_t>(end - p) < 4 * n)
+         return false;
+      for (size_t ii = 0; ii < n; ++ii, p += 4)
+         x[ii] = static_cast<int32_t>(GetU32(p));
+      return true;
+   }
+   if (order > MaxOrder || order > n ||
+       static_cast<size_t>(end - p) < 4 * order)
+      return false;
+   for (unsigned ii = 0; ii < order; ++ii, p += 4)
+      x[ii] = static_cast<int32_t>(GetU32(p));
+
+   BitReader reader{ p, end };
+   for (size_t begin = 0; begin < n; begin += PartitionSize)
+   {
+      const auto first = std::max<size_t>(begin, order);
+      const auto last = std::min(begin + PartitionSize, n);
+      if (first >= last)
+         continue;
+      switch (order) {
+      case 0: DecodeResiduals<0>(reader, x, first, last); break;
+      case 1: DecodeResiduals<1>(reader, x, first, last); break;
+      case 2: DecodeResiduals<2>(reader, x, first, last); break;
+      case 3: DecodeResiduals<3>(reader, x, first, last); break;
+      default: DecodeResiduals<4>(reader, x, first, last); break;
+      }
+   }
+   return !reader.Overrun();
+}
+
+//! Whether all samples are integers when multiplied by 2^bits, not counting
+//! -0, which would decode as 0
+bool ScaleFloats(const float *src, size_t count, int bits, int32_t *dest)
+{
+   const auto scale = std::ldexp(1.0f, bits);
+   for (size_t ii = 0; ii < count; ++ii)
+   {
+      const auto scaled = src[ii] * scale;
+      if (!(scaled >= -scale && scaled < scale))
+         return false;
+      const auto value = static_cast<int32_t>(scaled);
+      if (static_cast<float>(value) != scaled ||
+          (value == 0 && std::signbit(scaled)))
+         return false;
+      dest[ii] = value;
+   }
+   return true;
+}
+}
+
+std::vector<unsigned char> Encode(
+   constSamplePtr src, sampleFormat format, size_t count)
+{
+   if (count == 0 || count > UINT32_MAX)
+      return {};
+
+   std::vector<int32_t> values(count);
+   Domain domain = Integer;
+   switch (format) {
+   case int16Sample:
+      std::copy_n(reinterpret_cast<const short*>(src), count, values.data());
+      break;
+   case int24Sample:
+      std::copy_n(reinterpret_cast<const int*>(src), count, values.data());
+      break;
+   case floatSample: {
+      const auto floats = reinterpret_cast<const float*>(src);
+      if (ScaleFloats(floats, count, Float16, values.data()))
+         domain = Float16;
+      else if (ScaleFloats(floats, count, Float24, values.data()))
+         domain = Float24;
+      else
+         return {};
+      break;
+   }
+   default:
+      return {};
+   }
+
+   const auto rawSize = count * SAMPLE_SIZE(format);
+   const auto nFrames = (count + FrameSize - 1) / FrameSize;
+   std::vector<unsigned char> result;
+   result.reserve(rawSize);
+   PutU32(result, static_cast<uint32_t>(count));
+   result.push_back(domain);
+   result.resize(HeaderSize + 4 * nFrames);
+
+   for (size_t frame = 0; frame < nFrames; ++frame)
+   {
+      SetU32(result.data() + HeaderSize + 4 * frame,
+         static_cast<uint32_t>(result.size()));
+      const auto begin = frame * FrameSize;
+      EncodeFrame(values.data() + begin,
+         std::min(FrameSize, count - begin), result);
+      if (result.size() >= rawSize)
+         return {};
+   }
+
+   return result;
+}
+
+bool Decode(const void *data, size_t size, sampleFormat format,
+   size_t offset, size_t count, samplePtr dest)
+{
+   if (count == 0)
+      return true;
+
+   const auto bytes = static_cast<const unsigned char*>(data);
+   if (size < HeaderSize)
+      return false;
+   const size_t total = GetU32(bytes);
+   const auto domain = bytes[4];
+   if (offset > total || count > total - offset)
+      return false;
+   const auto nFrames = (total + FrameSize - 1) / FrameSize;
+   const auto framesBegin = HeaderSize + 4 * nFrames;
+   if (size < framesBegin)
+      return false;
+
+   const auto isFloat = (format == floatSample);
+   if (isFloat ? (domain != Float16 && domain != Float24)
+       : (domain != Integer ||
+          (format != int16Sample && format != int24Sample)))
+      return false;
+   const auto scale = isFloat ? std::ldexp(1.0f, -domain) : 0.0f;
+
+   int32_t values[FrameSize];
+   size_t done = 0;
+   for (auto frame = offset / FrameSize; done < count; ++frame)
+   {
+      const size_t begin = GetU32(bytes + HeaderSize + 4 * frame);
+      const size_t end = frame + 1 < nFrames
+         ? GetU32(bytes + HeaderSize + 4 * (frame + 1))
+         : size;
+      if (begin < framesBegin || begin > end || end > size)
+         return false;
+
+      const auto frameStart = frame * FrameSize;
+      const auto n = std::min(FrameSize, total - frameStart);
+      if (!DecodeFrame(bytes + begin, bytes + end, n, values))
+         return false;
+
+      const auto from = std::max(offset, frameStart) - frameStart;
+      const auto length = std::min(n - from, count - done);
+      const auto src = values + from;
+      switch (format) {
+      case int16Sample:
+         std::copy_n(src, length,
+            reinterpret_cast<short*>(dest) + done);
+         break;
+      case int24Sample:
+         std::copy_n(src, length, reinterpret_cast<int*>(dest) + done);
+         break;
+      default: {
+         const auto floats = reinterpret_cast<float*>(dest) + done;
+         for (size_t ii = 0; ii < length; ++ii)
+            floats[ii] = src[ii] * scale;
+         break;
+      }
+      }
+      done += length;
+   }
+
+   return true;
+}
+
+}
@@ -0,0 +1,56 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SampleCodec.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_CODEC__
+#define __AUDACITY_SAMPLE_CODEC__
+
+#include "SampleFormat.h"
+
+#include <vector>
+
+//! Lossless compression of blocks of samples, in the style of FLAC
+/*!
+ Samples are split into frames of 4096, each decoded independently, so that
+ a part of a block can be read without decoding all of it.  Each frame chooses
+ the polynomial predictor of order 0 to 4 with the smallest residuals, and
+ the residuals are Rice coded, in partitions of 256 with a parameter for each.
+
+ Integer samples are coded as they are.  Float samples are coded only if all
+ of them are 16 or 24 bit integers scaled to [-1, 1), as they are when
+ imported from such files and not yet processed; then decoding gives back the
+ same bits.
+ */
+namespace SampleCodec {
+
+//! How a block of samples is stored
+/*! These values persist in saved project files, so must not be changed in later program versions */
+enum class Encoding : int {
+   Raw = 0,
+   FixedRice = 1,
+};
+
+//! Compress `count` samples of `format`
+/*!
+ @return the encoded block, or empty if the samples can't be encoded or the
+ result would not be smaller
+ */
+MATH_API std::vector<unsigned char> Encode(
+   constSamplePtr src, sampleFormat format, size_t count);
+
+//! Decode samples `[offset, offset + count)` of an encoded block
+/*!
+ @param format the format given to Encode(), which is also that of `dest`
+ @return false if the data are not a valid encoding of enough samples of
+ `format`; then the contents of `dest` are unspecified
+ */
+MATH_API bool Decode(const void *data, size_t size, sampleFormat format,
+   size_t offset, size_t count, samplePtr dest);
+
+}
+
+#endif
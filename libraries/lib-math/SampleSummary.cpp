@@ -0,0 +1,386 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SampleSummary.cpp
+
+**********************************************************************/
+
+#include "SampleSummary.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SAMPLE_SUMMARY_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(__arm64__) || defined(_M_ARM64)
+#define SAMPLE_SUMMARY_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(SAMPLE_SUMMARY_X86) && !defined(_MSC_VER)
+#define SAMPLE_SUMMARY_TARGET_AVX __attribute__((target("avx")))
+#else
+#define SAMPLE_SUMMARY_TARGET_AVX
+#endif
+
+namespace SampleSummary {
+namespace {
+
+// Compare-and-select in the same way as the scalar code, so that NaNs are
+// skipped and the first of equal values (like -0 and +0) is kept in every
+// implementation
+
+void ScalarWindow(const float *samples, size_t count, float *dest)
+{
+   float min = samples[0];
+   float max = samples[0];
+   float sumsq = min * min;
+   for (size_t j = 1; j < count; ++j) {
+      const float f1 = samples[j];
+      sumsq += f1 * f1;
+      if (f1 < min)
+         min = f1;
+      else if (f1 > max)
+         max = f1;
+   }
+   dest[0] = min;
+   dest[1] = max;
+   dest[2] = sumsq;
+}
+
+//! Summarize as many windows as the kernel handles at once; returns how many
+using Kernel = size_t (*)(
+   const float *samples, size_t windowSize, size_t nWindows, float *dest);
+
+size_t ScalarKernel(
+   const float *samples, size_t windowSize, size_t nWindows, float *dest)
+{
+   for (size_t ii = 0; ii < nWindows; ++ii)
+      ScalarWindow(samples + ii * windowSize, windowSize, dest + 3 * ii);
+   return nWindows;
+}
+
+#if defined(SAMPLE_SUMMARY_X86)
+
+//! Four windows at a time
+size_t SSE2Kernel(
+   const float *samples, size_t windowSize, size_t nWindows, float *dest)
+{
+   constexpr size_t Lanes = 4;
+   if (windowSize % Lanes != 0)
+      return ScalarKernel(samples, windowSize, nWindows, dest);
+
+   size_t ii = 0;
+   for (; ii + Lanes <= nWindows; ii += Lanes) {
+      const float *p0 = samples + ii * windowSize;
+      const float *p1 = p0 + windowSize;
+      const float *p2 = p1 + windowSize;
+      const float *p3 = p2 + windowSize;
+      // Set from the first row of samples, below
+      __m128 min = _mm_setzero_ps(), max = min, sumsq = min;
+      const auto step = [&](__m128 x) {
+         // No fused multiply-add, like the scalar code
+         sumsq = _mm_add_ps(sumsq, _mm_mul_ps(x, x));
+         // These return the second operand unless the first compares less
+         // (greater), as the scalar comparisons do
+         min = _mm_min_ps(x, min);
+         max = _mm_max_ps(x, max);
+      };
+      for (size_t j = 0; j < windowSize; j += Lanes) {
+         // Transpose, so that each vector holds one position of four windows
+         __m128 r0 = _mm_loadu_ps(p0 + j);
+         __m128 r1 = _mm_loadu_ps(p1 + j);
+         __m128 r2 = _mm_loadu_ps(p2 + j);
+         __m128 r3 = _mm_loadu_ps(p3 + j);
+         _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+         if (j == 0) {
+            min = max = r0;
+            sumsq = _mm_mul_ps(r0, r0);
+         }
+         else
+            step(r0);
+         step(r1);
+         step(r2);
+         step(r3);
+      }
+      alignas(16) float mins[Lanes], maxs[Lanes], sums[Lanes];
+      _mm_store_ps(mins, min);
+      _mm_store_ps(maxs, max);
+      _mm_store_ps(sums, sumsq);
+      for (size_t k = 0; k < Lanes; ++k) {
+         auto d = dest + 3 * (ii + k);
+         d[0] = mins[k];
+         d[1] = maxs[k];
+         d[2] = sums[k];
+      }
+   }
+   return ii + ScalarKernel(samples + ii * windowSize, windowSize,
+      nWindows - ii, dest + 3 * ii);
+}
+
+//! Eight windows at a time
+SAMPLE_SUMMARY_TARGET_AVX
+size_t AVXKernel(
+   const float *samples, size_t windowSize, size_t nWindows, float *dest)
+{
+   constexpr size_t Lanes = 8;
+   if (windowSize % Lanes != 0)
+      return SSE2Kernel(samples, windowSize, nWindows, dest);
+
+   size_t ii = 0;
+   for (; ii + Lanes <= nWindows; ii += Lanes) {
+      const float *p = samples + ii * windowSize;
+      // Set from the first row of samples, below
+      __m256 min = _mm256_setzero_ps(), max = min, sumsq = min;
+      for (size_t j = 0; j < windowSize; j += Lanes) {
+         __m256 r[Lanes];
+         for (size_t k = 0; k < Lanes; ++k)
+            r[k] = _mm256_loadu_ps(p + k * windowSize + j);
+
+         // Transpose 8 x 8
+         const auto t0 = _mm256_unpacklo_ps(r[0], r[1]);
+         const auto t1 = _mm256_unpackhi_ps(r[0], r[1]);
+         const auto t2 = _mm256_unpacklo_ps(r[2], r[3]);
+         const auto t3 = _mm256_unpackhi_ps(r[2], r[3]);
+         const auto t4 = _mm256_unpacklo_ps(r[4], r[5]);
+         const auto t5 = _mm256_unpackhi_ps(r[4], r[5]);
+         const auto t6 = _mm256_unpacklo_ps(r[6], r[7]);
+         const auto t7 = _mm256_unpackhi_ps(r[6], r[7]);
+         const auto u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+         const auto u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+         const auto u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+         const auto u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+         r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+         r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+         r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+         r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+         r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+         r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+         r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+         r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+
+         size_t k = 0;
+         if (j == 0) {
+            min = max = r[0];
+            sumsq = _mm256_mul_ps(r[0], r[0]);
+            k = 1;
+         }
+         // Not a lambda as in SSE2Kernel, which would lack the target
+         // attribute
+         for (; k < Lanes; ++k) {
+            sumsq = _mm256_add_ps(sumsq, _mm256_mul_ps(r[k], r[k]));
+            min = _mm256_min_ps(r[k], min);
+            max = _mm256_max_ps(r[k], max);
+         }
+      }
+      alignas(32) float mins[Lanes], maxs[Lanes], sums[Lanes];
+      _mm256_store_ps(mins, min);
+      _mm256_store_ps(maxs, max);
+      _mm256_store_ps(sums, sumsq);
+      for (size_t k = 0; k < Lanes; ++k) {
+         auto d = dest + 3 * (ii + k);
+         d[0] = mins[k];
+         d[1] = maxs[k];
+         d[2] = sums[k];
+      }
+   }
+   return ii + SSE2Kernel(samples + ii * windowSize, windowSize,
+      nWindows - ii, dest + 3 * ii);
+}
+
+bool HasAVX()
+{
+#if defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 1);
+   const bool osxsave = (info[2] & (1 << 27)) != 0;
+   const bool avx = (info[2] & (1 << 28)) != 0;
+   // The operating system must also save the upper halves of the registers
+   return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+   return __builtin_cpu_supports("avx");
+#endif
+}
+
+#elif defined(SAMPLE_SUMMARY_NEON)
+
+//! Four windows at a time
+size_t NEONKernel(
+   const float *samples, size_t windowSize, size_t nWindows, float *dest)
+{
+   constexpr size_t Lanes = 4;
+   if (windowSize % Lanes != 0)
+      return ScalarKernel(samples, windowSize, nWindows, dest);
+
+   size_t ii = 0;
+   for (; ii + Lanes <= nWindows; ii += Lanes) {
+      const float *p0 = samples + ii * windowSize;
+      const float *p1 = p0 + windowSize;
+      const float *p2 = p1 + windowSize;
+      const float *p3 = p2 + windowSize;
+      // Set from the first row of samples, below
+      float32x4_t min = vdupq_n_f32(0), max = min, sumsq = min;
+      const auto step = [&](float32x4_t x) {
+         sumsq = vaddq_f32(sumsq, vmulq_f32(x, x));
+         // Not vminq_f32 and vmaxq_f32, which differ from the scalar
+         // comparisons for NaN and for zeroes of opposite signs
+         min = vbslq_f32(vcltq_f32(x, min), x, min);
+         max = vbslq_f32(vcgtq_f32(x, max), x, max);
+      };
+      for (size_t j = 0; j < windowSize; j += Lanes) {
+         const auto a = vtrnq_f32(vld1q_f32(p0 + j), vld1q_f32(p1 + j));
+         const auto b = vtrnq_f32(vld1q_f32(p2 + j), vld1q_f32(p3 + j));
+         const auto r0 =
+            vcombine_f32(vget_low_f32(a.val[0]), vget_low_f32(b.val[0]));
+         const auto r1 =
+            vcombine_f32(vget_low_f32(a.val[1]), vget_low_f32(b.val[1]));
+         const auto r2 =
+            vcombine_f32(vget_high_f32(a.val[0]), vget_high_f32(b.val[0]));
+         const auto r3 =
+            vcombine_f32(vget_high_f32(a.val[1]), vget_high_f32(b.val[1]));
+         if (j == 0) {
+            min = max = r0;
+            sumsq = vmulq_f32(r0, r0);
+         }
+         else
+            step(r0);
+         step(r1);
+         step(r2);
+         step(r3);
+      }
+      float mins[Lanes], maxs[Lanes], sums[Lanes];
+      vst1q_f32(mins, min);
+      vst1q_f32(maxs, max);
+      vst1q_f32(sums, sumsq);
+      for (size_t k = 0; k < Lanes; ++k) {
+         auto d = dest + 3 * (ii + k);
+         d[0] = mins[k];
+         d[1] = maxs[k];
+         d[2] = sums[k];
+      }
+   }
+   return ii + ScalarKernel(samples + ii * windowSize, windowSize,
+      nWindows - ii, dest + 3 * ii);
+}
+
+#endif
+
+struct Choice {
+   Kernel kernel;
+   const char *name;
+};
+
+Choice Detect()
+{
+#if defined(SAMPLE_SUMMARY_X86)
+   if (HasAVX())
+      return { AVXKernel, "AVX" };
+   return { SSE2Kernel, "SSE2" };
+#elif defined(SAMPLE_SUMMARY_NEON)
+   return { NEONKernel, "NEON" };
+#else
+   return { ScalarKernel, "scalar" };
+#endif
+}
+
+const Choice &Detected()
+{
+   static const Choice choice = Detect();
+   return choice;
+}
+
+std::atomic<bool> sForceScalar{ false };
+
+Choice Chosen()
+{
+   if (sForceScalar.load(std::memory_order_relaxed))
+      return { ScalarKernel, "scalar" };
+   return Detected();
+}
+}
+
+void SummarizeWindows(
+   const float *samples, size_t windowSize, size_t nWindows, float *dest)
+{
+   Chosen().kernel(samples, windowSize, nWindows, dest);
+}
+
+Result Summarize(const float *samples, size_t count)
+{
+   constexpr size_t WindowSize = 256;
+   // Windows summarized per call of the kernel
+   constexpr size_t Batch = 64;
+
+   const auto kernel = Chosen().kernel;
+   Result result{ FLT_MAX, -FLT_MAX, 0.0 };
+
+   // The squares are added in one single precision sum, in order, as
+   // callers always did; only the extremes are found window by window
+   float sumsq = 0;
+   for (size_t ii = 0; ii < count; ++ii)
+      sumsq += samples[ii] * samples[ii];
+   result.sumsq = sumsq;
+
+   const auto combine = [&](const float *window, size_t windowSize,
+      const float *summary
+   ){
+      if (std::isnan(summary[0])) {
+         // The window began with NaN, which hides the extremes that follow
+         for (size_t j = 1; j < windowSize; ++j) {
+            if (window[j] < result.min)
+               result.min = window[j];
+            if (window[j] > result.max)
+               result.max = window[j];
+         }
+      }
+      else {
+         if (summary[0] < result.min)
+            result.min = summary[0];
+         if (summary[1] > result.max)
+            result.max = summary[1];
+      }
+   };
+
+   float summaries[3 * Batch];
+   while (count >= WindowSize) {
+      const auto nWindows = std::min(Batch, count / WindowSize);
+      kernel(samples, WindowSize, nWindows, summaries);
+      for (size_t ii = 0; ii < nWindows; ++ii)
+         combine(samples + ii * WindowSize, WindowSize, summaries + 3 * ii);
+      samples += nWindows * WindowSize;
+      count -= nWindows * WindowSize;
+   }
+   if (count > 0) {
+      ScalarWindow(samples, count, summaries);
+      combine(samples, count, summaries);
+   }
+   return result;
+}
+
+const char *GetInstructionSet()
+{
+   return Chosen().name;
+}
+
+void ForceScalar(bool force)
+{
+   sForceScalar.store(force, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,73 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SampleSummary.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_SUMMARY__
+#define __AUDACITY_SAMPLE_SUMMARY__
+
+#include <cstddef>
+
+//! Vectorized computation of the extremes and energy of runs of samples
+/*!
+ The work is split into windows, and several windows are summarized at once,
+ one per vector lane.  Each lane scans its window in order exactly as the
+ scalar loop does, so that results are the same, to the bit, whichever
+ instruction set is chosen at run time.
+ */
+namespace SampleSummary {
+
+//! Extremes and sum of squares of a run of samples
+struct Result {
+   float min;
+   float max;
+   double sumsq;
+};
+
+//! Summarize `nWindows` consecutive windows of `windowSize` samples each
+/*!
+ Each window is summarized as by
+ @code
+ min = max = x[0]; sumsq = x[0] * x[0];
+ for (j = 1; j < windowSize; ++j) {
+    sumsq += x[j] * x[j];
+    if (x[j] < min) min = x[j]; else if (x[j] > max) max = x[j];
+ }
+ @endcode
+ computed in single precision.
+ @pre `windowSize > 0`
+ @param dest receives three floats per window: min, max, sum of squares
+ */
+MATH_API void SummarizeWindows(
+   const float *samples, size_t windowSize, size_t nWindows, float *dest);
+
+//! Summarize `count` samples of any length
+/*!
+ Results are the same, to the bit, as those of
+ @code
+ min = FLT_MAX; max = -FLT_MAX; float sumsq = 0;
+ for (j = 0; j < count; ++j) {
+    if (x[j] > max) max = x[j];
+    if (x[j] < min) min = x[j];
+    sumsq += x[j] * x[j];
+ }
+ @endcode
+ The extremes are found in windows of 256, which are combined in order, so
+ they keep their initial values if `count` is zero or all samples are NaN.
+ The sum of squares stays a single sum in order, so it is not vectorized.
+ */
+MATH_API Result Summarize(const float *samples, size_t count);
+
+//! Name of the instruction set chosen at run time, for diagnostics
+MATH_API const char *GetInstructionSet();
+
+//! Use scalar code only, or restore the run time choice
+/*! For testing and benchmarking */
+MATH_API void ForceScalar(bool force);
+
+}
+
+#endif
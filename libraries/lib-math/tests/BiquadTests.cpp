@@ -0,0 +1,179 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BiquadTests.cpp
+
+**********************************************************************/
+#include "Biquad.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+std::vector<float> RandomSamples(size_t count, unsigned seed = 0)
+{
+   std::mt19937 engine { seed };
+   std::uniform_real_distribution<float> distribution { -1.f, 1.f };
+   std::vector<float> samples(count);
+   for (auto& sample : samples)
+      sample = distribution(engine);
+   return samples;
+}
+
+ArrayOf<Biquad> MakeFilter(int kind, int order)
+{
+   switch (kind) {
+   case 0:
+      return Biquad::CalcButterworthFilter(
+         order, 22050, 1000, Biquad::kLowPass);
+   case 1:
+      return Biquad::CalcChebyshevType1Filter(
+         order, 22050, 5000, 1, Biquad::kHighPass);
+   default:
+      return Biquad::CalcChebyshevType2Filter(
+         order, 22050, 300, 30, Biquad::kLowPass);
+   }
+}
+
+//! What ScienFilter did before ProcessCascade()
+void ProcessSerially(Biquad* sections, size_t nSections,
+   const float* in, float* out, size_t len)
+{
+   for (size_t i = 0; i < nSections; ++i) {
+      sections[i].Process(in, out, len);
+      in = out;
+   }
+}
+
+bool SameBits(const std::vector<float>& a, const std::vector<float>& b)
+{
+   return a.size() == b.size() &&
+          0 == memcmp(a.data(), b.data(), a.size() * sizeof(float));
+}
+
+bool SameState(const Biquad& a, const Biquad& b)
+{
+   return a.fPrevIn == b.fPrevIn && a.fPrevPrevIn == b.fPrevPrevIn &&
+          a.fPrevOut == b.fPrevOut && a.fPrevPrevOut == b.fPrevPrevOut;
+}
+}
+
+TEST_CASE("ProcessCascade matches Process of each section", "[Biquad]")
+{
+   for (int kind = 0; kind < 3; ++kind)
+   for (int order = Biquad::MIN_Order; order <= Biquad::MAX_Order; ++order)
+   for (size_t len : { 0, 1, 2, 3, 1000 }) {
+      const size_t nSections = (order + 1) / 2;
+      auto expectedFilter = MakeFilter(kind, order);
+      auto actualFilter = MakeFilter(kind, order);
+      const auto input = RandomSamples(len);
+      std::vector<float> expected(len), actual(len);
+
+      // Twice, so that state carries over
+      for (int pass = 0; pass < 2; ++pass) {
+         ProcessSerially(expectedFilter.get(), nSections,
+            input.data(), expected.data(), len);
+         // In place
+         actual = input;
+         Biquad::ProcessCascade(actualFilter.get(), nSections,
+            actual.data(), actual.data(), len);
+         REQUIRE(SameBits(expected, actual));
+         for (size_t i = 0; i < nSections; ++i)
+            REQUIRE(SameState(expectedFilter[i], actualFilter[i]));
+      }
+   }
+}
+
+TEST_CASE("ProcessCascades matches ProcessCascade per channel", "[Biquad]")
+{
+   constexpr size_t len = 777;
+   for (size_t nChannels = 1; nChannels <= 5; ++nChannels)
+   for (int order : { 1, 2, 4, 9, 10 }) {
+      const size_t nSections = (order + 1) / 2;
+      std::vector<ArrayOf<Biquad>> expectedFilters, actualFilters;
+      std::vector<Biquad*> sections;
+      std::vector<std::vector<float>> inputs, expected, actual;
+      std::vector<const float*> in;
+      std::vector<float*> out;
+      for (size_t channel = 0; channel < nChannels; ++channel) {
+         expectedFilters.push_back(MakeFilter(channel % 3, order));
+         actualFilters.push_back(MakeFilter(channel % 3, order));
+         sections.push_back(actualFilters.back().get());
+         inputs.push_back(RandomSamples(len, channel));
+         expected.emplace_back(len);
+         actual.emplace_back(len);
+      }
+      for (size_t channel = 0; channel < nChannels; ++channel) {
+         in.push_back(inputs[channel].data());
+         out.push_back(actual[channel].data());
+      }
+
+      for (int pass = 0; pass < 2; ++pass) {
+         for (size_t channel = 0; channel < nChannels; ++channel)
+            ProcessSerially(expectedFilters[channel].get(), nSections,
+               inputs[channel].data(), expected[channel].data(), len);
+         Biquad::ProcessCascades(sections.data(), nSections, nChannels,
+            in.data(), out.data(), len);
+         for (size_t channel = 0; channel < nChannels; ++channel) {
+            REQUIRE(SameBits(expected[channel], actual[channel]));
+            for (size_t i = 0; i < nSections; ++i)
+               REQUIRE(SameState(
+                  expectedFilters[channel][i], actualFilters[channel][i]));
+         }
+      }
+   }
+}
+
+TEST_CASE("Biquad cascade benchmark", "[!benchmark]")
+{
+   // About six minutes of audio at 44.1 kHz, through a tenth order filter
+   constexpr int order = 10;
+   constexpr size_t nSections = (order + 1) / 2;
+   constexpr size_t blockSize = 512;
+   const auto input = RandomSamples(1 << 24);
+   std::vector<float> output(input.size());
+   const auto time = [&](auto process) {
+      auto filter = MakeFilter(0, order);
+      const auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < input.size(); i += blockSize)
+         process(filter.get(), nSections, &input[i], &output[i], blockSize);
+      return std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start)
+         .count();
+   };
+   const auto serialTime = time(ProcessSerially);
+   const auto cascadeTime = time(Biquad::ProcessCascade);
+   std::cout << "Biquad order " << order << ": serial " << serialTime
+             << " s, cascade " << cascadeTime << " s\n";
+
+   // Two channels of half the length
+   const auto half = input.size() / 2;
+   const auto stereoTime = [&](bool together) {
+      auto filter0 = MakeFilter(0, order), filter1 = MakeFilter(0, order);
+      Biquad* sections[] { filter0.get(), filter1.get() };
+      const auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < half; i += blockSize) {
+         const float* in[] { &input[i], &input[half + i] };
+         float* out[] { &output[i], &output[half + i] };
+         if (together)
+            Biquad::ProcessCascades(sections, nSections, 2, in, out, blockSize);
+         else
+            for (size_t channel = 0; channel < 2; ++channel)
+               ProcessSerially(sections[channel], nSections,
+                  in[channel], out[channel], blockSize);
+      }
+      return std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start)
+         .count();
+   };
+   std::cout << "Biquad order " << order << ", stereo: serial "
+             << stereoTime(false) << " s, cascades " << stereoTime(true)
+             << " s\n";
+}
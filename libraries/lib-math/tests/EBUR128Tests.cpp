@@ -0,0 +1,85 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  EBUR128Tests.cpp
+
+**********************************************************************/
+#include "EBUR128.h"
+
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <vector>
+
+namespace {
+constexpr double rate = 44100;
+
+std::vector<float> Sine(double frequency, double amplitude, double phase,
+   size_t len)
+{
+   std::vector<float> result(len);
+   for (size_t i = 0; i < len; ++i)
+      result[i] = amplitude * sin(2 * M_PI * frequency * i / rate + phase);
+   return result;
+}
+}
+
+TEST_CASE("EBUR128")
+{
+   SECTION("ProcessBlock agrees with ProcessSampleFromChannel")
+   {
+      constexpr size_t len = 3 * rate + 123;
+      std::mt19937 generator{ 42 };
+      std::uniform_real_distribution<float> distribution{ -0.5f, 0.5f };
+      std::vector<float> left(len), right(len);
+      for (size_t i = 0; i < len; ++i) {
+         left[i] = distribution(generator);
+         right[i] = 0.25f * distribution(generator);
+      }
+
+      EBUR128 bySample{ rate, 2 };
+      for (size_t i = 0; i < len; ++i) {
+         bySample.ProcessSampleFromChannel(left[i], 0);
+         bySample.ProcessSampleFromChannel(right[i], 1);
+         bySample.NextSample();
+      }
+
+      // Uneven pieces, crossing the block boundaries at different places
+      EBUR128 byBlock{ rate, 2 };
+      for (size_t done = 0, piece = 1; done < len; piece = piece * 3 + 1) {
+         const auto count = std::min(piece % 5000, len - done);
+         const float *buffers[]{ &left[done], &right[done] };
+         byBlock.ProcessBlock(buffers, count);
+         done += count;
+      }
+
+      REQUIRE(byBlock.IntegrativeLoudness() ==
+         Approx(bySample.IntegrativeLoudness()).epsilon(1e-12));
+   }
+
+   SECTION("Loudness of a sine")
+   {
+      // A 997 Hz sine at 0 dBFS in one channel measures -3.01 LUFS
+      const auto sine = Sine(997, pow(10, -20.0 / 20), 0, 5 * rate);
+      const float *buffers[]{ sine.data() };
+      EBUR128 meter{ rate, 1 };
+      meter.ProcessBlock(buffers, sine.size());
+      const auto loudness = meter.IntegrativeLoudness();
+      REQUIRE(meter.IntegrativeLoudnessToLUFS(loudness) ==
+         Approx(-23.01).margin(0.05));
+      REQUIRE(meter.TruePeak() == 0);
+   }
+
+   SECTION("True peak between samples")
+   {
+      // Samples of this sine fall at +-45 degrees from its peaks
+      const auto sine = Sine(rate / 4, 1.0, M_PI / 4, rate);
+      const float *buffers[]{ sine.data() };
+      EBUR128 meter{ rate, 1, true };
+      meter.ProcessBlock(buffers, sine.size());
+      REQUIRE(*std::max_element(sine.begin(), sine.end()) < 0.71f);
+      REQUIRE(meter.TruePeak() == Approx(1.0).margin(0.05));
+   }
+}
@@ -0,0 +1,144 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ResampleTests.cpp
+
+**********************************************************************/
+#include "Resample.h"
+
+#include "MockedPrefs.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+namespace {
+//! Feed input[inStart, inEnd) to a new constant-rate resampler, as
+//! WaveClip::Resample feeds each segment, and return all the outputs
+std::vector<float> Feed(
+   double factor, const std::vector<float> &input, size_t inStart,
+   size_t inEnd)
+{
+   Resample resample{ true, factor, factor };
+   const size_t bufsize = 65536;
+   std::vector<float> buffer(bufsize), output;
+   auto pos = inStart;
+   size_t outGenerated = 0;
+   while (pos < inEnd || outGenerated > 0) {
+      const auto inLen = std::min(bufsize, inEnd - pos);
+      const bool isLast = pos + inLen == inEnd;
+      const auto results = resample.Process(factor, input.data() + pos, inLen,
+         isLast, buffer.data(), bufsize);
+      outGenerated = results.second;
+      output.insert(output.end(), buffer.begin(), buffer.begin() + outGenerated);
+      pos += results.first;
+   }
+   return output;
+}
+}
+
+TEST_CASE("Resample::MakeSegments", "[Resample]")
+{
+   SECTION("Short input is not cut")
+   {
+      const auto segments = Resample::MakeSegments(44100, 48000, 100000, 8);
+      REQUIRE(segments.size() == 1);
+      REQUIRE(segments[0].inStart == 0);
+      REQUIRE(segments[0].inEnd == 100000);
+      REQUIRE(segments[0].skip == 0);
+      REQUIRE(!segments[0].keep);
+   }
+
+   for (auto [fromRate, toRate] : { std::pair{ 44100, 48000 },
+      { 48000, 44100 }, { 192000, 8000 }, { 8000, 96000 }, { 22050, 44100 } })
+   for (long long len : { 1LL << 24, (1LL << 26) + 12345 })
+   for (size_t nSegments : { 1, 2, 7 }) {
+      const auto segments =
+         Resample::MakeSegments(fromRate, toRate, len, nSegments);
+      REQUIRE(segments.size() >= 1);
+      REQUIRE(segments.size() <= nSegments);
+      REQUIRE(segments.back().inEnd == len);
+      REQUIRE(!segments.back().keep);
+
+      // Kept outputs abut, and begin where outputs fall on input samples
+      long long nextOutput = 0;
+      for (const auto &segment : segments) {
+         REQUIRE(segment.inStart >= 0);
+         REQUIRE(segment.inStart < segment.inEnd);
+         REQUIRE(segment.inEnd <= len);
+         const auto first = segment.inStart.as_long_long() * toRate;
+         REQUIRE(first % fromRate == 0);
+         REQUIRE(first / fromRate + segment.skip.as_long_long() ==
+            nextOutput);
+         if (segment.keep) {
+            REQUIRE(*segment.keep > 0);
+            nextOutput += segment.keep->as_long_long();
+         }
+      }
+   }
+}
+
+TEST_CASE("Resample segments join as one pass", "[Resample]")
+{
+   MockedPrefs prefs;
+
+   // Raising and reducing rates; reduction lengthens the margins, so those
+   // inputs are longer, to be cut in three all the same
+   for (auto [fromRate, toRate, len] : {
+      std::tuple{ 44100, 48000, size_t{ (1 << 21) + 12345 } },
+      { 48000, 44100, size_t{ (1 << 21) + 12345 } },
+      { 22050, 44100, size_t{ (1 << 21) + 12345 } },
+      { 48000, 16000, size_t{ (1 << 23) + 12345 } },
+      { 96000, 22050, size_t{ (1 << 23) + 12345 } } })
+   {
+      // A chirp, rising to near the Nyquist frequency
+      std::vector<float> input(len);
+      const auto rate = 0.95 * M_PI / (2 * double(len));
+      for (size_t ii = 0; ii < len; ++ii)
+         input[ii] = 0.5f * std::sin(rate * double(ii) * ii);
+
+      const auto factor = double(toRate) / fromRate;
+      const auto segments = Resample::MakeSegments(fromRate, toRate, len, 3);
+      REQUIRE(segments.size() == 3);
+
+      const auto whole = Feed(factor, input, 0, len);
+      std::vector<float> joined;
+      // Where each segment's kept output begins in the joined output
+      std::vector<size_t> joins;
+      for (const auto &segment : segments) {
+         const auto output = Feed(factor, input,
+            segment.inStart.as_size_t(), segment.inEnd.as_size_t());
+         const auto first =
+            std::min(output.size(), segment.skip.as_size_t());
+         const auto count = segment.keep
+            ? std::min(output.size() - first, segment.keep->as_size_t())
+            : output.size() - first;
+         if (!joined.empty())
+            joins.push_back(joined.size());
+         joined.insert(joined.end(),
+            output.begin() + first, output.begin() + first + count);
+      }
+      REQUIRE(joined.size() == whole.size());
+
+      // Differences would be greatest next to the joins, where one
+      // segment's warm-up and the other's tail are
+      constexpr size_t neighbourhood = 4096;
+      float atJoins = 0;
+      for (const auto join : joins)
+         for (auto ii = join - std::min(join, neighbourhood);
+              ii < std::min(whole.size(), join + neighbourhood); ++ii)
+            atJoins = std::max(atJoins, std::abs(joined[ii] - whole[ii]));
+      float difference = 0;
+      for (size_t ii = 0; ii < whole.size(); ++ii)
+         difference = std::max(difference, std::abs(joined[ii] - whole[ii]));
+      INFO(fromRate << " to " << toRate << ": " << atJoins << " at joins, "
+         << difference << " anywhere");
+      REQUIRE(atJoins < 1e-4f);
+      REQUIRE(difference < 1e-4f);
+   }
+}
@@ -0,0 +1,190 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleCodecTests.cpp
+
+**********************************************************************/
+#include "SampleCodec.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+//! A noisy sine, like recorded audio, quantized to `bits`
+std::vector<int> Signal(size_t count, int bits)
+{
+   std::mt19937 engine { 0 };
+   std::normal_distribution<double> noise { 0, 0.01 };
+   const auto scale = std::ldexp(1.0, bits - 1) - 1;
+   std::vector<int> samples(count);
+   for (size_t ii = 0; ii < count; ++ii)
+      samples[ii] = static_cast<int>(std::lround(scale * std::clamp(
+         0.5 * std::sin(ii * 0.01) + noise(engine), -1.0, 1.0)));
+   return samples;
+}
+
+template<typename T>
+std::vector<T> RoundTrip(const std::vector<T>& samples, sampleFormat format,
+   size_t offset, size_t count)
+{
+   const auto encoded = SampleCodec::Encode(
+      reinterpret_cast<constSamplePtr>(samples.data()), format,
+      samples.size());
+   REQUIRE(!encoded.empty());
+   REQUIRE(encoded.size() < samples.size() * sizeof(T));
+   std::vector<T> decoded(count);
+   REQUIRE(SampleCodec::Decode(encoded.data(), encoded.size(), format,
+      offset, count, reinterpret_cast<samplePtr>(decoded.data())));
+   return decoded;
+}
+
+template<typename T>
+void CheckRoundTrip(const std::vector<T>& samples, sampleFormat format)
+{
+   const auto size = samples.size();
+   for (auto [offset, count] : {
+           std::pair<size_t, size_t> { 0, size }, { 1, size - 1 },
+           { 4095, 2 }, { 5000, 100 }, { size - 1, 1 } })
+   {
+      const auto decoded = RoundTrip(samples, format, offset, count);
+      REQUIRE(std::memcmp(decoded.data(), samples.data() + offset,
+                 count * sizeof(T)) == 0);
+   }
+}
+} // namespace
+
+TEST_CASE("SampleCodec")
+{
+   const size_t size = 10000;
+
+   SECTION("round trips 16 bit samples")
+   {
+      const auto signal = Signal(size, 16);
+      CheckRoundTrip(std::vector<short>(signal.begin(), signal.end()),
+         int16Sample);
+   }
+
+   SECTION("round trips 24 bit samples")
+   {
+      CheckRoundTrip(Signal(size, 24), int24Sample);
+   }
+
+   SECTION("round trips floats from 16 and 24 bit samples")
+   {
+      for (auto bits : { 16, 24 })
+      {
+         const auto signal = Signal(size, bits);
+         std::vector<float> samples(size);
+         for (size_t ii = 0; ii < size; ++ii)
+            samples[ii] = std::ldexp(float(signal[ii]), 1 - bits);
+         CheckRoundTrip(samples, floatSample);
+      }
+   }
+
+   SECTION("round trips extreme and short inputs")
+   {
+      CheckRoundTrip(std::vector<short>(size, -32768), int16Sample);
+      std::vector<int> alternating(size);
+      for (size_t ii = 0; ii < size; ++ii)
+         alternating[ii] = (ii % 2) ? 8388607 : -8388608;
+      const auto encoded = SampleCodec::Encode(
+         reinterpret_cast<constSamplePtr>(alternating.data()), int24Sample,
+         size);
+      if (!encoded.empty())
+      {
+         std::vector<int> decoded(size);
+         REQUIRE(SampleCodec::Decode(encoded.data(), encoded.size(),
+            int24Sample, 0, size, reinterpret_cast<samplePtr>(decoded.data())));
+         REQUIRE(decoded == alternating);
+      }
+      for (size_t count = 1; count < 10; ++count)
+      {
+         const std::vector<short> samples(count, 7);
+         const auto encoded = SampleCodec::Encode(
+            reinterpret_cast<constSamplePtr>(samples.data()), int16Sample,
+            count);
+         REQUIRE(encoded.size() < count * sizeof(short));
+      }
+   }
+
+   SECTION("refuses floats that are not scaled integers")
+   {
+      std::mt19937 engine { 0 };
+      std::uniform_real_distribution<float> distribution { -1.f, 1.f };
+      std::vector<float> samples(size);
+      for (auto& sample : samples)
+         sample = distribution(engine);
+      REQUIRE(SampleCodec::Encode(reinterpret_cast<constSamplePtr>(
+         samples.data()), floatSample, size).empty());
+
+      std::vector<float> zeros(size, 0.0f);
+      zeros[17] = -0.0f;
+      REQUIRE(SampleCodec::Encode(reinterpret_cast<constSamplePtr>(
+         zeros.data()), floatSample, size).empty());
+   }
+
+   SECTION("rejects bad data")
+   {
+      const auto signal = Signal(size, 24);
+      const auto encoded = SampleCodec::Encode(
+         reinterpret_cast<constSamplePtr>(signal.data()), int24Sample, size);
+      REQUIRE(!encoded.empty());
+      std::vector<int> decoded(size);
+      const auto dest = reinterpret_cast<samplePtr>(decoded.data());
+
+      // Wrong format, too many samples, truncated
+      REQUIRE(!SampleCodec::Decode(
+         encoded.data(), encoded.size(), floatSample, 0, size, dest));
+      REQUIRE(!SampleCodec::Decode(
+         encoded.data(), encoded.size(), int24Sample, 1, size, dest));
+      REQUIRE(!SampleCodec::Decode(
+         encoded.data(), encoded.size() / 2, int24Sample, 0, size, dest));
+
+      // Random damage must not crash
+      std::mt19937 engine { 0 };
+      for (auto ii = 0; ii < 1000; ++ii)
+      {
+         auto damaged = encoded;
+         damaged[engine() % damaged.size()] ^= 1 << (engine() % 8);
+         SampleCodec::Decode(
+            damaged.data(), damaged.size(), int24Sample, 0, size, dest);
+      }
+   }
+}
+
+TEST_CASE("SampleCodec benchmark", "[!benchmark]")
+{
+   // About six minutes of mono audio at 44.1 kHz
+   const size_t size = 1 << 24;
+   const auto signal = Signal(size, 24);
+   std::vector<float> samples(size);
+   for (size_t ii = 0; ii < size; ++ii)
+      samples[ii] = std::ldexp(float(signal[ii]), -23);
+
+   auto start = std::chrono::steady_clock::now();
+   const auto encoded = SampleCodec::Encode(
+      reinterpret_cast<constSamplePtr>(samples.data()), floatSample, size);
+   const auto encodeTime = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+   REQUIRE(!encoded.empty());
+
+   start = std::chrono::steady_clock::now();
+   REQUIRE(SampleCodec::Decode(encoded.data(), encoded.size(), floatSample,
+      0, size, reinterpret_cast<samplePtr>(samples.data())));
+   const auto decodeTime = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+   std::cout << "SampleCodec: ratio "
+             << double(encoded.size()) / (size * sizeof(float))
+             << ", encode " << size / encodeTime / 1e6 << " Msamples/s"
+             << ", decode " << size / decodeTime / 1e6 << " Msamples/s\n";
+}
@@ -0,0 +1,148 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleSummaryTests.cpp
+
+**********************************************************************/
+#include "SampleSummary.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+std::vector<float> RandomSamples(size_t count)
+{
+   std::mt19937 engine { 0 };
+   std::uniform_real_distribution<float> distribution { -1.f, 1.f };
+   std::vector<float> samples(count);
+   for (auto& sample : samples)
+      sample = distribution(engine);
+   return samples;
+}
+
+std::vector<float> Summarize(
+   const std::vector<float>& samples, size_t windowSize, bool scalar)
+{
+   const auto nWindows = samples.size() / windowSize;
+   std::vector<float> summaries(3 * nWindows);
+   SampleSummary::ForceScalar(scalar);
+   SampleSummary::SummarizeWindows(
+      samples.data(), windowSize, nWindows, summaries.data());
+   SampleSummary::ForceScalar(false);
+   return summaries;
+}
+
+bool BitEqual(const std::vector<float>& a, const std::vector<float>& b)
+{
+   return a.size() == b.size() &&
+          (a.empty() ||
+           std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+}
+} // namespace
+
+TEST_CASE("SampleSummary::SummarizeWindows")
+{
+   SECTION("matches the scalar code to the bit")
+   {
+      for (const size_t windowSize : { 256, 12, 7, 1 })
+         for (const size_t nWindows : { 0, 1, 3, 4, 5, 8, 9, 17, 100 })
+         {
+            auto samples = RandomSamples(windowSize * nWindows);
+            if (samples.size() > 2 * windowSize)
+            {
+               // Ties of zeroes of opposite sign, and NaNs, first in a
+               // window and not
+               samples[1] = -0.f;
+               samples[2] = 0.f;
+               samples[3] = std::nanf("");
+               samples[windowSize] = std::nanf("");
+            }
+            REQUIRE(BitEqual(
+               Summarize(samples, windowSize, true),
+               Summarize(samples, windowSize, false)));
+         }
+   }
+
+   SECTION("finds extremes and sum of squares")
+   {
+      const std::vector<float> samples { 0.5f, -1.f, 2.f, 0.f };
+      float summary[3];
+      SampleSummary::SummarizeWindows(samples.data(), 4, 1, summary);
+      REQUIRE(summary[0] == -1.f);
+      REQUIRE(summary[1] == 2.f);
+      REQUIRE(summary[2] == 5.25f);
+   }
+}
+
+TEST_CASE("SampleSummary::Summarize")
+{
+   SECTION("empty")
+   {
+      const auto result = SampleSummary::Summarize(nullptr, 0);
+      REQUIRE(result.min == FLT_MAX);
+      REQUIRE(result.max == -FLT_MAX);
+      REQUIRE(result.sumsq == 0.0);
+   }
+
+   SECTION("extremes are not hidden by a NaN that begins a window")
+   {
+      std::vector<float> samples(300, 0.f);
+      samples[256] = std::nanf("");
+      samples[257] = -3.f;
+      samples[299] = 4.f;
+      const auto result = SampleSummary::Summarize(samples.data(), 300);
+      REQUIRE(result.min == -3.f);
+      REQUIRE(result.max == 4.f);
+   }
+
+   SECTION("agrees to the bit with a plain loop in single precision")
+   {
+      for (const size_t count : { 1, 255, 256, 1000, 100000 })
+      {
+         const auto samples = RandomSamples(count);
+         float min = FLT_MAX, max = -FLT_MAX;
+         float sumsq = 0;
+         for (auto sample : samples)
+         {
+            if (sample > max)
+               max = sample;
+            if (sample < min)
+               min = sample;
+            sumsq += sample * sample;
+         }
+         const auto result = SampleSummary::Summarize(samples.data(), count);
+         REQUIRE(result.min == min);
+         REQUIRE(result.max == max);
+         REQUIRE(result.sumsq == sumsq);
+      }
+   }
+}
+
+TEST_CASE("SampleSummary benchmark", "[!benchmark]")
+{
+   // About six minutes of mono audio at 44.1 kHz
+   const auto samples = RandomSamples(1 << 24);
+   const auto time = [&](bool scalar) {
+      const auto start = std::chrono::steady_clock::now();
+      for (auto ii = 0; ii < 10; ++ii)
+         Summarize(samples, 256, scalar);
+      return std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start)
+         .count();
+   };
+   const auto scalarTime = time(true);
+   const auto vectorTime = time(false);
+   std::cout << "SummarizeWindows: scalar " << scalarTime << " s, "
+             << SampleSummary::GetInstructionSet() << " " << vectorTime
+             << " s\n";
+}
@@ -17,9 +17,11 @@ Paul Licameli -- split from ProjectFileIO.cpp
 
 #include "AudacityLogger.h"
 #include "BasicUI.h"
+#include "BlockPrefetcher.h"
 #include "FileNames.h"
 #include "Internat.h"
 #include "Project.h"
+#include "ProjectFormatVersion.h"
 #include "FileException.h"
 #include "wxFileNameWrapper.h"
 
@@ -28,8 +30,11 @@ Paul Licameli -- split from ProjectFileIO.cpp
 #define xstr(a) str(a)
 #define str(a) #a
 
+// Free pages can be given back to the file system without copying the file,
+// but only if this is set before any table is created
 static const char* PageSizeConfig =
    "PRAGMA <schema>.page_size = " xstr(AUDACITY_PROJECT_PAGE_SIZE) ";"
+   "PRAGMA <schema>.auto_vacuum = INCREMENTAL;"
    "VACUUM;";
 
 // Configuration to provide "safe" connections
@@ -54,6 +59,7 @@ DBConnection::DBConnection(
 : mpProject{ pProject }
 , mpErrors{ pErrors }
 , mCallback{ std::move(callback) }
+, mpPrefetcher{ std::make_unique<BlockPrefetcher>() }
 {
    mDB = nullptr;
    mCheckpointDB = nullptr;
@@ -70,6 +76,11 @@ DBConnection::~DBConnection()
    }
 }
 
+BlockPrefetcher &DBConnection::GetPrefetcher()
+{
+   return *mpPrefetcher;
+}
+
 void DBConnection::SetBypass( bool bypass )
 {
    mBypass = bypass;
@@ -278,6 +289,9 @@ bool DBConnection::Close()
       mCheckpointThread.join();
    }
 
+   // Stop reading blocks ahead, before the statements it may use go away
+   mpPrefetcher->Stop();
+
    // We're done with the prepared statements
    {
       std::lock_guard<std::mutex> guard(mStatementMutex);
@@ -296,6 +310,9 @@ bool DBConnection::Close()
          }
       }
       mStatements.clear();
+      mDerivedDataTable = TableState::Unknown;
+      mDerivedDataBytes.reset();
+      mBlockEncoding = TableState::Unknown;
    }
 
    // Not much we can do if the closes fail, so just report the error
@@ -469,6 +486,169 @@ sqlite3_stmt *DBConnection::Prepare(enum StatementID id, const char *sql)
    return stmt;
 }
 
+bool DBConnection::HasDerivedDataTable(bool create)
+{
+   std::lock_guard<std::mutex> guard(mStatementMutex);
+
+   if (mDerivedDataTable == TableState::Unknown)
+   {
+      sqlite3_stmt *stmt = nullptr;
+      int rc = sqlite3_prepare_v2(mDB,
+         "SELECT 1 FROM sqlite_master"
+         " WHERE type = 'table' AND name = 'derivedblockdata';",
+         -1, &stmt, nullptr);
+      if (rc == SQLITE_OK)
+      {
+         rc = sqlite3_step(stmt);
+         mDerivedDataTable = rc == SQLITE_ROW
+            ? TableState::Present : TableState::Absent;
+      }
+      sqlite3_finalize(stmt);
+   }
+
+   if (create && mDerivedDataTable == TableState::Absent)
+   {
+      // Rows are removed with their sample blocks, or else by
+      // ProjectFileIO::DeleteBlocks()
+      int rc = sqlite3_exec(mDB,
+         "CREATE TABLE IF NOT EXISTS derivedblockdata"
+         "("
+         "  blockid INTEGER,"
+         "  key TEXT,"
+         "  data BLOB,"
+         "  PRIMARY KEY (blockid, key)"
+         ") WITHOUT ROWID;",
+         nullptr, nullptr, nullptr);
+      if (rc == SQLITE_OK)
+         mDerivedDataTable = TableState::Present;
+      else
+      {
+         wxLogMessage("Failed to create table of derived data for %s\n"
+                      "\tError: %s\n",
+                      sqlite3_db_filename(mDB, nullptr),
+                      sqlite3_errmsg(mDB));
+         mDerivedDataTable = TableState::Unavailable;
+      }
+   }
+
+   return mDerivedDataTable == TableState::Present;
+}
+
+bool DBConnection::ReserveDerivedData(size_t size, size_t limit)
+{
+   std::lock_guard<std::mutex> guard(mStatementMutex);
+
+   if (!mDerivedDataBytes)
+   {
+      sqlite3_stmt *stmt = nullptr;
+      int rc = sqlite3_prepare_v2(mDB,
+         "SELECT TOTAL(LENGTH(data)) FROM derivedblockdata;",
+         -1, &stmt, nullptr);
+      if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+         mDerivedDataBytes = sqlite3_column_int64(stmt, 0);
+      sqlite3_finalize(stmt);
+      if (!mDerivedDataBytes)
+         return false;
+   }
+
+   // Rows replaced are counted again, so the total may be overestimated
+   // until the table is measured again
+   if (*mDerivedDataBytes + size > limit)
+      return false;
+   *mDerivedDataBytes += size;
+   return true;
+}
+
+void DBConnection::ForgetDerivedDataSize()
+{
+   std::lock_guard<std::mutex> guard(mStatementMutex);
+   mDerivedDataBytes.reset();
+}
+
+void DBConnection::DropDerivedDataTable()
+{
+   std::lock_guard<std::mutex> guard(mStatementMutex);
+
+   if (mDerivedDataTable == TableState::Absent ||
+       mDerivedDataTable == TableState::Unavailable)
+      return;
+
+   // Cached statements that use the table are prepared again if it is made
+   // again
+   int rc = sqlite3_exec(mDB, "DROP TABLE IF EXISTS derivedblockdata;",
+      nullptr, nullptr, nullptr);
+   if (rc != SQLITE_OK)
+      wxLogMessage("Failed to drop table of derived data for %s\n"
+                   "\tError: %s\n",
+                   sqlite3_db_filename(mDB, nullptr),
+                   sqlite3_errmsg(mDB));
+
+   // The drop may yet be rolled back with a transaction
+   mDerivedDataTable = TableState::Unknown;
+   mDerivedDataBytes.reset();
+}
+
+bool DBConnection::HasBlockEncoding(bool create)
+{
+   std::lock_guard<std::mutex> guard(mStatementMutex);
+
+   if (mBlockEncoding == TableState::Unknown)
+   {
+      sqlite3_stmt *stmt = nullptr;
+      int rc = sqlite3_prepare_v2(mDB,
+         "SELECT 1 FROM pragma_table_info('sampleblocks', 'main')"
+         " WHERE name = 'encoding';",
+         -1, &stmt, nullptr);
+      if (rc == SQLITE_OK)
+      {
+         rc = sqlite3_step(stmt);
+         mBlockEncoding = rc == SQLITE_ROW
+            ? TableState::Present : TableState::Absent;
+      }
+      sqlite3_finalize(stmt);
+   }
+
+   if (create && mBlockEncoding == TableState::Absent)
+   {
+      if (AddBlockEncoding() == SQLITE_OK)
+         mBlockEncoding = TableState::Present;
+      else
+      {
+         wxLogMessage("Failed to add columns for compressed samples to %s\n"
+                      "\tError: %s\n",
+                      sqlite3_db_filename(mDB, nullptr),
+                      sqlite3_errmsg(mDB));
+         mBlockEncoding = TableState::Unavailable;
+      }
+   }
+
+   return mBlockEncoding == TableState::Present;
+}
+
+int DBConnection::AddBlockEncoding(const char *schema)
+{
+   // Both columns or neither, and the version that older builds refuse;
+   // a savepoint works inside or outside of an open transaction.  Rows
+   // without an encoding hold raw samples.
+   wxString sql = wxString::Format(
+      "SAVEPOINT AddBlockEncoding;"
+      "ALTER TABLE <schema>.sampleblocks ADD COLUMN encoding INTEGER;"
+      "ALTER TABLE <schema>.sampleblocks ADD COLUMN samplecount INTEGER;"
+      "PRAGMA <schema>.user_version = %u;"
+      "RELEASE AddBlockEncoding;",
+      CompressedBlocksProjectFormatVersion.GetPacked());
+   sql.Replace(wxT("<schema>"), schema);
+   int rc = sqlite3_exec(mDB, sql, nullptr, nullptr, nullptr);
+   if (rc != SQLITE_OK)
+   {
+      sqlite3_exec(mDB,
+         "ROLLBACK TO AddBlockEncoding;"
+         "RELEASE AddBlockEncoding;",
+         nullptr, nullptr, nullptr);
+   }
+   return rc;
+}
+
 void DBConnection::CheckpointThread(sqlite3 *db, const FilePath &fileName)
 {
    int rc = SQLITE_OK;
@@ -18,6 +18,7 @@ Paul Licameli -- split from ProjectFileIO.h
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <chrono>
 
@@ -26,6 +27,7 @@ Paul Licameli -- split from ProjectFileIO.h
 
 struct sqlite3;
 struct sqlite3_stmt;
+class BlockPrefetcher;
 class wxString;
 class AudacityProject;
 
@@ -75,16 +77,55 @@ public:
    enum StatementID
    {
       GetSamples,
+      GetSamplesBatch,
       GetSummary256,
       GetSummary64k,
       LoadSampleBlock,
+      LoadEncodedSampleBlock,
       InsertSampleBlock,
+      InsertEncodedSampleBlock,
       DeleteSampleBlock,
       GetSampleBlockSize,
-      GetAllSampleBlocksSize
+      GetAllSampleBlocksSize,
+      LoadDerivedData,
+      StoreDerivedData,
+      DeleteDerivedData
    };
    sqlite3_stmt *Prepare(enum StatementID id, const char *sql);
 
+   //! Whether the table of data derived from sample blocks exists
+   /*!
+    It is made only on demand, so that projects that never store such data
+    stay readable by older versions.  The answer is remembered until Close().
+    @param create whether to make the table if it is missing; fails quietly,
+    as when the project is read only
+    */
+   bool HasDerivedDataTable(bool create);
+
+   //! Count `size` more bytes of derived data, unless the table would then
+   //! hold more than `limit`
+   /*! The table is measured when first needed, and again after ForgetDerivedDataSize() */
+   bool ReserveDerivedData(size_t size, size_t limit);
+   //! Measure the table again when next needed, as after deleting rows
+   void ForgetDerivedDataSize();
+   //! Delete all derived data, as when compacting; fails quietly
+   void DropDerivedDataTable();
+
+   //! Whether the sampleblocks table has the columns for compressed samples
+   /*!
+    Like the table of derived data, they are added only on demand, and the
+    answer is remembered until Close().
+    @param create whether to add the columns if they are missing
+    */
+   bool HasBlockEncoding(bool create);
+
+   //! Add the columns for compressed samples to sampleblocks in `schema`
+   int AddBlockEncoding(const char *schema = "main");
+
+   //! Loads blocks ahead of sequential reads through this connection
+   /*! Its thread is stopped by Close() */
+   BlockPrefetcher &GetPrefetcher();
+
    void SetBypass( bool bypass );
    bool ShouldBypass();
 
@@ -123,9 +164,17 @@ private:
    using StatementIndex = std::pair<enum StatementID, std::thread::id>;
    std::map<StatementIndex, sqlite3_stmt *> mStatements;
 
+   enum class TableState { Unknown, Absent, Present, Unavailable };
+   // Guarded by mStatementMutex
+   TableState mDerivedDataTable{ TableState::Unknown };
+   std::optional<size_t> mDerivedDataBytes;
+   TableState mBlockEncoding{ TableState::Unknown };
+
    std::shared_ptr<DBConnectionErrors> mpErrors;
    CheckpointFailureCallback mCallback;
 
+   const std::unique_ptr<BlockPrefetcher> mpPrefetcher;
+
    // Bypass transactions if database will be deleted after close
    bool mBypass;
 };
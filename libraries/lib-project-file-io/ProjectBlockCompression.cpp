@@ -0,0 +1,61 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectBlockCompression.cpp
+
+**********************************************************************/
+
+#include "ProjectBlockCompression.h"
+
+#include "Project.h"
+#include "XMLWriter.h"
+#include "XMLAttributeValueView.h"
+
+static const AudacityProject::AttachedObjects::RegisteredFactory
+sKey{
+  []( AudacityProject &){
+     return std::make_shared< ProjectBlockCompression >();
+   }
+};
+
+ProjectBlockCompression &ProjectBlockCompression::Get(AudacityProject &project)
+{
+   return project.AttachedObjects::Get<ProjectBlockCompression>(sKey);
+}
+
+const ProjectBlockCompression &
+ProjectBlockCompression::Get(const AudacityProject &project)
+{
+   return Get(const_cast<AudacityProject&>(project));
+}
+
+ProjectBlockCompression::ProjectBlockCompression() = default;
+
+bool ProjectBlockCompression::IsEnabled() const
+{
+   return mEnabled.load(std::memory_order_relaxed);
+}
+
+void ProjectBlockCompression::SetEnabled(bool enabled)
+{
+   mEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+// Written only when enabled, so that other projects are unchanged
+static ProjectFileIORegistry::AttributeWriterEntry entry {
+[](const AudacityProject &project, XMLWriter &xmlFile){
+   if (ProjectBlockCompression::Get(project).IsEnabled())
+      xmlFile.WriteAttr(wxT("compressblocks"), true);
+}
+};
+
+static ProjectFileIORegistry::AttributeReaderEntries entries {
+// Just a pointer to function, but needing overload resolution as non-const:
+(ProjectBlockCompression& (*)(AudacityProject &))
+   &ProjectBlockCompression::Get, {
+   { "compressblocks", [](auto &settings, auto value){
+      settings.SetEnabled(value.Get(false));
+   } }
+} };
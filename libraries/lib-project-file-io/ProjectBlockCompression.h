@@ -0,0 +1,40 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectBlockCompression.h
+
+**********************************************************************/
+#pragma once
+
+#include "ClientData.h"
+
+#include <atomic>
+
+class AudacityProject;
+
+//! Whether new sample blocks of a project are stored compressed
+/*!
+ Blocks are compressed losslessly with SampleCodec, when that makes them
+ smaller.  Off by default, because versions that can't decode such blocks
+ can't open the project.  Only blocks made after the change are affected.
+ */
+class PROJECT_FILE_IO_API ProjectBlockCompression final
+   : public ClientData::Base
+{
+public:
+   static ProjectBlockCompression &Get(AudacityProject &project);
+   static const ProjectBlockCompression &Get(const AudacityProject &project);
+
+   ProjectBlockCompression();
+   ProjectBlockCompression(const ProjectBlockCompression &) = delete;
+   ProjectBlockCompression &operator=(const ProjectBlockCompression &) = delete;
+
+   //! May be called from any thread, as when importing
+   bool IsEnabled() const;
+   void SetEnabled(bool enabled);
+
+private:
+   std::atomic<bool> mEnabled{ false };
+};
@@ -12,8 +12,11 @@ Paul Licameli split from AudacityProject.cpp
 
 #include <atomic>
 #include <sqlite3.h>
+#include <limits>
+#include <map>
 #include <optional>
 #include <cstring>
+#include <unordered_map>
 
 #include <wx/crt.h>
 #include <wx/log.h>
@@ -33,6 +36,8 @@ Paul Licameli split from AudacityProject.cpp
 #include "SampleBlock.h"
 #include "TempDirectory.h"
 #include "TransactionScope.h"
+#include "UndoManager.h"
+#include "UndoTracks.h"
 #include "WaveTrack.h"
 #include "WaveTrackUtilities.h"
 #include "BasicUI.h"
@@ -100,6 +105,9 @@ static const char *ProjectFileSchema =
    // settings.
    "PRAGMA <schema>.application_id = %d;"
    "PRAGMA <schema>.user_version = %u;"
+   // Must precede the creation of tables; DBConnection sets it too, before
+   // the VACUUM that sets the page size
+   "PRAGMA <schema>.auto_vacuum = INCREMENTAL;"
    ""
    // project is a binary representation of an XML file.
    // it's in binary for speed.
@@ -166,6 +174,195 @@ static const char *ProjectFileSchema =
    "  samples              BLOB"
    ");";
 
+// Kept apart from ProjectFileSchema so that it can also be added to project
+// files created before incremental autosave.
+static const char *AutoSavePartsSchema =
+   // CREATE SQL autosaveparts
+   // autosaveparts is the autosave document split into rows that are
+   // rewritten separately, so that an autosave need not rewrite the tracks
+   // that did not change.
+   // id is fixed for the dictionary, the start and the end of the document,
+   // and otherwise identifies one track.
+   // seq orders the rows, whose docs are concatenated when reading.
+   // The first row holds the dictionary of fieldnames, which is shared by
+   // all of the other rows.
+   // One more row, which is not part of the document, holds a checksum of
+   // the project document that the parts were written over; the parts are
+   // ignored if the project document is different, as when another version
+   // saved it.
+   // The autosave table is empty while this table is in use.
+   "CREATE TABLE IF NOT EXISTS <schema>.autosaveparts"
+   "("
+   "  id                   INTEGER PRIMARY KEY,"
+   "  seq                  INTEGER,"
+   "  doc                  BLOB"
+   ");";
+
+namespace {
+// Fixed ids of rows of the autosaveparts table; rows for tracks follow
+enum : int64_t {
+   DictPartID = 1,
+   HeadPartID,
+   TailPartID,
+   ProjectPartID,
+   FirstTrackPartID,
+};
+
+// Values of seq, ordering the rows; rows for tracks are in between, and the
+// checksum of the project document comes before all
+constexpr int64_t ProjectPartSeq = -1;
+constexpr int64_t DictPartSeq = 0;
+constexpr int64_t HeadPartSeq = 1;
+constexpr int64_t FirstTrackPartSeq = 2;
+constexpr int64_t TailPartSeq = std::numeric_limits<int64_t>::max();
+
+// Creates the autosaveparts table, which is missing from project files
+// created before incremental autosave, then empties both autosave tables
+wxString ClearAutoSaveSQL()
+{
+   wxString sql{ AutoSavePartsSchema };
+   sql.Replace("<schema>", "main");
+   sql += "DELETE FROM main.autosave;"
+          "DELETE FROM main.autosaveparts;";
+   return sql;
+}
+}
+
+//! The document written by an autosave, and the ranges of it stored in each
+//! row of the autosaveparts table
+struct ProjectFileIO::AutoSaveState final
+{
+   //! Identifies the part for a track.  Tracks without an id, which are
+   //! added by recording, are told apart by their order.
+   using Key = std::pair<TrackId, size_t>;
+
+   struct Part final
+   {
+      int64_t id;
+      int64_t seq;
+      size_t begin;
+      size_t end;
+      //! Whether the row must be rewritten, else whether its seq must be
+      bool changed{ true };
+      bool moved{ true };
+   };
+
+   AutoSaveState(std::shared_ptr<ProjectSerializer::Dictionary> pDictionary,
+      std::shared_ptr<const AutoSaveState> pPrevious);
+
+   //! End the current part, and begin the part for a track, or with null,
+   //! the end of the document
+   void StartPart(const Track *pTrack);
+
+   //! End the last part, and compare all parts with the previous autosave
+   void Finish();
+
+   ProjectSerializer doc;
+   size_t dictSize{};
+   bool dictChanged{ true };
+   Part head{ HeadPartID, HeadPartSeq };
+   Part tail{ TailPartID, TailPartSeq };
+   std::map<Key, Part> tracks;
+   //! Rows of tracks that are gone since the previous autosave
+   std::vector<int64_t> removed;
+   int64_t nextID{ FirstTrackPartID };
+
+   //! What this autosave is compared with, until it is written
+   std::shared_ptr<const AutoSaveState> pPrevious;
+
+private:
+   Part *mpPart{ &head };
+   std::map<TrackId, size_t> mCounts;
+   int64_t mNextSeq{ FirstTrackPartSeq };
+};
+
+ProjectFileIO::AutoSaveState::AutoSaveState(
+   std::shared_ptr<ProjectSerializer::Dictionary> pDictionary,
+   std::shared_ptr<const AutoSaveState> pPrevious
+)  : doc{ std::move(pDictionary) }
+   , pPrevious{ std::move(pPrevious) }
+{
+   if (this->pPrevious)
+      nextID = this->pPrevious->nextID;
+}
+
+void ProjectFileIO::AutoSaveState::StartPart(const Track *pTrack)
+{
+   const auto offset = doc.GetData().GetSize();
+   mpPart->end = offset;
+   if (!pTrack)
+   {
+      mpPart = &tail;
+      mpPart->begin = offset;
+      return;
+   }
+
+   // Reuse the row that held the same track before
+   const auto id = pTrack->GetId();
+   const Key key{ id, mCounts[id]++ };
+   int64_t partID = 0;
+   if (pPrevious)
+   {
+      if (const auto iter = pPrevious->tracks.find(key);
+          iter != pPrevious->tracks.end())
+         partID = iter->second.id;
+   }
+   if (!partID)
+      partID = nextID++;
+
+   mpPart = &(tracks[key] = { partID, mNextSeq++, offset, offset });
+}
+
+void ProjectFileIO::AutoSaveState::Finish()
+{
+   mpPart->end = doc.GetData().GetSize();
+   dictSize = doc.GetDict().GetSize();
+   if (!pPrevious)
+      return;
+
+   // The dictionary only grows, so it changed if and only if its size did
+   dictChanged = pPrevious->dictSize != dictSize;
+
+   // The previous document was made linear when it was written, so this
+   // does not modify it
+   const auto oldData =
+      static_cast<const uint8_t*>(pPrevious->doc.GetData().GetData());
+   const auto data = static_cast<const uint8_t*>(doc.GetData().GetData());
+   const auto compare = [&](Part &part, const Part &old) {
+      const auto size = part.end - part.begin;
+      part.changed = old.end - old.begin != size ||
+         memcmp(data + part.begin, oldData + old.begin, size) != 0;
+      part.moved = old.seq != part.seq;
+   };
+
+   compare(head, pPrevious->head);
+   compare(tail, pPrevious->tail);
+   for (auto &[key, part] : tracks)
+   {
+      if (const auto iter = pPrevious->tracks.find(key);
+          iter != pPrevious->tracks.end())
+         compare(part, iter->second);
+   }
+
+   for (const auto &[key, part] : pPrevious->tracks)
+   {
+      if (tracks.count(key) == 0)
+         removed.push_back(part.id);
+   }
+}
+
+//! A snapshot of tracks to be written by the autosave thread
+struct ProjectFileIO::AutoSaveJob final
+{
+   //! Has the project attachments already written
+   std::shared_ptr<AutoSaveState> pState;
+   std::shared_ptr<const TrackList> pTracks;
+   //! Tracks that are not safe to serialize on other threads, written
+   //! already
+   std::unordered_map<const Track *, std::unique_ptr<ProjectSerializer>>
+      written;
+   bool success{ false };
+};
 
 class SQLiteBlobStream final
 {
@@ -292,11 +489,22 @@ private:
 class BufferedProjectBlobStream : public BufferedStreamReader
 {
 public:
-   static constexpr std::array<const char*, 2> Columns = { "dict", "doc" };
+   //! One of the blobs that are read in sequence
+   struct Blob final
+   {
+      const char* table;
+      const char* column;
+      int64_t rowID;
+   };
+
+   //! The blobs of a whole document, as written by WriteDoc()
+   static std::vector<Blob> DocumentBlobs(const char* table, int64_t rowID)
+   {
+      return { { table, "dict", rowID }, { table, "doc", rowID } };
+   }
 
    BufferedProjectBlobStream(
-      sqlite3* db, const char* schema, const char* table,
-      int64_t rowID)
+      sqlite3* db, const char* schema, std::vector<Blob> blobs)
        // Despite we use 64k pages in SQLite - it is impossible to guarantee
        // that read is satisfied from a single page.
        // Reading 64k proved to be slower, (64k - 8) gives no measurable difference
@@ -305,22 +513,22 @@ public:
        : BufferedStreamReader(32 * 1024)
        , mDB(db)
        , mSchema(schema)
-       , mTable(table)
-       , mRowID(rowID)
+       , mBlobs(std::move(blobs))
    {
    }
 
 private:
    bool OpenBlob(size_t index)
    {
-      if (index >= Columns.size())
+      if (index >= mBlobs.size())
       {
          mBlobStream.reset();
          return false;
       }
 
+      const auto& blob = mBlobs[index];
       mBlobStream = SQLiteBlobStream::Open(
-         mDB, mSchema, mTable, Columns[index], mRowID, true);
+         mDB, mSchema, blob.table, blob.column, blob.rowID, true);
 
       return mBlobStream.has_value();
    }
@@ -330,13 +538,12 @@ private:
 
    sqlite3* mDB;
    const char* mSchema;
-   const char* mTable;
-   const int64_t mRowID;
+   const std::vector<Blob> mBlobs;
 
 protected:
    bool HasMoreData() const override
    {
-      return mBlobStream.has_value() || mNextBlobIndex < Columns.size();
+      return mBlobStream.has_value() || mNextBlobIndex < mBlobs.size();
    }
 
    size_t ReadData(void* buffer, size_t maxBytes) override
@@ -356,7 +563,7 @@ protected:
          // Reading has failed, close the stream and do not allow opening
          // the next one
          mBlobStream = {};
-         mNextBlobIndex = Columns.size();
+         mNextBlobIndex = mBlobs.size();
 
          return 0;
       }
@@ -369,7 +576,12 @@ protected:
    }
 };
 
-constexpr std::array<const char*, 2> BufferedProjectBlobStream::Columns;
+static bool sProfileOpening = false;
+
+void ProjectFileIO::SetProfileOpening(bool profile)
+{
+   sProfileOpening = profile;
+}
 
 bool ProjectFileIO::InitializeSQL()
 {
@@ -436,6 +648,15 @@ ProjectFileIO::ProjectFileIO(AudacityProject &project)
 
 ProjectFileIO::~ProjectFileIO()
 {
+   if (mAutoSaveThread.joinable())
+   {
+      {
+         std::lock_guard<std::mutex> lock{ mAutoSaveMutex };
+         mAutoSaveStop = true;
+      }
+      mAutoSaveCondition.notify_all();
+      mAutoSaveThread.join();
+   }
 }
 
 bool ProjectFileIO::HasConnection() const
@@ -776,7 +997,8 @@ bool ProjectFileIO::CheckVersion()
    // process it since we can't trust anything about it.
    // TODO: use the SupportedProjectFormatVersion instead and make a way to
    // clearly distinguish projects created by either Audacity or Tenacity.
-   if (SupportedAudacityProjectFormatVersion < version)
+   if (SupportedAudacityProjectFormatVersion < version &&
+       version != CompressedBlocksProjectFormatVersion)
    {
       SetError(
          XO("This project was created with a version of Audacity that is not supported by Tenacity.\n\nYou will need to use that version to open it.")
@@ -802,6 +1024,7 @@ bool ProjectFileIO::InstallSchema(sqlite3 *db, const char *schema /* = "main" */
 
    wxString sql;
    sql.Printf(ProjectFileSchema, ProjectFileID, BaseProjectFormatVersion.GetPacked());
+   sql += AutoSavePartsSchema;
    sql.Replace("<schema>", schema);
 
    rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
@@ -910,6 +1133,18 @@ bool ProjectFileIO::DeleteBlocks(const BlockIDs &blockids, bool complement)
       mRecovered = true;
    }
 
+   // Data derived from the same blocks, such as spectrograms, goes with
+   // them.  This is only a cache, so failure doesn't matter.
+   if (auto &connection = GetConnection();
+       connection.HasDerivedDataTable(false))
+   {
+      sql = wxString::Format(
+         "DELETE FROM derivedblockdata WHERE %sinset(blockid);",
+         complement ? "NOT " : "" );
+      sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+      connection.ForgetDerivedDataSize();
+   }
+
    return true;
 }
 
@@ -1036,6 +1271,16 @@ bool ProjectFileIO::CopyTo(const FilePath &destpath,
       return false;
    }
 
+   // Rows are copied whole, so the columns for compressed samples must match
+   if (pConn->HasBlockEncoding(false) &&
+       pConn->AddBlockEncoding("outbound") != SQLITE_OK)
+   {
+      SetDBError(
+         XO("Unable to add columns for compressed samples")
+      );
+      return false;
+   }
+
    {
       // Ensure statement gets cleaned up
       sqlite3_stmt *stmt = nullptr;
@@ -1392,12 +1637,18 @@ void ProjectFileIO::Compact(
    // at project close time will still occur.
    mHadUnused = true;
 
+   mReclaimedBytes = 0;
+
+   // Files made since incremental vacuum was enabled are compacted in place,
+   // at a cost that depends on the unused space, not on the size of the file
+   const bool inPlace = CanVacuumIncrementally();
+
    // If forcing compaction, bypass inspection.
    if (!force)
    {
       // Don't compact if this is a temporary project or if it's determined there are not
       // enough unused blocks to make it worthwhile.
-      if (IsTemporary() || !ShouldCompact(tracks))
+      if (IsTemporary() || (!inPlace && !ShouldCompact(tracks)))
       {
          // Delete the AutoSave doc it if exists
          if (IsModified())
@@ -1416,6 +1667,14 @@ void ProjectFileIO::Compact(
       }
    }
 
+   if (inPlace)
+   {
+      mWasCompacted = CompactInPlace(tracks);
+      return;
+   }
+
+   // Older files must be copied; the copy is then compacted in place later
+
    wxString origName = mFileName;
    wxString backName = origName + "_compact_back";
    wxString tempName = origName + "_compact_temp";
@@ -1440,7 +1699,9 @@ void ProjectFileIO::Compact(
          //
          // Also, do this after closing the connection so that the -wal file
          // gets cleaned up.
-         if (wxFileName::GetSize(tempName) < wxFileName::GetSize(origName))
+         const auto tempSize = wxFileName::GetSize(tempName);
+         const auto origSize = wxFileName::GetSize(origName);
+         if (tempSize < origSize)
          {
             // Rename the original to backup
             if (wxRenameFile(origName, backName))
@@ -1462,6 +1723,7 @@ void ProjectFileIO::Compact(
 
                      // Remember that we compacted
                      mWasCompacted = true;
+                     mReclaimedBytes = (origSize - tempSize).GetValue();
 
                      return;
                   }
@@ -1515,6 +1777,133 @@ void ProjectFileIO::Compact(
    return;
 }
 
+bool ProjectFileIO::CompactInPlace(
+   const std::vector<const TrackList *> &tracks)
+{
+   // Make the same document that CopyTo() would
+   ProjectSerializer doc;
+   WriteXMLHeader(doc);
+   WriteXML(doc, false, tracks.empty() ? nullptr : tracks[0]);
+
+   {
+      TransactionScope transaction(mProject, "Compact");
+
+      // Delete the blocks that CopyTo() would not copy
+      if (!tracks.empty())
+      {
+         WaveTrackUtilities::SampleBlockIDSet blockids;
+         for (auto trackList : tracks)
+            if (trackList)
+               WaveTrackUtilities::InspectBlocks(*trackList, {}, &blockids);
+
+         // This is not recovery of orphans
+         const auto recovered = mRecovered;
+         const auto deleted = DeleteBlocks(blockids, true);
+         mRecovered = recovered;
+         if (!deleted)
+            return false;
+      }
+
+      // Nor does the copy keep data derived from blocks, which is only
+      // computed again
+      GetConnection().DropDerivedDataTable();
+
+      // As in the copy, the document is the only one, and a temporary project
+      // keeps it in the autosave table
+      const auto modified = mModified;
+      if (!AutoSaveDelete())
+         return false;
+      if (!WriteDoc(IsTemporary() ? "autosave" : "project", doc))
+         return false;
+      if (IsTemporary())
+         mModified = modified;
+
+      if (!transaction.Commit())
+         return false;
+   }
+
+   const auto reclaimed = IncrementalVacuum();
+   if (reclaimed < 0)
+      return false;
+   mReclaimedBytes = reclaimed;
+
+   return true;
+}
+
+bool ProjectFileIO::CanVacuumIncrementally()
+{
+   // 2 is INCREMENTAL
+   int64_t mode = 0;
+   return GetValue("PRAGMA auto_vacuum;", mode, true) && mode == 2;
+}
+
+int64_t ProjectFileIO::IncrementalVacuum(int64_t maxPages /* = 0 */)
+{
+   int64_t pageSize = 0;
+   int64_t before = 0;
+   if (!GetValue("PRAGMA page_size;", pageSize) ||
+       !GetValue("PRAGMA freelist_count;", before))
+      return -1;
+
+   if (before == 0)
+      return 0;
+
+   const auto sql = wxString::Format(
+      "PRAGMA incremental_vacuum(%lld);", static_cast<long long>(maxPages));
+   if (sqlite3_exec(DB(), sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+   {
+      SetDBError(
+         XO("Failed to update the project file.\nThe following command failed:\n\n%s")
+            .Format(sql)
+      );
+      return -1;
+   }
+
+   int64_t after = 0;
+   if (!GetValue("PRAGMA freelist_count;", after))
+      return -1;
+
+   // The file itself shrinks at the next checkpoint
+   return (before - after) * pageSize;
+}
+
+void ProjectFileIO::ScheduleVacuum()
+{
+   if (mVacuumScheduled)
+      return;
+   mVacuumScheduled = true;
+
+   BasicUI::CallAfter([wThis = weak_from_this()]{
+      if (const auto pThis = wThis.lock())
+      {
+         pThis->mVacuumScheduled = false;
+         GuardedCall([&]{ pThis->VacuumStep(); });
+      }
+   });
+}
+
+void ProjectFileIO::VacuumStep()
+{
+   // 4 MB of the usual 64 KB pages, so that each step is brief
+   static constexpr int64_t VacuumStepPages = 64;
+
+   // Don't open a file just for this, or join a transaction left open while
+   // a progress dialog yields, or compete with recording for the disk
+   if (!HasConnection() || !sqlite3_get_autocommit(DB()) ||
+       PendingTracks::Get(mProject).HasPendingTracks() ||
+       !CanVacuumIncrementally())
+      return;
+
+   const auto reclaimed = IncrementalVacuum(VacuumStepPages);
+   if (reclaimed > 0)
+   {
+      wxLogDebug(wxT("Incremental vacuum reclaimed %lld bytes"),
+         static_cast<long long>(reclaimed));
+      // There may be more
+      ScheduleVacuum();
+   }
+}
+
 bool ProjectFileIO::WasCompacted()
 {
    return mWasCompacted;
@@ -1525,6 +1914,11 @@ bool ProjectFileIO::HadUnused()
    return mHadUnused;
 }
 
+int64_t ProjectFileIO::GetReclaimedBytes() const
+{
+   return mReclaimedBytes;
+}
+
 void ProjectFileIO::UpdatePrefs()
 {
    SetProjectTitle();
@@ -1595,6 +1989,9 @@ void ProjectFileIO::SetFileName(const FilePath &fileName)
 
    mFileName = fileName;
 
+   // Rows written by incremental autosave belong to the previous connection
+   mpAutoSaveState.reset();
+
    if (!mFileName.empty())
    {
       ActiveProjects::Add(mFileName);
@@ -1729,6 +2126,19 @@ void ProjectFileIO::WriteXML(XMLWriter &xmlFile,
 
    //TIMER_START( "AudacityProject::WriteXML", xml_writer_timer );
 
+   WriteXMLStart(xmlFile);
+   WriteTracksXML(xmlFile, tracklist,
+      recording ? &PendingTracks::Get(proj) : nullptr);
+   xmlFile.EndTag(wxT("project"));
+
+   //TIMER_STOP( xml_writer_timer );
+}
+
+void ProjectFileIO::WriteXMLStart(XMLWriter &xmlFile)
+// may throw
+{
+   auto &proj = mProject;
+
    xmlFile.StartTag(wxT("project"));
    xmlFile.WriteAttr(wxT("xmlns"), wxT("http://audacity.sourceforge.net/xml/"));
 
@@ -1736,17 +2146,22 @@ void ProjectFileIO::WriteXML(XMLWriter &xmlFile,
    xmlFile.WriteAttr(wxT("audacityversion"), TENACITY_VERSION_STRING);
 
    ProjectFileIORegistry::Get().CallWriters(proj, xmlFile);
+}
 
-   auto &pendingTracks = PendingTracks::Get(proj);
-   tracklist.Any().Visit([&](const Track &t) {
+void ProjectFileIO::WriteTracksXML(XMLWriter &xmlFile,
+   const TrackList &tracks, const PendingTracks *pPendingTracks,
+   const TrackBoundary &boundary /* = {} */)
+// may throw
+{
+   tracks.Any().Visit([&](const Track &t) {
       auto useTrack = &t;
-      if (recording) {
+      if (pPendingTracks) {
          // When append-recording, there is a temporary "shadow" track accumulating
          // changes and displayed on the screen but it is not yet part of the
          // regular track list.  That is the one that we want to back up.
          // SubstitutePendingChangedTrack() fetches the shadow, if the track has
          // one, else it gives the same track back.
-         useTrack = &pendingTracks.SubstitutePendingChangedTrack(t);
+         useTrack = &pPendingTracks->SubstitutePendingChangedTrack(t);
       }
       else if (useTrack->GetId() == TrackId{}) {
          // This is a track added during a non-appending recording that is
@@ -1754,39 +2169,441 @@ void ProjectFileIO::WriteXML(XMLWriter &xmlFile,
          // when pushing.  Don't auto-save it.
          return;
       }
+      if (boundary)
+         boundary(useTrack);
       useTrack->WriteXML(xmlFile);
    });
 
-   xmlFile.EndTag(wxT("project"));
-
-   //TIMER_STOP( xml_writer_timer );
+   if (boundary)
+      boundary(nullptr);
 }
 
 bool ProjectFileIO::AutoSave(bool recording)
 {
-   ProjectSerializer autosave;
+   // This supersedes any autosave in progress or requested
+   WaitForAutoSave();
+   mAutoSaveRequested = false;
+
+   const auto pState =
+      std::make_shared<AutoSaveState>(mpAutoSaveDictionary, mpAutoSaveState);
+   auto &autosave = pState->doc;
    WriteXMLHeader(autosave);
-   WriteXML(autosave, recording);
+   WriteXMLStart(autosave);
+   WriteTracksXML(autosave, TrackList::Get(mProject),
+      recording ? &PendingTracks::Get(mProject) : nullptr,
+      [&](const Track *pTrack) { pState->StartPart(pTrack); });
+   autosave.EndTag(wxT("project"));
+   pState->Finish();
+
+   return WriteAutoSave(pState);
+}
+
+void ProjectFileIO::RequestAutoSave()
+{
+   mAutoSaveRequested = true;
+   mModified = true;
+
+   // Take the snapshot in idle time, after the undo state is updated
+   BasicUI::CallAfter([wThis = weak_from_this()]{
+      if (const auto pThis = wThis.lock())
+         GuardedCall([&]{ pThis->StartAutoSave(); });
+   });
+}
+
+void ProjectFileIO::StartAutoSave()
+{
+   if (!mAutoSaveRequested)
+      return;
 
-   if (WriteDoc("autosave", autosave))
    {
+      std::lock_guard<std::mutex> lock{ mAutoSaveMutex };
+      // OnAutoSaveDone() will call again
+      if (mpAutoSaveJob)
+         return;
+   }
+
+   mAutoSaveRequested = false;
+
+   // The tracks of an undo state do not change after they are pushed, so
+   // the worker thread can read them while the project goes on changing
+   std::shared_ptr<const TrackList> pTracks;
+   auto &undoManager = UndoManager::Get(mProject);
+   if (undoManager.GetNumStates() > 0)
+   {
+      const auto current = undoManager.GetCurrentState();
+      undoManager.VisitStates([&](const UndoStackElem &elem) {
+         if (const auto pList = UndoTracks::Find(elem))
+            pTracks = pList->shared_from_this();
+      }, current, current + 1);
+   }
+
+   if (!pTracks)
+   {
+      // No history yet to take a snapshot from
+      if (!AutoSave())
+         ReportAutoSaveFailure();
+      return;
+   }
+
+   // Project attachments are written now, on the main thread
+   const auto pJob = std::make_shared<AutoSaveJob>();
+   pJob->pTracks = std::move(pTracks);
+   pJob->pState =
+      std::make_shared<AutoSaveState>(mpAutoSaveDictionary, mpAutoSaveState);
+   auto &autosave = pJob->pState->doc;
+   WriteXMLHeader(autosave);
+   WriteXMLStart(autosave);
+
+   // So are tracks other than wave tracks, such as note tracks, whose
+   // serialization uses static buffers, and wave tracks with effects, whose
+   // plugins save their settings; the worker thread copies them into place
+   for (const auto pTrack : pJob->pTracks->Any())
+   {
+      if (pTrack->GetId() == TrackId{})
+         continue;
+      const auto pWaveTrack = dynamic_cast<const WaveTrack *>(pTrack);
+      if (pWaveTrack && !WaveTrack::XMLNeedsMainThread::Call(*pWaveTrack))
+         continue;
+      auto pWritten = std::make_unique<ProjectSerializer>(mpAutoSaveDictionary);
+      pTrack->WriteXML(*pWritten);
+      pJob->written.emplace(pTrack, std::move(pWritten));
+   }
+
+   if (!mAutoSaveThread.joinable())
+      mAutoSaveThread = std::thread{ [this]{ AutoSaveThread(); } };
+
+   {
+      std::lock_guard<std::mutex> lock{ mAutoSaveMutex };
+      mpAutoSaveJob = pJob;
+   }
+   mAutoSaveCondition.notify_all();
+}
+
+void ProjectFileIO::AutoSaveThread()
+{
+   std::unique_lock<std::mutex> lock{ mAutoSaveMutex };
+   while (true)
+   {
+      mAutoSaveCondition.wait(lock, [this]{
+         return mAutoSaveStop || (mpAutoSaveJob && !mAutoSaveJobDone); });
+      if (mAutoSaveStop)
+         break;
+
+      auto pJob = mpAutoSaveJob;
+      lock.unlock();
+
+      // Errors are reported in idle time
+      pJob->success = GuardedCall<bool>([&]{
+         auto &state = *pJob->pState;
+         // As WriteTracksXML() does, but copying what the main thread wrote
+         for (const auto pTrack : pJob->pTracks->Any())
+         {
+            if (pTrack->GetId() == TrackId{})
+               continue;
+            state.StartPart(pTrack);
+            if (const auto iter = pJob->written.find(pTrack);
+                iter != pJob->written.end())
+               state.doc.Append(*iter->second);
+            else
+               pTrack->WriteXML(state.doc);
+         }
+         state.StartPart(nullptr);
+         state.doc.EndTag(wxT("project"));
+         state.Finish();
+         return true;
+      }, MakeSimpleGuard(false));
+
+      lock.lock();
+
+      // Leave the job, with its snapshot of the tracks and their sample
+      // blocks, for the main thread to release
+      pJob.reset();
+      mAutoSaveJobDone = true;
+      mAutoSaveCondition.notify_all();
+
+      BasicUI::CallAfter([wThis = weak_from_this()]{
+         if (const auto pThis = wThis.lock())
+            pThis->OnAutoSaveDone();
+      });
+   }
+}
+
+auto ProjectFileIO::WaitForAutoSave() -> std::shared_ptr<AutoSaveJob>
+{
+   std::unique_lock<std::mutex> lock{ mAutoSaveMutex };
+   if (!mpAutoSaveJob)
+      return nullptr;
+
+   mAutoSaveCondition.wait(lock, [this]{ return mAutoSaveJobDone; });
+   mAutoSaveJobDone = false;
+   return std::move(mpAutoSaveJob);
+}
+
+void ProjectFileIO::OnAutoSaveDone()
+{
+   GuardedCall([this]{
+      if (const auto pJob = WaitForAutoSave(); pJob && pJob->success)
+      {
+         if (!WriteAutoSave(pJob->pState))
+            ReportAutoSaveFailure();
+         else
+            // Undo states purged by the edit may have freed sample blocks
+            ScheduleVacuum();
+      }
+
+      // Take the next snapshot, if there were requests meanwhile
+      StartAutoSave();
+   });
+}
+
+void ProjectFileIO::ReportAutoSaveFailure()
+{
+   // Report in idle time, as for an exception escaping any other handler
+   GuardedCall([]{
+      throw SimpleMessageBoxException{
+         ExceptionType::Internal,
+         XO("Automatic database backup failed."),
+         XO("Warning"),
+         "Error:_Disk_full_or_not_writable"
+      };
+   });
+}
+
+bool ProjectFileIO::WriteAutoSave(const std::shared_ptr<AutoSaveState> &pState)
+{
+   const auto success = WriteAutoSaveParts(*pState);
+
+   // Don't keep a chain of previous states
+   pState->pPrevious.reset();
+
+   if (success)
+   {
+      mpAutoSaveState = pState;
       mModified = true;
+   }
+   else
+      // The rows are in doubt, so write all of them next time
+      mpAutoSaveState.reset();
+
+   return success;
+}
+
+bool ProjectFileIO::WriteAutoSaveParts(const AutoSaveState &state)
+{
+   using Part = AutoSaveState::Part;
+
+   auto db = DB();
+
+   // Only the differences need writing, if the comparison was with what the
+   // last autosave wrote to this connection
+   const bool incremental =
+      state.pPrevious && state.pPrevious == mpAutoSaveState;
+
+   TransactionScope transaction(mProject, "UpdateProject");
+
+   const auto reportError = [this](auto sql) {
+      SetDBError(
+         XO("Failed to update the project file.\nThe following command failed:\n\n%s")
+            .Format(sql));
+   };
+
+   if (!incremental)
+   {
+      const auto sql = ClearAutoSaveSQL();
+      if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+      {
+         reportError(sql);
+         return false;
+      }
+   }
+
+   static const char *const WriteSQL =
+      "INSERT INTO main.autosaveparts(id, seq, doc) VALUES(?1, ?2, ?3)"
+      "       ON CONFLICT(id) DO UPDATE SET seq = ?2, doc = ?3;";
+   static const char *const MoveSQL =
+      "UPDATE main.autosaveparts SET seq = ?2 WHERE id = ?1;";
+   static const char *const DeleteSQL =
+      "DELETE FROM main.autosaveparts WHERE id = ?1;";
+
+   sqlite3_stmt *writeStmt = nullptr;
+   sqlite3_stmt *moveStmt = nullptr;
+   sqlite3_stmt *deleteStmt = nullptr;
+   auto cleanup = finally([&]
+   {
+      // Finalizing a null statement is harmless
+      sqlite3_finalize(writeStmt);
+      sqlite3_finalize(moveStmt);
+      sqlite3_finalize(deleteStmt);
+   });
+
+   for (auto [sql, pStmt] : {
+      std::pair{ WriteSQL, &writeStmt },
+      std::pair{ MoveSQL, &moveStmt },
+      std::pair{ DeleteSQL, &deleteStmt },
+   }) {
+      if (sqlite3_prepare_v2(db, sql, -1, pStmt, nullptr) != SQLITE_OK)
+      {
+         SetDBError(
+            XO("Unable to prepare project file command:\n\n%s").Format(sql)
+         );
+         return false;
+      }
+   }
+
+   const auto step = [&](sqlite3_stmt *stmt, const char *sql) {
+      const auto rc = sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+      if (rc != SQLITE_DONE)
+      {
+         reportError(sql);
+         return false;
+      }
+      return true;
+   };
+
+   const auto bind = [this](sqlite3_stmt *stmt, int index, int64_t value) {
+      if (sqlite3_bind_int64(stmt, index, value))
+      {
+         SetDBError(XO("Failed to bind SQL parameter"));
+         return false;
+      }
+      return true;
+   };
+
+   const auto write = [&](int64_t id, int64_t seq, const void *data, size_t size) {
+      if (!(bind(writeStmt, 1, id) && bind(writeStmt, 2, seq)))
+         return false;
+      if (sqlite3_bind_blob64(writeStmt, 3, data, size, SQLITE_STATIC))
+      {
+         SetDBError(XO("Unable to bind to blob"));
+         return false;
+      }
+      return step(writeStmt, WriteSQL);
+   };
+
+   const auto data =
+      static_cast<const uint8_t*>(state.doc.GetData().GetData());
+
+   const auto writePart = [&](const Part &part) {
+      if (!incremental || part.changed)
+         return write(part.id, part.seq,
+            data + part.begin, part.end - part.begin);
+      if (part.moved)
+         return bind(moveStmt, 1, part.id) && bind(moveStmt, 2, part.seq) &&
+            step(moveStmt, MoveSQL);
       return true;
+   };
+
+   if (!incremental)
+   {
+      const auto checksum = ProjectDocChecksum();
+      if (!checksum)
+         return false;
+      if (!(bind(writeStmt, 1, ProjectPartID) &&
+            bind(writeStmt, 2, ProjectPartSeq) &&
+            bind(writeStmt, 3, *checksum) && step(writeStmt, WriteSQL)))
+         return false;
+   }
+
+   if (!incremental || state.dictChanged)
+   {
+      const auto &dict = state.doc.GetDict();
+      if (!write(DictPartID, DictPartSeq, dict.GetData(), state.dictSize))
+         return false;
+   }
+
+   if (!writePart(state.head))
+      return false;
+
+   for (const auto &[key, part] : state.tracks)
+   {
+      if (!writePart(part))
+         return false;
+   }
+
+   if (!writePart(state.tail))
+      return false;
+
+   if (incremental)
+   {
+      // Remove the rows of tracks that are gone
+      for (const auto id : state.removed)
+      {
+         if (!(bind(deleteStmt, 1, id) && step(deleteStmt, DeleteSQL)))
+            return false;
+      }
+   }
+   else
+   {
+      const wxString setVersionSql = wxString::Format(
+         "PRAGMA user_version = %u", GetFormatVersion().GetPacked());
+
+      if (!Query(setVersionSql.c_str(), [](auto...) { return 0; }))
+      {
+         reportError(setVersionSql);
+         return false;
+      }
    }
 
-   return false;
+   return transaction.Commit();
+}
+
+ProjectFormatVersion ProjectFileIO::GetFormatVersion()
+{
+   return GetConnection().HasBlockEncoding(false)
+      ? CompressedBlocksProjectFormatVersion
+      : BaseProjectFormatVersion;
+}
+
+std::optional<int64_t> ProjectFileIO::ProjectDocChecksum()
+{
+   int64_t rowId = -1;
+   if (!GetValue("SELECT ROWID FROM main.project WHERE id = 1;", rowId, true))
+      return 0;
+
+   // FNV-1a, over the dictionary and the document
+   uint64_t hash = 14695981039346656037ull;
+   std::vector<uint8_t> buffer(32 * 1024);
+   for (const auto &blob :
+      BufferedProjectBlobStream::DocumentBlobs("project", rowId))
+   {
+      auto stream = SQLiteBlobStream::Open(
+         DB(), "main", blob.table, blob.column, blob.rowID, true);
+      if (!stream)
+      {
+         SetDBError(XO("Unable to read the project document"));
+         return {};
+      }
+      while (!stream->IsEof())
+      {
+         auto size = static_cast<int>(buffer.size());
+         if (stream->Read(buffer.data(), size) != SQLITE_OK)
+         {
+            SetDBError(XO("Unable to read the project document"));
+            return {};
+         }
+         for (int ii = 0; ii < size; ++ii)
+            hash = (hash ^ buffer[ii]) * 1099511628211ull;
+      }
+   }
+   // Keep it positive, as it is stored as an integer; zero means no document
+   return std::max<int64_t>(1, static_cast<int64_t>(hash >> 1));
 }
 
 bool ProjectFileIO::AutoSaveDelete(sqlite3 *db /* = nullptr */)
 {
    int rc;
 
+   // An autosave in progress or requested would only restore what is deleted
+   WaitForAutoSave();
+   mAutoSaveRequested = false;
+
    if (!db)
    {
       db = DB();
    }
 
-   rc = sqlite3_exec(db, "DELETE FROM autosave;", nullptr, nullptr, nullptr);
+   rc = sqlite3_exec(db, ClearAutoSaveSQL(), nullptr, nullptr, nullptr);
    if (rc != SQLITE_OK)
    {
       SetDBError(
@@ -1796,6 +2613,7 @@ bool ProjectFileIO::AutoSaveDelete(sqlite3 *db /* = nullptr */)
    }
 
    mModified = false;
+   mpAutoSaveState.reset();
 
    return true;
 }
@@ -1921,7 +2739,7 @@ bool ProjectFileIO::WriteDoc(const char *table,
       return false;
 
    const wxString setVersionSql =
-      wxString::Format("PRAGMA user_version = %u", BaseProjectFormatVersion.GetPacked());
+      wxString::Format("PRAGMA user_version = %u", GetFormatVersion().GetPacked());
 
    if (!Query(setVersionSql.c_str(), [](auto...) { return 0; }))
    {
@@ -1990,6 +2808,45 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
       !ignoreAutosave &&
       GetValue("SELECT ROWID FROM main.autosave WHERE id = 1;", rowId, true);
 
+   // Else look for an autosave written in parts.  (A whole document is
+   // preferred, because writing the parts empties the autosave table, so
+   // the whole document must be the later one, written by another version.)
+   std::vector<BufferedProjectBlobStream::Blob> parts;
+   if (!ignoreAutosave && !useAutosave)
+   {
+      // Fails silently if the table does not exist
+      const auto sql = wxString::Format(
+         "SELECT ROWID FROM main.autosaveparts WHERE id <> %lld ORDER BY seq;",
+         static_cast<long long>(ProjectPartID));
+      Query(sql.c_str(),
+         [&parts](int cols, char **vals, char **) {
+            long long partRowId;
+            if (wxString{ vals[0] }.ToLongLong(&partRowId))
+               parts.push_back({ "autosaveparts", "doc", partRowId });
+            return 0;
+         }, true);
+
+      // Parts written over another project document are stale; if that
+      // document can't be read, keep the parts, which may be all there is
+      const auto checksum = parts.empty() ? std::nullopt : ProjectDocChecksum();
+      if (checksum)
+      {
+         const auto checkSql = wxString::Format(
+            "SELECT doc FROM main.autosaveparts WHERE id = %lld;",
+            static_cast<long long>(ProjectPartID));
+         int64_t saved = 0;
+         if (!(GetValue(checkSql.c_str(), saved, true) && saved == *checksum))
+         {
+            wxLogMessage(
+               "Ignoring autosave parts not written over the project document");
+            parts.clear();
+            (void) sqlite3_exec(DB(), "DELETE FROM main.autosaveparts;",
+               nullptr, nullptr, nullptr);
+         }
+      }
+      useAutosave = !parts.empty();
+   }
+
    int64_t rowsCount = 0;
    // If we didn't have an autosave doc, load the project doc instead
    if (
@@ -2010,10 +2867,14 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
    else
    {
       // Load 'er up
-      BufferedProjectBlobStream stream(
-         DB(), "main", useAutosave ? "autosave" : "project", rowId);
+      if (parts.empty())
+         parts = BufferedProjectBlobStream::DocumentBlobs(
+            useAutosave ? "autosave" : "project", rowId);
+      BufferedProjectBlobStream stream(DB(), "main", std::move(parts));
 
-      success = ProjectSerializer::Decode(stream, this);
+      ProjectSerializer::DecodeProfile profile;
+      success = ProjectSerializer::Decode(
+         stream, this, sProfileOpening ? &profile : nullptr);
 
       if (!success)
       {
@@ -2025,6 +2886,7 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
 
       // Check for orphans blocks...sets mRecovered if any were deleted
 
+      const auto orphansStart = std::chrono::steady_clock::now();
       auto blockids = WaveTrackFactory::Get( mProject )
          .GetSampleBlockFactory()
             ->GetActiveBlockIDs();
@@ -2035,6 +2897,26 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
             return {};
       }
 
+      if (sProfileOpening)
+      {
+         using namespace std::chrono;
+         const auto ms = [](auto elapsed) {
+            return duration_cast<duration<double, std::milli>>(elapsed)
+               .count();
+         };
+         wxLogMessage(
+            "Profile of opening %s:\n"
+            "\tRead %zu bytes of document in %.1f ms\n"
+            "\tDecoded %zu tags, %zu attributes in %.1f ms,"
+            " of which %.1f ms in handlers; %zu strings converted\n"
+            "\tChecked %zu blocks for orphans in %.1f ms",
+            fileName,
+            profile.bytes, ms(profile.readTime),
+            profile.tags, profile.attributes, ms(profile.decodeTime),
+            ms(profile.handlerTime), profile.convertedStrings,
+            blockids.size(), ms(steady_clock::now() - orphansStart));
+      }
+
       // Remember if we used autosave or not
       if (useAutosave)
       {
@@ -2314,6 +3196,11 @@ bool ProjectFileIO::OpenProject()
 
 void ProjectFileIO::CloseProject()
 {
+   // Release the snapshot of any autosave in progress, while sample blocks
+   // can still be deleted
+   WaitForAutoSave();
+   mAutoSaveRequested = false;
+
    auto &currConn = CurrConn();
    if (!currConn)
    {
@@ -2606,12 +3493,5 @@ InvisibleTemporaryProject::~InvisibleTemporaryProject()
 //! Install the callback from undo manager
 static ProjectHistory::AutoSave::Scope scope {
 [](AudacityProject &project) {
-   auto &projectFileIO = ProjectFileIO::Get(project);
-   if ( !projectFileIO.AutoSave() )
-      throw SimpleMessageBoxException{
-         ExceptionType::Internal,
-         XO("Automatic database backup failed."),
-         XO("Warning"),
-         "Error:_Disk_full_or_not_writable"
-      };
+   ProjectFileIO::Get(project).RequestAutoSave();
 } };
@@ -11,8 +11,12 @@ Paul Licameli split from AudacityProject.h
 #ifndef __AUDACITY_PROJECT_FILE_IO__
 #define __AUDACITY_PROJECT_FILE_IO__
 
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <unordered_set>
 
 #include <wx/event.h>
@@ -20,8 +24,10 @@ Paul Licameli split from AudacityProject.h
 #include "ClientData.h" // to inherit
 #include "Observer.h"
 #include "Prefs.h" // to inherit
+#include "ProjectSerializer.h"
 #include "XMLTagHandler.h" // to inherit
 
+struct ProjectFormatVersion;
 struct sqlite3;
 struct sqlite3_context;
 struct sqlite3_stmt;
@@ -29,9 +35,10 @@ struct sqlite3_value;
 
 class AudacityProject;
 class DBConnection;
+class PendingTracks;
 struct DBConnectionErrors;
-class ProjectSerializer;
 class SqliteSampleBlock;
+class Track;
 class TrackList;
 class WaveTrack;
 
@@ -84,6 +91,9 @@ public:
    // class.  Reinvocations have no effect.  Return value is true for success.
    static bool InitializeSQL();
 
+   //! Whether LoadProject() logs where its time goes; set from the command line
+   static void SetProfileOpening(bool profile);
+
    static ProjectFileIO &Get( AudacityProject &project );
    static const ProjectFileIO &Get( const AudacityProject &project );
 
@@ -110,7 +120,12 @@ public:
 
    void MarkTemporary();
 
+   //! Write the autosave document now, from the tracks of the project
    bool AutoSave(bool recording = false);
+   //! Write the autosave document later, from the tracks of the current
+   //! undo state, serializing them on a worker thread; failure is reported
+   //! in idle time
+   void RequestAutoSave();
    bool AutoSaveDelete(sqlite3 *db = nullptr);
 
    bool OpenProject();
@@ -211,6 +226,9 @@ public:
    // The last compact check found unused blocks in the project file
    bool HadUnused();
 
+   // Bytes given back to the file system by the last compaction
+   int64_t GetReclaimedBytes() const;
+
    // In one SQL command, delete sample blocks with ids in the given set, or
    // (when complement is true), with ids not in the given set.
    bool DeleteBlocks(const BlockIDs &blockids, bool complement);
@@ -231,9 +249,20 @@ public:
 private:
    void OnCheckpointFailure();
 
+   //! Type of function called before each track is written, and with null
+   //! after the last
+   using TrackBoundary = std::function<void(const Track *pTrack)>;
+
    void WriteXMLHeader(XMLWriter &xmlFile) const;
    void WriteXML(XMLWriter &xmlFile, bool recording = false,
       const TrackList *tracks = nullptr) /* not override */;
+   //! Write the start tag of the project and the attachments to it
+   void WriteXMLStart(XMLWriter &xmlFile);
+   //! Write tracks, substituting pending tracks if given, else skipping
+   //! tracks not yet added
+   static void WriteTracksXML(XMLWriter &xmlFile, const TrackList &tracks,
+      const PendingTracks *pPendingTracks,
+      const TrackBoundary &boundary = {});
 
    // XMLTagHandler callback methods
    bool HandleXMLTag(const std::string_view& tag, const AttributesList &attrs) override;
@@ -272,6 +301,30 @@ private:
    bool CheckVersion();
    bool InstallSchema(sqlite3 *db, const char *schema = "main");
 
+   struct AutoSaveState;
+   struct AutoSaveJob;
+
+   // Hand the current undo state to the autosave thread, if requested and
+   // the thread is idle
+   void StartAutoSave();
+   void AutoSaveThread();
+   // Write what the autosave thread made, and start again if requested
+   void OnAutoSaveDone();
+   // Wait for the autosave thread to finish any job, and take it back
+   std::shared_ptr<AutoSaveJob> WaitForAutoSave();
+   static void ReportAutoSaveFailure();
+
+   bool WriteAutoSave(const std::shared_ptr<AutoSaveState> &pState);
+   // Write the autosave document as rows of the autosaveparts table,
+   // skipping those rows that are unchanged since the last autosave
+   bool WriteAutoSaveParts(const AutoSaveState &state);
+   // Checksum of the project document, or 0 if there is none, which
+   // autosave parts are checked against when loading
+   std::optional<int64_t> ProjectDocChecksum();
+   // Version to store in the main database, higher if blocks may be
+   // compressed
+   ProjectFormatVersion GetFormatVersion();
+
    // Write project or autosave XML (binary) documents
    bool WriteDoc(const char *table, const ProjectSerializer &autosave, const char *schema = "main");
 
@@ -301,6 +354,17 @@ private:
 
    bool ShouldCompact(const std::vector<const TrackList *> &tracks);
 
+   // Whether the project file can give back free pages without a copy
+   bool CanVacuumIncrementally();
+   // Move at most maxPages free pages (or all, if zero) to the end of the
+   // file and truncate it; return the bytes given back, or -1 for failure
+   int64_t IncrementalVacuum(int64_t maxPages = 0);
+   // Do what Compact() does, but without copying the project file
+   bool CompactInPlace(const std::vector<const TrackList *> &tracks);
+   // Give back free pages a few at a time, in idle time
+   void ScheduleVacuum();
+   void VacuumStep();
+
 private:
    Connection &CurrConn();
 
@@ -329,9 +393,31 @@ private:
    // Project had unused blocks during last Compact()
    bool mHadUnused;
 
+   // Bytes given back to the file system during last Compact()
+   int64_t mReclaimedBytes{ 0 };
+
+   bool mVacuumScheduled{ false };
+
    Connection mPrevConn;
    FilePath mPrevFileName;
    bool mPrevTemporary;
+
+   // What the last autosave wrote to the current connection, or null if the
+   // next autosave must rewrite all parts
+   std::shared_ptr<const AutoSaveState> mpAutoSaveState;
+
+   // Names of the autosave documents, used by one thread at a time
+   const std::shared_ptr<ProjectSerializer::Dictionary> mpAutoSaveDictionary{
+      std::make_shared<ProjectSerializer::Dictionary>() };
+   bool mAutoSaveRequested{ false };
+
+   std::thread mAutoSaveThread;
+   // Guard the members below
+   std::mutex mAutoSaveMutex;
+   std::condition_variable mAutoSaveCondition;
+   std::shared_ptr<AutoSaveJob> mpAutoSaveJob;
+   bool mAutoSaveJobDone{ false };
+   bool mAutoSaveStop{ false };
 };
 
 //! Makes a temporary project that doesn't display on the screen
@@ -16,8 +16,9 @@
 #include "ProjectSerializer.h"
 
 #include <algorithm>
+#include <cassert>
 #include <cstdint>
-#include <mutex>
+#include <cstring>
 #include <wx/ustring.h>
 #include <codecvt>
 #include <locale>
@@ -78,14 +79,18 @@ enum FieldTypes
    FT_Name           // type, ID, name length, name
 };
 
-// Static so that the dict can be reused each time.
+// The default dictionary is static so that the dict can be reused each time.
 //
 // If entries get added later, like when an envelope node (for example)
 // is written and then the envelope is later removed, the dict will still
 // contain the envelope name, but that's not a problem.
 
-NameMap ProjectSerializer::mNames;
-MemoryStream ProjectSerializer::mDict;
+static const std::shared_ptr<ProjectSerializer::Dictionary> &GlobalDictionary()
+{
+   static const auto pDictionary =
+      std::make_shared<ProjectSerializer::Dictionary>();
+   return pDictionary;
+}
 
 TranslatableString ProjectSerializer::FailureMessage( const FilePath &/*filePath*/ )
 {
@@ -141,19 +146,53 @@ template <typename Number> void WriteBigEndian(MemoryStream& out, Number value)
    out.AppendData(&value, sizeof(value));
 }
 
+//! Reads the fields of a document in place, checking bounds
+class DocumentCursor final
+{
+public:
+   //! Thrown when reading past the end
+   struct Error{};
+
+   DocumentCursor(const char *begin, size_t size)
+      : mNext{ begin }, mEnd{ begin + size }
+   {}
+
+   bool Eof() const { return mNext == mEnd; }
+
+   std::string_view Bytes(size_t count)
+   {
+      if (static_cast<size_t>(mEnd - mNext) < count)
+         throw Error{};
+      const std::string_view result{ mNext, count };
+      mNext += count;
+      return result;
+   }
+
+   unsigned char Byte() { return Bytes(1)[0]; }
+
+   //! Read a value as it was written, with no change of byte order
+   template <typename Number> Number ReadNative()
+   {
+      Number result;
+      std::memcpy(&result, Bytes(sizeof(result)).data(), sizeof(result));
+      return result;
+   }
+
+private:
+   const char *mNext;
+   const char *const mEnd;
+};
+
 // Read little-endian file format to native little-endian
-template <typename Number> Number ReadLittleEndian(BufferedStreamReader& in)
+template <typename Number> Number ReadLittleEndian(DocumentCursor& in)
 {
-   Number result;
-   in.ReadValue(result);
-   return result;
+   return in.ReadNative<Number>();
 }
 
 // Read little-endian file format to native big-endian
-template <typename Number> Number ReadBigEndian(BufferedStreamReader& in)
+template <typename Number> Number ReadBigEndian(DocumentCursor& in)
 {
-   Number result;
-   in.ReadValue(result);
+   auto result = in.ReadNative<Number>();
    auto begin = static_cast<unsigned char*>(static_cast<void*>(&result));
    std::reverse(begin, begin + sizeof(result));
    return result;
@@ -196,8 +235,10 @@ static const auto ReadDigits = ReadInt;
 class XMLTagHandlerAdapter final
 {
 public:
-   explicit XMLTagHandlerAdapter(XMLTagHandler* handler) noexcept
+   XMLTagHandlerAdapter(XMLTagHandler* handler,
+      ProjectSerializer::DecodeProfile* pProfile) noexcept
        : mBaseHandler(handler)
+       , mpProfile(pProfile)
    {
    }
 
@@ -216,19 +257,22 @@ public:
          EmitStartTag();
 
       if (XMLTagHandler* const handler = mHandlers.back())
+      {
+         HandlerTimer timer{ mpProfile };
          handler->HandleXMLEndTag(name);
+      }
 
       mHandlers.pop_back();
    }
 
-   void WriteAttr(const std::string_view& name, std::string value)
+   void WriteAttr(const std::string_view& name, std::string_view value)
    {
       assert(mInTag);
 
       if (!mInTag)
          return;
 
-      mAttributes.emplace_back(name, CacheString(std::move(value)));
+      mAttributes.emplace_back(name, XMLAttributeValueView(value));
    }
 
    template <typename T> void WriteAttr(const std::string_view& name, T value)
@@ -241,21 +285,25 @@ public:
       mAttributes.emplace_back(name, XMLAttributeValueView(value));
    }
 
-   void WriteData(std::string value)
+   void WriteData(std::string_view value)
    {
       if (mInTag)
          EmitStartTag();
 
       if (XMLTagHandler* const handler = mHandlers.back())
-         handler->HandleXMLContent(CacheString(std::move(value)));
+      {
+         HandlerTimer timer{ mpProfile };
+         handler->HandleXMLContent(value);
+      }
    }
 
-   void WriteRaw(std::string)
+   //! Storage for a converted string, valid until the next tag is emitted
+   std::string& NewString()
    {
-      // This method is intentionally left empty.
-      // The only data that is serialized by FT_Raw
-      // is the boilerplate code like <?xml > and <!DOCTYPE>
-      // which are ignored
+      // A deque, so that earlier strings do not move
+      if (mUsedStrings == mStrings.size())
+         mStrings.emplace_back();
+      return mStrings[mUsedStrings++];
    }
 
    bool Finalize()
@@ -270,8 +318,37 @@ public:
    }
 
 private:
+   //! Adds the time of a callback to the profile, if there is one
+   class HandlerTimer final
+   {
+   public:
+      explicit HandlerTimer(ProjectSerializer::DecodeProfile* pProfile)
+         : mpProfile{ pProfile }
+      {
+         if (mpProfile)
+            mStart = std::chrono::steady_clock::now();
+      }
+      ~HandlerTimer()
+      {
+         if (mpProfile)
+            mpProfile->handlerTime +=
+               std::chrono::steady_clock::now() - mStart;
+      }
+
+   private:
+      ProjectSerializer::DecodeProfile* const mpProfile;
+      std::chrono::steady_clock::time_point mStart;
+   };
+
    void EmitStartTag()
    {
+      HandlerTimer timer{ mpProfile };
+      if (mpProfile)
+      {
+         ++mpProfile->tags;
+         mpProfile->attributes += mAttributes.size();
+      }
+
       if (mHandlers.empty())
       {
          mHandlers.push_back(mBaseHandler);
@@ -295,71 +372,75 @@ private:
          }
       }
 
-      mStringsCache.clear();
+      mUsedStrings = 0;
       mAttributes.clear();
       mInTag = false;
    }
 
-   std::string_view CacheString(std::string string)
-   {
-      mStringsCache.emplace_back(std::move(string));
-      return mStringsCache.back();
-   }
-
    XMLTagHandler* mBaseHandler;
+   ProjectSerializer::DecodeProfile* const mpProfile;
 
    std::vector<XMLTagHandler*> mHandlers;
 
    std::string_view mCurrentTagName;
 
-   std::deque<std::string> mStringsCache;
+   //! Strings keep their capacity when reused for later tags
+   std::deque<std::string> mStrings;
+   size_t mUsedStrings { 0 };
    AttributesList mAttributes;
 
    bool mInTag { false };
 };
 
-// template<typename BaseCharType>
-// std::string FastStringConvertFromAscii(const BaseCharType* begin, const BaseCharType* end)
-// {
-// 
-// }
-
+//! Convert a string of UTF-16 or UTF-32 to UTF-8
+/*! `bytes` need not be aligned for BaseCharType */
 template<typename BaseCharType>
-std::string FastStringConvert(const void* bytes, int bytesCount)
+void FastStringConvert(std::string_view bytes, std::string& out)
 {
-   constexpr int charSize = sizeof(BaseCharType);
-
-   assert(bytesCount % charSize == 0);
-
-   const auto begin = static_cast<const BaseCharType*>(bytes);
-   const auto end = begin + bytesCount / charSize;
+   constexpr size_t charSize = sizeof(BaseCharType);
 
-   const bool isAscii = std::all_of(
-      begin, end,
-      [](BaseCharType c)
-      { return static_cast<std::make_unsigned_t<BaseCharType>>(c) < 0x7f; });
+   assert(bytes.size() % charSize == 0);
+   const auto count = bytes.size() / charSize;
 
-   if (isAscii)
-      return std::string(begin, end);
-   
-   return std::wstring_convert<std::codecvt_utf8<BaseCharType>, BaseCharType>()
-      .to_bytes(begin, end);
+   // Most strings in projects are ASCII
+   out.resize(count);
+   for (size_t ii = 0; ii < count; ++ii)
+   {
+      BaseCharType c;
+      std::memcpy(&c, bytes.data() + ii * charSize, charSize);
+      if (static_cast<std::make_unsigned_t<BaseCharType>>(c) >= 0x80)
+      {
+         std::basic_string<BaseCharType> wide(count, 0);
+         std::memcpy(wide.data(), bytes.data(), count * charSize);
+         out = std::wstring_convert<
+            std::codecvt_utf8<BaseCharType>, BaseCharType>()
+               .to_bytes(wide.data(), wide.data() + count);
+         return;
+      }
+      out[ii] = static_cast<char>(c);
+   }
 }
 } // namespace
 
+ProjectSerializer::Dictionary::Dictionary()
+{
+   // Store header information in the dictionary that will be written into
+   // each project that is saved.
+   // Store the size of "wxStringCharType" so we can convert during recovery
+   // in case the file is used on a system with a different character size.
+   char size = sizeof(wxStringCharType);
+   data.AppendByte(FT_CharSize);
+   data.AppendData(&size, 1);
+}
+
 ProjectSerializer::ProjectSerializer(size_t allocSize)
+   : ProjectSerializer{ GlobalDictionary() }
 {
-   static std::once_flag flag;
-   std::call_once(flag, []{
-      // Just once per run, store header information in the unique static
-      // dictionary that will be written into each project that is saved.
-      // Store the size of "wxStringCharType" so we can convert during recovery
-      // in case the file is used on a system with a different character size.
-      char size = sizeof(wxStringCharType);
-      mDict.AppendByte(FT_CharSize);
-      mDict.AppendData(&size, 1);
-   });
+}
 
+ProjectSerializer::ProjectSerializer(std::shared_ptr<Dictionary> pDictionary)
+   : mpDictionary{ std::move(pDictionary) }
+{
    mDictChanged = false;
 }
 
@@ -474,24 +555,26 @@ void ProjectSerializer::WriteName(const wxString & name)
    wxASSERT(name.length() * sizeof(wxStringCharType) <= SHRT_MAX);
    UShort id;
 
-   auto nameiter = mNames.find(name);
-   if (nameiter != mNames.end())
+   auto &names = mpDictionary->names;
+   auto nameiter = names.find(name);
+   if (nameiter != names.end())
    {
       id = nameiter->second;
    }
    else
    {
-      // mNames is static.  This appends each name to static mDict only once
-      // in each run.
+      // The dictionary outlives this serializer.  This appends each name to
+      // it only once.
       UShort len = name.length() * sizeof(wxStringCharType);
 
-      id = mNames.size();
-      mNames[name] = id;
+      id = names.size();
+      names[name] = id;
 
-      mDict.AppendByte(FT_Name);
-      WriteUShort( mDict, id );
-      WriteUShort( mDict, len );
-      mDict.AppendData(name.wx_str(), len);
+      auto &dict = mpDictionary->data;
+      dict.AppendByte(FT_Name);
+      WriteUShort( dict, id );
+      WriteUShort( dict, len );
+      dict.AppendData(name.wx_str(), len);
 
       mDictChanged = true;
    }
@@ -499,9 +582,18 @@ void ProjectSerializer::WriteName(const wxString & name)
    WriteUShort( mBuffer, id );
 }
 
+void ProjectSerializer::Append(const ProjectSerializer &other)
+{
+   assert(other.mpDictionary == mpDictionary);
+   // The encoding keeps no state between tags, so documents concatenate
+   for (const auto chunk : other.mBuffer)
+      mBuffer.AppendData(chunk.first, chunk.second);
+   mDictChanged = mDictChanged || other.mDictChanged;
+}
+
 const MemoryStream &ProjectSerializer::GetDict() const
 {
-   return mDict;
+   return mpDictionary->data;
 }
 
 const MemoryStream& ProjectSerializer::GetData() const
@@ -519,62 +611,93 @@ bool ProjectSerializer::DictChanged() const
    return mDictChanged;
 }
 
-// See ProjectFileIO::LoadProject() for explanation of the blockids arg
-bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
+bool ProjectSerializer::Decode(
+   BufferedStreamReader& in, XMLTagHandler* handler, DecodeProfile* pProfile)
+{
+   const auto start = std::chrono::steady_clock::now();
+
+   // Dictionary and document are read as one
+   std::vector<char> document;
+   size_t size = 0;
+   while (!in.Eof())
+   {
+      document.resize(std::max<size_t>(64 * 1024, 2 * size));
+      const auto bytesRead =
+         in.Read(document.data() + size, document.size() - size);
+      if (bytesRead == 0)
+         break;
+      size += bytesRead;
+   }
+
+   if (pProfile)
+      pProfile->readTime += std::chrono::steady_clock::now() - start;
+
+   return Decode(document.data(), size, handler, pProfile);
+}
+
+bool ProjectSerializer::Decode(const void* data, size_t size,
+   XMLTagHandler* handler, DecodeProfile* pProfile)
 {
    if (handler == nullptr)
       return false;
 
-   XMLTagHandlerAdapter adapter(handler);
+   const auto start = std::chrono::steady_clock::now();
 
-   std::vector<char> bytes;
-   IdMap mIds;
-   std::vector<IdMap> mIdStack;
-   char mCharSize = 0;
+   XMLTagHandlerAdapter adapter(handler, pProfile);
+   DocumentCursor in(static_cast<const char*>(data), size);
 
-   mIds.clear();
+   // Names indexed by id, each decoded once; a null view for ids not yet
+   // defined.  Views are of the document, or of convertedNames.
+   using Names = std::vector<std::string_view>;
+   Names names;
+   std::vector<Names> namesStack;
+   std::deque<std::string> convertedNames;
+   char charSize = 0;
 
-   struct Error{}; // exception type for short-range try/catch
-   auto Lookup = [&mIds]( UShort id ) -> std::string_view
+   using Error = DocumentCursor::Error;
+   auto Lookup = [&names]( UShort id ) -> std::string_view
    {
-      auto iter = mIds.find( id );
-      if (iter == mIds.end())
-      {
+      if (id >= names.size() || names[id].data() == nullptr)
          throw Error{};
-      }
 
-      return iter->second;
+      return names[id];
    };
 
    int64_t stringsCount = 0;
    int64_t stringsLength = 0;
 
-   auto ReadString = [&mCharSize, &in, &bytes, &stringsCount, &stringsLength](int len) -> std::string
+   // The view is valid until the next tag is emitted
+   auto ReadString = [&](int len) -> std::string_view
    {
-      bytes.reserve( len );
-      auto data = bytes.data();
-      in.Read( data, len );
+      if (len < 0)
+         throw Error{};
+      const auto bytes = in.Bytes(len);
 
       stringsCount++;
       stringsLength += len;
-      
-      switch (mCharSize)
-      {
-         case 1:
-            return std::string(bytes.data(), len);
 
+      if (charSize == 1)
+         return bytes;
+
+      auto& result = adapter.NewString();
+      switch (charSize)
+      {
          case 2:
-            return FastStringConvert<char16_t>(bytes.data(), len);
+            FastStringConvert<char16_t>(bytes, result);
+            break;
 
          case 4:
-            return FastStringConvert<char32_t>(bytes.data(), len);
+            FastStringConvert<char32_t>(bytes, result);
+            break;
 
          default:
-            wxASSERT_MSG(false, wxT("Characters size not 1, 2, or 4"));
-         break;
+            // Characters size not 1, 2, or 4
+            throw Error{};
       }
+      if (pProfile)
+         ++pProfile->convertedStrings;
 
-      return {};
+      return result;
    };
 
    try
@@ -583,19 +706,21 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
       {
          UShort id;
 
-         switch (in.GetC())
+         switch (in.Byte())
          {
             case FT_Push:
             {
-               mIdStack.push_back(mIds);
-               mIds.clear();
+               namesStack.push_back(std::move(names));
+               names.clear();
             }
             break;
 
             case FT_Pop:
             {
-               mIds = mIdStack.back();
-               mIdStack.pop_back();
+               if (namesStack.empty())
+                  throw Error{};
+               names = std::move(namesStack.back());
+               namesStack.pop_back();
             }
             break;
 
@@ -603,7 +728,13 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
             {
                id = ReadUShort( in );
                auto len = ReadUShort( in );
-               mIds[id] = ReadString(len);
+               auto name = ReadString(len);
+               if (charSize != 1)
+                  // Keep it past the next tag
+                  name = convertedNames.emplace_back(name);
+               if (id >= names.size())
+                  names.resize(id + 1);
+               names[id] = name;
             }
             break;
 
@@ -627,17 +758,15 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
             {
                id = ReadUShort( in );
                int len = ReadLength( in );
-               
+
                adapter.WriteAttr(Lookup(id), ReadString(len));
             }
             break;
 
             case FT_Float:
             {
-               float val;
-
                id = ReadUShort( in );
-               in.Read(&val, sizeof(val));
+               const auto val = in.ReadNative<float>();
                /* int dig = */ReadDigits(in);
 
                adapter.WriteAttr(Lookup(id), val);
@@ -646,10 +775,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Double:
             {
-               double val;
-
                id = ReadUShort( in );
-               in.Read(&val, sizeof(val));
+               const auto val = in.ReadNative<double>();
                /*int dig = */ReadDigits(in);
 
                adapter.WriteAttr(Lookup(id), val);
@@ -667,10 +794,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Bool:
             {
-               unsigned char val;
-
                id = ReadUShort( in );
-               in.Read(&val, 1);
+               unsigned char val = in.Byte();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -711,14 +836,18 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Raw:
             {
+               // Only boilerplate like <?xml > and <!DOCTYPE> is
+               // serialized this way, and it is ignored
                int len = ReadLength( in );
-               adapter.WriteRaw(ReadString(len));
+               if (len < 0)
+                  throw Error{};
+               in.Bytes(len);
             }
             break;
 
             case FT_CharSize:
             {
-               in.Read(&mCharSize, 1);
+               charSize = in.Byte();
             }
             break;
 
@@ -730,13 +859,21 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
    }
    catch( const Error& )
    {
-      // Document was corrupt, or platform differences in size or endianness
-      // were not well canonicalized
+      // Document was corrupt or truncated, or platform differences in size
+      // or endianness were not well canonicalized
       return false;
    }
 
    wxLogInfo(
       "Loaded %lld string %f Kb in size", stringsCount, stringsLength / 1024.0);
 
-   return adapter.Finalize();
+   const auto result = adapter.Finalize();
+
+   if (pProfile)
+   {
+      pProfile->bytes += size;
+      pProfile->decodeTime += std::chrono::steady_clock::now() - start;
+   }
+
+   return result;
 }
@@ -16,6 +16,8 @@
 #include "MemoryStream.h" // member variables
 #include <wx/mstream.h>
 
+#include <chrono>
+#include <memory>
 #include <unordered_set>
 #include <unordered_map>
 
@@ -30,7 +32,6 @@ class BufferedStreamReader;
 ///
 
 using NameMap = std::unordered_map<wxString, unsigned short>;
-using IdMap = std::unordered_map<unsigned short, std::string>;
 
 // This class's overrides do NOT throw AudacityException.
 class PROJECT_FILE_IO_API ProjectSerializer final : public XMLWriter
@@ -39,7 +40,21 @@ public:
 
    static TranslatableString FailureMessage( const FilePath &filePath );
 
+   //! Assigns the 2-byte ids that replace names in the document
+   /*! One dictionary may be shared by many documents, but not by documents
+    written at the same time on different threads */
+   struct PROJECT_FILE_IO_API Dictionary final
+   {
+      Dictionary();
+
+      NameMap names;
+      MemoryStream data;
+   };
+
+   //! Use the dictionary shared by all serializers that are not given one
    ProjectSerializer(size_t allocSize = 1024 * 1024);
+   //! Use another dictionary, as when writing on another thread
+   explicit ProjectSerializer(std::shared_ptr<Dictionary> pDictionary);
    virtual ~ProjectSerializer();
 
    void StartTag(const wxString & name) override;
@@ -59,14 +74,44 @@ public:
    void WriteData(const wxString & value) override;
    void Write(const wxString & data) override;
 
+   //! Append the document written by another serializer
+   /*! It must share the dictionary, so that its names keep their ids */
+   void Append(const ProjectSerializer &other);
+
    const MemoryStream& GetDict() const;
    const MemoryStream& GetData() const;
 
    bool IsEmpty() const;
    bool DictChanged() const;
 
-   // Returns empty string if decoding fails
-   static bool Decode(BufferedStreamReader& in, XMLTagHandler* handler);
+   //! Counts and times from Decode(), for profiling the opening of projects
+   struct DecodeProfile final
+   {
+      size_t bytes{};
+      size_t tags{};
+      size_t attributes{};
+      //! Strings that were not UTF-8 already
+      size_t convertedStrings{};
+      std::chrono::nanoseconds readTime{};
+      //! Includes handlerTime
+      std::chrono::nanoseconds decodeTime{};
+      //! Time in the handler's callbacks, building the project
+      std::chrono::nanoseconds handlerTime{};
+   };
+
+   //! Decode a document in memory, without copying it
+   /*!
+    Names, and strings when the document is UTF-8, are passed to the handler
+    as views of `data`; other strings are converted into reused buffers, so no
+    view outlives the callback that receives it.
+    @return false if decoding fails
+    */
+   static bool Decode(const void *data, size_t size, XMLTagHandler* handler,
+      DecodeProfile *pProfile = nullptr);
+
+   //! Read all of `in` into memory, and decode it
+   static bool Decode(BufferedStreamReader& in, XMLTagHandler* handler,
+      DecodeProfile *pProfile = nullptr);
 
 private:
    void WriteName(const wxString& name);
@@ -75,8 +120,7 @@ private:
    MemoryStream mBuffer;
    bool mDictChanged;
 
-   static NameMap mNames;
-   static MemoryStream mDict;
+   const std::shared_ptr<Dictionary> mpDictionary;
 };
 
 #endif
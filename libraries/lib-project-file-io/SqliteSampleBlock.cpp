@@ -13,8 +13,11 @@ Paul Licameli -- split from SampleBlock.cpp and SampleBlock.h
 
 #include "BasicUI.h"
 #include "DBConnection.h"
+#include "ProjectBlockCompression.h"
 #include "ProjectFileIO.h"
+#include "SampleCodec.h"
 #include "SampleFormat.h"
+#include "SampleSummary.h"
 #include "AudioSegmentSampleView.h"
 #include "XMLTagHandler.h"
 
@@ -26,6 +29,7 @@ Paul Licameli -- split from SampleBlock.cpp and SampleBlock.h
 
 #include <wx/log.h>
 
+#include <algorithm>
 #include <mutex>
 
 class SqliteSampleBlockFactory;
@@ -78,11 +82,17 @@ public:
    MinMaxRMS DoGetMinMaxRMS() const override;
 
    size_t GetSpaceUsage() const override;
+
+   void StoreDerivedData(
+      const std::string &key, const void *data, size_t size) override;
+   std::vector<char> LoadDerivedData(const std::string &key) override;
+
    void SaveXML(XMLWriter &xmlFile) override;
 
 private:
    bool IsSilent() const { return mBlockID <= 0; }
    void Load(SampleBlockID sbid);
+   void DeleteDerivedData();
    bool GetSummary(float *dest,
                    size_t frameoffset,
                    size_t numframes,
@@ -93,7 +103,8 @@ private:
                   sqlite3_stmt *stmt,
                   sampleFormat srcformat,
                   size_t srcoffset,
-                  size_t srcbytes);
+                  size_t srcbytes,
+                  SampleCodec::Encoding encoding = SampleCodec::Encoding::Raw);
 
    enum {
       fields = 3, /* min, max, rms */
@@ -123,6 +134,9 @@ private:
    size_t mSampleBytes;
    size_t mSampleCount;
    sampleFormat mSampleFormat;
+   //! How the samples are stored; when not raw, mSampleBytes is still the
+   //! size of the decoded samples
+   SampleCodec::Encoding mEncoding{ SampleCodec::Encoding::Raw };
 
    ArrayOf<char> mSummary256;
    ArrayOf<char> mSummary64k;
@@ -140,6 +154,7 @@ private:
 // used length values
 static std::map< SampleBlockID, std::shared_ptr<SqliteSampleBlock> >
    sSilentBlocks;
+static std::mutex sSilentBlocksMutex;
 
 ///\brief Implementation of @ref SampleBlockFactory using Sqlite database
 class SqliteSampleBlockFactory final
@@ -168,6 +183,11 @@ public:
    SampleBlockPtr DoCreateFromId(
       sampleFormat srcformat, SampleBlockID id) override;
 
+   size_t DoGetSamplesBatch(const BlockRead *reads, size_t nReads,
+      samplePtr dest, sampleFormat destformat) override;
+
+   BlockPrefetcher *GetPrefetcher() override;
+
    void OnSampleBlockDtor(const SampleBlock&)
    {
       if (mSampleBlockDeletionCallback)
@@ -181,6 +201,7 @@ private:
    friend SqliteSampleBlock;
 
    AudacityProject &mProject;
+   const ProjectBlockCompression &mCompression;
    Observer::Subscription mUndoSubscription;
    std::function<void()> mSampleBlockDeletionCallback;
    const std::shared_ptr<ConnectionPtr> mppConnection;
@@ -192,10 +213,13 @@ private:
    using AllBlocksMap =
       std::map< SampleBlockID, std::weak_ptr< SqliteSampleBlock > >;
    AllBlocksMap mAllBlocks;
+   //! Blocks may be created by more than one thread, as when importing
+   std::mutex mAllBlocksMutex;
 };
 
 SqliteSampleBlockFactory::SqliteSampleBlockFactory( AudacityProject &project )
    : mProject{ project }
+   , mCompression{ ProjectBlockCompression::Get(project) }
    , mppConnection{ ConnectionPtr::Get(project).shared_from_this() }
 {
    mUndoSubscription = UndoManager::Get(project)
@@ -219,6 +243,7 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreate(
    auto sb = std::make_shared<SqliteSampleBlock>(shared_from_this());
    sb->SetSamples(src, numsamples, srcformat);
    // block id has now been assigned
+   auto lock = std::lock_guard{ mAllBlocksMutex };
    mAllBlocks[ sb->GetBlockID() ] = sb;
    return sb;
 }
@@ -226,6 +251,7 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreate(
 auto SqliteSampleBlockFactory::GetActiveBlockIDs() -> SampleBlockIDs
 {
    SampleBlockIDs result;
+   auto lock = std::lock_guard{ mAllBlocksMutex };
    for (auto end = mAllBlocks.end(), it = mAllBlocks.begin(); it != end;) {
       if (it->second.expired())
          // Tighten up the map
@@ -242,6 +268,7 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreateSilent(
    size_t numsamples, sampleFormat )
 {
    auto id = -static_cast< SampleBlockID >(numsamples);
+   auto lock = std::lock_guard{ sSilentBlocksMutex };
    auto &result = sSilentBlocks[ id ];
    if ( !result ) {
       result = std::make_shared<SqliteSampleBlock>(nullptr);
@@ -281,6 +308,7 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreateFromId(
       return DoCreateSilent(-id, floatSample);
 
    // First see if this block id was previously loaded
+   auto lock = std::lock_guard{ mAllBlocksMutex };
    auto& wb = mAllBlocks[id];
 
    if (auto block = wb.lock())
@@ -297,18 +325,166 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreateFromId(
    return ssb;
 }
 
+//! Decode samples [offset, offset + num) of a compressed block of srccount
+//! samples, padding with zeros past its end
+/*! @return false if the blob is not a valid encoding */
+static bool DecodeSamples(const void *blob, size_t blobbytes,
+   sampleFormat srcformat, size_t srccount, size_t offset, size_t num,
+   samplePtr dest, sampleFormat destformat)
+{
+   offset = std::min(offset, srccount);
+   const auto decoded = std::min(num, srccount - offset);
+   if (destformat == srcformat) {
+      if (!SampleCodec::Decode(
+         blob, blobbytes, srcformat, offset, decoded, dest))
+         return false;
+   }
+   else {
+      SampleBuffer buffer(decoded, srcformat);
+      if (!SampleCodec::Decode(
+         blob, blobbytes, srcformat, offset, decoded, buffer.ptr()))
+         return false;
+      // See comments in SqliteSampleBlock::GetBlob about dithering
+      CopySamples(buffer.ptr(), srcformat, dest, destformat, decoded);
+   }
+   ClearSamples(dest, destformat, decoded, num - decoded);
+   return true;
+}
+
+// Maximum number of blocks fetched by one query in DoGetSamplesBatch
+static constexpr int MaxBatchedBlocks = 16;
+
+// Maximum size of derived data kept in one project; more is only recomputed
+static constexpr size_t MaxDerivedDataBytes = 64 * 1024 * 1024;
+
+size_t SqliteSampleBlockFactory::DoGetSamplesBatch(const BlockRead *reads,
+   size_t nReads, samplePtr dest, sampleFormat destformat)
+{
+   const auto destSize = SAMPLE_SIZE(destformat);
+   size_t result = 0;
+
+   // Blocks of this factory that need a fetch, and where their samples go
+   SqliteSampleBlock *blocks[MaxBatchedBlocks];
+   const BlockRead *batchReads[MaxBatchedBlocks];
+   samplePtr dests[MaxBatchedBlocks];
+   bool found[MaxBatchedBlocks];
+   int nBatch = 0;
+
+   const auto flush = [&]{
+      if (nBatch == 0)
+         return;
+      if (nBatch == 1) {
+         // Not worth the wider statement
+         auto &read = *batchReads[0];
+         result += blocks[0]->DoGetSamples(dests[0], destformat,
+            read.sampleoffset, read.numsamples);
+         nBatch = 0;
+         return;
+      }
+
+      auto conn = blocks[0]->Conn();
+      // Prepare and cache statement...automatically finalized at DB close.
+      // Unbound parameters are null and match nothing.
+      sqlite3_stmt *stmt = conn->Prepare(DBConnection::GetSamplesBatch,
+         "SELECT blockid, samples FROM sampleblocks WHERE blockid IN ("
+         "?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8,"
+         "?9, ?10, ?11, ?12, ?13, ?14, ?15, ?16);");
+      static_assert(MaxBatchedBlocks == 16);
+
+      for (int ii = 0; ii < nBatch; ++ii) {
+         // Might return SQLITE_MISUSE which means it's our mistake that we
+         // violated preconditions; should return SQL_OK which is 0
+         if (sqlite3_bind_int64(stmt, ii + 1, blocks[ii]->mBlockID))
+         {
+            wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
+         }
+         found[ii] = false;
+      }
+
+      int rc;
+      bool valid = true;
+      while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+         const auto id = sqlite3_column_int64(stmt, 0);
+         auto src = (constSamplePtr) sqlite3_column_blob(stmt, 1);
+         const auto blobbytes = (size_t) sqlite3_column_bytes(stmt, 1);
+         // A block may occur more than once in the batch
+         for (int ii = 0; ii < nBatch; ++ii) {
+            auto &block = *blocks[ii];
+            if (block.mBlockID != id)
+               continue;
+            found[ii] = true;
+            auto &read = *batchReads[ii];
+            const auto srcformat = block.mSampleFormat;
+            if (block.mEncoding != SampleCodec::Encoding::Raw) {
+               valid = valid && DecodeSamples(src, blobbytes, srcformat,
+                  block.mSampleCount, read.sampleoffset, read.numsamples,
+                  dests[ii], destformat);
+               result += read.numsamples;
+               continue;
+            }
+            const auto srcSize = SAMPLE_SIZE(srcformat);
+            const auto srcoffset =
+               std::min(read.sampleoffset * srcSize, blobbytes);
+            const auto copied = std::min(
+               read.numsamples, (blobbytes - srcoffset) / srcSize);
+
+            // See comments in SqliteSampleBlock::GetBlob about dithering
+            wxASSERT(destformat == floatSample || destformat == srcformat);
+            CopySamples(src + srcoffset, srcformat,
+               dests[ii], destformat, copied);
+            ClearSamples(dests[ii], destformat,
+               copied, read.numsamples - copied);
+            result += read.numsamples;
+         }
+      }
+
+      // Clear statement bindings and rewind statement
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+
+      if (rc != SQLITE_DONE || !valid ||
+          std::find(found, found + nBatch, false) != found + nBatch)
+      {
+         wxLogDebug(wxT("SqliteSampleBlockFactory::DoGetSamplesBatch - SQLITE error %s"),
+            sqlite3_errmsg(conn->DB()));
+         conn->ThrowException( false );
+      }
+
+      nBatch = 0;
+   };
+
+   for (size_t ii = 0; ii < nReads; ++ii) {
+      const auto &read = reads[ii];
+      auto block = dynamic_cast<SqliteSampleBlock*>(read.block);
+      if (!block || block->mpFactory.get() != this || block->IsSilent())
+         // Silent, or belonging to another project
+         result += read.block->GetSamples(dest, destformat,
+            read.sampleoffset, read.numsamples);
+      else {
+         if (!block->mValid)
+            block->Load(block->mBlockID);
+         blocks[nBatch] = block;
+         batchReads[nBatch] = &read;
+         dests[nBatch] = dest;
+         if (++nBatch == MaxBatchedBlocks)
+            flush();
+      }
+      dest += read.numsamples * destSize;
+   }
+   flush();
+
+   return result;
+}
+
 BlockSampleView SqliteSampleBlock::GetFloatSampleView(bool mayThrow)
 {
    assert(mSampleCount > 0);
 
-   // Double-checked locking.
-   // `weak_ptr::lock()` guarantees atomicity, which is important to make this
-   // work without races.
-   auto cache = mCache.lock();
-   if (cache)
-      return cache;
+   // Reading mCache while another thread assigns it is a race, even though
+   // `weak_ptr::lock()` itself is atomic, so always lock; spectrogram columns
+   // are computed on several threads
    std::lock_guard<std::mutex> lock(mCacheMutex);
-   cache = mCache.lock();
+   auto cache = mCache.lock();
    if (cache)
       return cache;
 
@@ -373,6 +549,13 @@ SqliteSampleBlock::~SqliteSampleBlock()
    } );
 }
 
+BlockPrefetcher *SqliteSampleBlockFactory::GetPrefetcher()
+{
+   // The blocks read through the current connection
+   auto &pConnection = mppConnection->mpConnection;
+   return pConnection ? &pConnection->GetPrefetcher() : nullptr;
+}
+
 DBConnection *SqliteSampleBlock::Conn() const
 {
    if (!mpFactory)
@@ -422,6 +605,12 @@ size_t SqliteSampleBlock::DoGetSamples(samplePtr dest,
       return numsamples;
    }
 
+   // mEncoding is known only after loading
+   if (!mValid)
+   {
+      Load(mBlockID);
+   }
+
    // Prepare and cache statement...automatically finalized at DB close
    sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::GetSamples,
       "SELECT samples FROM sampleblocks WHERE blockid = ?1;");
@@ -431,7 +620,8 @@ size_t SqliteSampleBlock::DoGetSamples(samplePtr dest,
                   stmt,
                   mSampleFormat,
                   sampleoffset * SAMPLE_SIZE(mSampleFormat),
-                  numsamples * SAMPLE_SIZE(mSampleFormat)) / SAMPLE_SIZE(mSampleFormat);
+                  numsamples * SAMPLE_SIZE(mSampleFormat),
+                  mEncoding) / SAMPLE_SIZE(mSampleFormat);
 }
 
 void SqliteSampleBlock::SetSamples(constSamplePtr src,
@@ -519,9 +709,7 @@ MinMaxRMS SqliteSampleBlock::DoGetMinMaxRMS(size_t start, size_t len)
    if (IsSilent())
       return {};
 
-   float min = FLT_MAX;
-   float max = -FLT_MAX;
-   float sumsq = 0;
+   SampleSummary::Result summary{ FLT_MAX, -FLT_MAX, 0.0 };
 
    if (!mValid)
    {
@@ -537,25 +725,12 @@ MinMaxRMS SqliteSampleBlock::DoGetMinMaxRMS(size_t start, size_t len)
       float *samples = (float *) blockData.ptr();
 
       size_t copied = DoGetSamples((samplePtr) samples, floatSample, start, len);
-      for (size_t i = 0; i < copied; ++i, ++samples)
-      {
-         float sample = *samples;
-
-         if (sample > max)
-         {
-            max = sample;
-         }
-
-         if (sample < min)
-         {
-            min = sample;
-         }
-
-         sumsq += (sample * sample);
-      }
+      summary = SampleSummary::Summarize(samples, copied);
    }
 
-   return { min, max, (float) sqrt(sumsq / len) };
+   // A single precision sum, divided as it always was
+   const float sumsq = summary.sumsq;
+   return { summary.min, summary.max, (float) sqrt(sumsq / len) };
 }
 
 /// Retrieves the minimum, maximum, and maximum RMS of this entire
@@ -579,7 +754,8 @@ size_t SqliteSampleBlock::GetBlob(void *dest,
                                   sqlite3_stmt *stmt,
                                   sampleFormat srcformat,
                                   size_t srcoffset,
-                                  size_t srcbytes)
+                                  size_t srcbytes,
+                                  SampleCodec::Encoding encoding)
 {
    auto db = DB();
 
@@ -627,6 +803,26 @@ size_t SqliteSampleBlock::GetBlob(void *dest,
    samplePtr src = (samplePtr) sqlite3_column_blob(stmt, 0);
    size_t blobbytes = (size_t) sqlite3_column_bytes(stmt, 0);
 
+   if (encoding != SampleCodec::Encoding::Raw)
+   {
+      const auto srcSize = SAMPLE_SIZE(srcformat);
+      const bool valid = DecodeSamples(src, blobbytes, srcformat,
+         mSampleCount, srcoffset / srcSize, srcbytes / srcSize,
+         (samplePtr) dest, destformat);
+
+      // Clear statement bindings and rewind statement
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+
+      if (!valid)
+      {
+         wxLogDebug(wxT("SqliteSampleBlock::GetBlob - invalid encoded samples"));
+         Conn()->ThrowException( false );
+      }
+
+      return srcbytes;
+   }
+
    srcoffset = std::min(srcoffset, blobbytes);
    minbytes = std::min(srcbytes, blobbytes - srcoffset);
 
@@ -701,15 +897,22 @@ void SqliteSampleBlock::Load(SampleBlockID sbid)
    mValid = false;
    mSampleCount = 0;
    mSampleBytes = 0;
+   mEncoding = SampleCodec::Encoding::Raw;
    mSumMin = FLT_MAX;
    mSumMax = -FLT_MAX;
    mSumMin = 0.0;
 
    // Prepare and cache statement...automatically finalized at DB close
-   sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::LoadSampleBlock,
-      "SELECT sampleformat, summin, summax, sumrms,"
-      "       length(samples)"
-      "  FROM sampleblocks WHERE blockid = ?1;");
+   const bool hasEncoding = Conn()->HasBlockEncoding(false);
+   sqlite3_stmt *stmt = hasEncoding
+      ? Conn()->Prepare(DBConnection::LoadEncodedSampleBlock,
+         "SELECT sampleformat, summin, summax, sumrms,"
+         "       length(samples), encoding, samplecount"
+         "  FROM sampleblocks WHERE blockid = ?1;")
+      : Conn()->Prepare(DBConnection::LoadSampleBlock,
+         "SELECT sampleformat, summin, summax, sumrms,"
+         "       length(samples)"
+         "  FROM sampleblocks WHERE blockid = ?1;");
 
    // Bind statement parameters
    // Might return SQLITE_MISUSE which means it's our mistake that we violated
@@ -742,11 +945,30 @@ void SqliteSampleBlock::Load(SampleBlockID sbid)
    mSumRms = sqlite3_column_double(stmt, 3);
    mSampleBytes = sqlite3_column_int(stmt, 4);
    mSampleCount = mSampleBytes / SAMPLE_SIZE(mSampleFormat);
+   // Null in rows of raw samples
+   const auto encoding = hasEncoding
+      ? static_cast<SampleCodec::Encoding>(sqlite3_column_int(stmt, 5))
+      : SampleCodec::Encoding::Raw;
+   if (encoding != SampleCodec::Encoding::Raw)
+   {
+      mSampleCount = sqlite3_column_int64(stmt, 6);
+      mSampleBytes = mSampleCount * SAMPLE_SIZE(mSampleFormat);
+   }
 
    // Clear statement bindings and rewind statement
    sqlite3_clear_bindings(stmt);
    sqlite3_reset(stmt);
 
+   if (encoding != SampleCodec::Encoding::Raw &&
+       encoding != SampleCodec::Encoding::FixedRice)
+   {
+      // From a later version
+      wxLogDebug(wxT("SqliteSampleBlock::Load - unknown encoding %d"),
+         static_cast<int>(encoding));
+      Conn()->ThrowException( false );
+   }
+   mEncoding = encoding;
+
    mValid = true;
 }
 
@@ -758,11 +980,26 @@ void SqliteSampleBlock::Commit(Sizes sizes)
    auto db = DB();
    int rc;
 
+   // Compress if the project asks for it and the samples allow it; the
+   // columns saying how are added to the table the first time
+   std::vector<unsigned char> encoded;
+   if (mpFactory->mCompression.IsEnabled() && Conn()->HasBlockEncoding(true))
+      encoded = SampleCodec::Encode(
+         mSamples.get(), mSampleFormat, mSampleCount);
+   const auto encoding = encoded.empty()
+      ? SampleCodec::Encoding::Raw : SampleCodec::Encoding::FixedRice;
+
    // Prepare and cache statement...automatically finalized at DB close
-   sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::InsertSampleBlock,
-      "INSERT INTO sampleblocks (sampleformat, summin, summax, sumrms,"
-      "                          summary256, summary64k, samples)"
-      "                         VALUES(?1,?2,?3,?4,?5,?6,?7);");
+   sqlite3_stmt *stmt = encoded.empty()
+      ? Conn()->Prepare(DBConnection::InsertSampleBlock,
+         "INSERT INTO sampleblocks (sampleformat, summin, summax, sumrms,"
+         "                          summary256, summary64k, samples)"
+         "                         VALUES(?1,?2,?3,?4,?5,?6,?7);")
+      : Conn()->Prepare(DBConnection::InsertEncodedSampleBlock,
+         "INSERT INTO sampleblocks (sampleformat, summin, summax, sumrms,"
+         "                          summary256, summary64k, samples,"
+         "                          encoding, samplecount)"
+         "                         VALUES(?1,?2,?3,?4,?5,?6,?7,?8,?9);");
 
    // Bind statement parameters
    // Might return SQLITE_MISUSE which means it's our mistake that we violated
@@ -773,13 +1010,22 @@ void SqliteSampleBlock::Commit(Sizes sizes)
        sqlite3_bind_double(stmt, 4, mSumRms) ||
        sqlite3_bind_blob(stmt, 5, mSummary256.get(), mSummary256Bytes, SQLITE_STATIC) ||
        sqlite3_bind_blob(stmt, 6, mSummary64k.get(), mSummary64kBytes, SQLITE_STATIC) ||
-       sqlite3_bind_blob(stmt, 7, mSamples.get(), mSampleBytes, SQLITE_STATIC))
+       (encoded.empty()
+          ? sqlite3_bind_blob(stmt, 7, mSamples.get(), mSampleBytes, SQLITE_STATIC)
+          : (sqlite3_bind_blob(stmt, 7, encoded.data(), encoded.size(), SQLITE_STATIC) ||
+             sqlite3_bind_int(stmt, 8, static_cast<int>(encoding)) ||
+             sqlite3_bind_int64(stmt, 9, mSampleCount))))
    {
       wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
    }
 
-   // Execute the statement
+   // Execute the statement, and retrieve the new row id before another
+   // thread inserts into the same connection
+   sqlite3_mutex_enter(sqlite3_db_mutex(db));
    rc = sqlite3_step(stmt);
+   if (rc == SQLITE_DONE)
+      mBlockID = sqlite3_last_insert_rowid(db);
+   sqlite3_mutex_leave(sqlite3_db_mutex(db));
    if (rc != SQLITE_DONE)
    {
       wxLogDebug(wxT("SqliteSampleBlock::Commit - SQLITE error %s"), sqlite3_errmsg(db));
@@ -793,8 +1039,7 @@ void SqliteSampleBlock::Commit(Sizes sizes)
       Conn()->ThrowException( true );
    }
 
-   // Retrieve returned data
-   mBlockID = sqlite3_last_insert_rowid(db);
+   mEncoding = encoding;
 
    // Reset local arrays
    mSamples.reset();
@@ -849,6 +1094,112 @@ void SqliteSampleBlock::Delete()
    // Clear statement bindings and rewind statement
    sqlite3_clear_bindings(stmt);
    sqlite3_reset(stmt);
+
+   DeleteDerivedData();
+}
+
+void SqliteSampleBlock::DeleteDerivedData()
+{
+   // Failure only wastes some space until ProjectFileIO::DeleteBlocks()
+   // removes the orphaned rows; don't bother the user about it
+   GuardedCall( [this]{
+      auto conn = Conn();
+      if (!conn->HasDerivedDataTable(false))
+         return;
+
+      // Prepare and cache statement...automatically finalized at DB close
+      sqlite3_stmt *stmt = conn->Prepare(DBConnection::DeleteDerivedData,
+         "DELETE FROM derivedblockdata WHERE blockid = ?1;");
+
+      if (sqlite3_bind_int64(stmt, 1, mBlockID))
+      {
+         wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
+      }
+
+      if (sqlite3_step(stmt) != SQLITE_DONE)
+      {
+         wxLogDebug(wxT("SqliteSampleBlock::DeleteDerivedData - SQLITE error %s"),
+            sqlite3_errmsg(conn->DB()));
+      }
+      else if (sqlite3_changes(conn->DB()) > 0)
+         conn->ForgetDerivedDataSize();
+
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   }, MakeSimpleGuard(), [](AudacityException *){} );
+}
+
+void SqliteSampleBlock::StoreDerivedData(
+   const std::string &key, const void *data, size_t size)
+{
+   if (IsSilent() || !mpFactory)
+      return;
+
+   GuardedCall( [&]{
+      auto conn = Conn();
+      if (!(conn->HasDerivedDataTable(true) &&
+            conn->ReserveDerivedData(size, MaxDerivedDataBytes)))
+         return;
+
+      // Prepare and cache statement...automatically finalized at DB close
+      sqlite3_stmt *stmt = conn->Prepare(DBConnection::StoreDerivedData,
+         "INSERT OR REPLACE INTO derivedblockdata (blockid, key, data)"
+         " VALUES(?1, ?2, ?3);");
+
+      if (sqlite3_bind_int64(stmt, 1, mBlockID) ||
+          sqlite3_bind_text(stmt, 2, key.data(), key.size(), SQLITE_STATIC) ||
+          sqlite3_bind_blob(stmt, 3, data, size, SQLITE_STATIC))
+      {
+         wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
+      }
+
+      // The project may be read only; then the data is only recomputed
+      // in later sessions
+      if (sqlite3_step(stmt) != SQLITE_DONE)
+      {
+         wxLogDebug(wxT("SqliteSampleBlock::StoreDerivedData - SQLITE error %s"),
+            sqlite3_errmsg(conn->DB()));
+      }
+
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   }, MakeSimpleGuard(), [](AudacityException *){} );
+}
+
+std::vector<char> SqliteSampleBlock::LoadDerivedData(const std::string &key)
+{
+   std::vector<char> result;
+   if (IsSilent() || !mpFactory)
+      return result;
+
+   GuardedCall( [&]{
+      auto conn = Conn();
+      if (!conn->HasDerivedDataTable(false))
+         return;
+
+      // Prepare and cache statement...automatically finalized at DB close
+      sqlite3_stmt *stmt = conn->Prepare(DBConnection::LoadDerivedData,
+         "SELECT data FROM derivedblockdata WHERE blockid = ?1 AND key = ?2;");
+
+      if (sqlite3_bind_int64(stmt, 1, mBlockID) ||
+          sqlite3_bind_text(stmt, 2, key.data(), key.size(), SQLITE_STATIC))
+      {
+         wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
+      }
+
+      if (sqlite3_step(stmt) == SQLITE_ROW)
+      {
+         auto data = static_cast<const char *>(sqlite3_column_blob(stmt, 0));
+         auto size = sqlite3_column_bytes(stmt, 0);
+         if (data && size > 0)
+            result.assign(data, data + size);
+      }
+
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   }, MakeSimpleGuard(), [](AudacityException *){} );
+
+   return result;
 }
 
 void SqliteSampleBlock::SaveXML(XMLWriter &xmlFile)
@@ -909,31 +1260,45 @@ void SqliteSampleBlock::CalcSummary(Sizes sizes)
    int sumLen = (mSampleCount + 255) / 256;
    int summaries = 256;
 
+   // Whole summaries are found with vector instructions, where available,
+   // giving the same results as the loop below
+   const int wholeLen = mSampleCount / 256;
+   SampleSummary::SummarizeWindows(samples, 256, wholeLen, summary256);
+
    for (int i = 0; i < sumLen; ++i)
    {
-      min = samples[i * 256];
-      max = samples[i * 256];
-      sumsq = min * min;
-
       int jcount = 256;
-      if (jcount > mSampleCount - i * 256)
+      if (i < wholeLen)
       {
-         jcount = mSampleCount - i * 256;
-         fraction = 1.0 - (jcount / 256.0);
+         min = summary256[i * fields];
+         max = summary256[i * fields + 1];
+         sumsq = summary256[i * fields + 2];
       }
-
-      for (int j = 1; j < jcount; ++j)
+      else
       {
-         float f1 = samples[i * 256 + j];
-         sumsq += f1 * f1;
+         min = samples[i * 256];
+         max = samples[i * 256];
+         sumsq = min * min;
 
-         if (f1 < min)
+         if (jcount > mSampleCount - i * 256)
          {
-            min = f1;
+            jcount = mSampleCount - i * 256;
+            fraction = 1.0 - (jcount / 256.0);
          }
-         else if (f1 > max)
+
+         for (int j = 1; j < jcount; ++j)
          {
-            max = f1;
+            float f1 = samples[i * 256 + j];
+            sumsq += f1 * f1;
+
+            if (f1 < min)
+            {
+               min = f1;
+            }
+            else if (f1 > max)
+            {
+               max = f1;
+            }
          }
       }
 
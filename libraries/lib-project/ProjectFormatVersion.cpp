@@ -56,3 +56,4 @@ const ProjectFormatVersion SupportedProjectFormatVersion = {
 const ProjectFormatVersion SupportedAudacityProjectFormatVersion = { 3, 7, 0, 0, false };
 const ProjectFormatVersion BaseProjectFormatVersion              = { 1, 3, 0, 0, true  };
 const ProjectFormatVersion BaseAudacityProjectFormatVersion      = { 3, 0, 0, 0, false };
+const ProjectFormatVersion CompressedBlocksProjectFormatVersion  = { 3, 7, 0, 1, true  };
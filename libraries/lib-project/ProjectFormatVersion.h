@@ -52,3 +52,8 @@ PROJECT_API extern const ProjectFormatVersion BaseProjectFormatVersion;
 /// This is a helper constant for the "most compatible" project version created
 /// by Audacity with the value {AUD_MAJ, AUD_MIN, 0, 0}.
 PROJECT_API extern const ProjectFormatVersion BaseAudacityProjectFormatVersion;
+
+/// The version of projects that may have compressed sample blocks.  It is
+/// above SupportedAudacityProjectFormatVersion of older builds, which then
+/// refuse to open them.
+PROJECT_API extern const ProjectFormatVersion CompressedBlocksProjectFormatVersion;
@@ -14,9 +14,12 @@
 #include <memory>
 #include "Project.h"
 
+#include <algorithm>
 #include <atomic>
 #include <wx/time.h>
 
+#include "concurrency/ThreadPool.h"
+
 static const AttachedProjectObjects::RegisteredFactory manager
 {
    [](AudacityProject &project)
@@ -177,6 +180,42 @@ size_t RealtimeEffectManager::Process(bool suspended,
    return totalDiscardable;
 }
 
+// This will be called in a thread other than the main GUI thread.
+//
+void RealtimeEffectManager::ProcessGroups(bool suspended,
+   audacity::concurrency::ThreadPool &pool,
+   RealtimeEffects::GroupTask *tasks, size_t nTasks,
+   const RealtimeEffects::WorkerScratch *workerScratch,
+   unsigned nBuffers)
+{
+   if (suspended) {
+      for (size_t i = 0; i < nTasks; ++i)
+         tasks[i].discardable = 0;
+      return;
+   }
+
+   pool.ParallelFor(nTasks, [&](size_t i, size_t worker) {
+      auto &task = tasks[i];
+      auto &scratch = workerScratch[worker];
+
+      // Are there more output device channels than channels of the group?
+      // Such as when a mono sequence is processed for stereo play?
+      // Then supply some non-null fake input buffers, because the
+      // various ProcessBlock overrides of effects may crash without it.
+      const auto buffers =
+         static_cast<float **>(alloca(nBuffers * sizeof(float *)));
+      const auto nChannels = std::min(task.nChannels, nBuffers);
+      std::copy_n(task.buffers, nChannels, buffers);
+      for (auto j = nChannels; j < nBuffers; ++j) {
+         buffers[j] = scratch.padding[j - nChannels];
+         std::fill_n(buffers[j], task.numSamples, .0f);
+      }
+
+      task.discardable = Process(false, task.group, buffers,
+         scratch.scratch, scratch.dummy, nBuffers, task.numSamples);
+   });
+}
+
 //
 // This will be called in a different thread than the main GUI thread.
 //
@@ -27,9 +27,34 @@
 class ChannelGroup;
 class EffectInstance;
 
+namespace audacity::concurrency {
+   class ThreadPool;
+}
+
 namespace RealtimeEffects {
    class InitializationScope;
    class ProcessingScope;
+
+   //! One group's share of ProcessingScope::ProcessGroups
+   struct GroupTask {
+      const ChannelGroup *group{};
+      //! The group's own channel buffers, each numSamples long
+      float *const *buffers{};
+      unsigned nChannels{};
+      size_t numSamples{};
+      //! Result: how many leading samples to discard for latency
+      size_t discardable{};
+   };
+
+   //! Buffers reserved to one worker thread of ProcessingScope::ProcessGroups
+   struct WorkerScratch {
+      //! As many as the buffers of each group, to receive effect output
+      float *const *scratch{};
+      //! Supply silent input for channels that a group lacks
+      float *const *padding{};
+      //! The single dummy output buffer
+      float *dummy{};
+   };
 }
 
 ///Posted when effect is being added or removed to/from channel group or project
@@ -153,6 +178,12 @@ private:
       const ChannelGroup *group,
       float *const *buffers, float *const *scratch, float *dummy,
       unsigned nBuffers, size_t numSamples);
+   /*! @copydoc ProcessScope::ProcessGroups */
+   void ProcessGroups(bool suspended,
+      audacity::concurrency::ThreadPool &pool,
+      RealtimeEffects::GroupTask *tasks, size_t nTasks,
+      const RealtimeEffects::WorkerScratch *workerScratch,
+      unsigned nBuffers);
    void ProcessEnd(bool suspended) noexcept;
 
    RealtimeEffectManager(const RealtimeEffectManager&) = delete;
@@ -289,6 +320,31 @@ public:
       return 0; // consider them trivially processed
    }
 
+   //! Process the effect stacks of several groups concurrently
+   /*!
+    The stacks of distinct groups share no state, so each one is processed
+    by whichever thread of `pool` claims it first.  The master stack depends
+    on all of them; process it with Process() after this returns.
+    No memory is allocated.
+
+    @param tasks their `discardable` members receive the results
+    @param workerScratch one per thread of `pool`
+    @param nBuffers how many buffers each group is processed with; groups
+       with fewer channels get silent padding
+    */
+   void ProcessGroups(audacity::concurrency::ThreadPool &pool,
+      GroupTask *tasks, size_t nTasks,
+      const WorkerScratch *workerScratch,
+      unsigned nBuffers)
+   {
+      if (const auto pProject = mwProject.lock())
+         RealtimeEffectManager::Get(*pProject).ProcessGroups(mSuspended,
+            pool, tasks, nTasks, workerScratch, nBuffers);
+      else
+         for (size_t i = 0; i < nTasks; ++i)
+            tasks[i].discardable = 0;
+   }
+
 private:
    std::weak_ptr<AudacityProject> mwProject;
    bool mSuspended{};
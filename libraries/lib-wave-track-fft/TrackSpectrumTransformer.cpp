@@ -9,12 +9,39 @@ Paul Licameli
 **********************************************************************/
 #include "TrackSpectrumTransformer.h"
 
+#include "MemoryX.h"
 #include "WaveTrack.h"
+#include "concurrency/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+
+void TrackSpectrumTransformer::SetOutputRange(
+   sampleCount skip, sampleCount count)
+{
+   mOutputStart = skip;
+   mOutputEnd = skip + count;
+}
 
 void TrackSpectrumTransformer::DoOutput(
    const float* outBuffer, size_t mStepSize)
 {
-   mOutputTrack->Append((constSamplePtr)outBuffer, floatSample, mStepSize);
+   const auto position = mOutputPosition;
+   mOutputPosition += mStepSize;
+   const auto first = std::max(position, mOutputStart);
+   const auto last = std::min(mOutputPosition, mOutputEnd);
+   if (first >= last)
+      return;
+   outBuffer += (first - position).as_size_t();
+
+   // Channels of a track share clips, which are not safe to append to
+   // from several threads at once
+   std::unique_lock<std::mutex> lock;
+   if (mpOutputMutex)
+      lock = std::unique_lock { *mpOutputMutex };
+   mOutputTrack->Append(
+      (constSamplePtr)outBuffer, floatSample, (last - first).as_size_t());
 }
 
 bool TrackSpectrumTransformer::Process(
@@ -48,6 +75,101 @@ bool TrackSpectrumTransformer::Process(
    return bLoopSuccess;
 }
 
+bool TrackSpectrumTransformer::ProcessParallel(
+   const WindowProcessor& processor, const std::vector<Job>& jobs,
+   audacity::concurrency::ThreadPool& pool,
+   const std::function<bool(const std::vector<size_t>& finished)>& poll,
+   std::chrono::milliseconds interval)
+{
+   std::map<const WaveTrack*, std::mutex> outputMutexes;
+   for (auto& job : jobs)
+   {
+      if (auto pOutput = job.transformer.mOutputTrack)
+         job.transformer.mpOutputMutex =
+            &outputMutexes[&pOutput->GetTrack()];
+   }
+   auto cleanup = finally([&] {
+      for (auto& job : jobs)
+         job.transformer.mpOutputMutex = nullptr;
+   });
+
+   std::atomic<bool> failed { false };
+   const WindowProcessor guardedProcessor =
+      [&](SpectrumTransformer& transformer) {
+         return !failed.load(std::memory_order_relaxed) &&
+                processor(transformer);
+      };
+   const auto runJob = [&](size_t ii) {
+      auto& job = jobs[ii];
+      if (failed.load(std::memory_order_relaxed) ||
+          !job.transformer.Process(
+             guardedProcessor, job.channel, job.queueLength, job.start,
+             job.len))
+      {
+         failed.store(true, std::memory_order_relaxed);
+         return false;
+      }
+      return true;
+   };
+
+   if (!poll)
+   {
+      pool.ParallelFor(jobs.size(), [&](size_t ii, size_t) { runJob(ii); });
+      return !failed.load();
+   }
+
+   std::mutex finishedMutex;
+   std::vector<size_t> finished;
+   const auto report = [&] {
+      std::vector<size_t> indices;
+      {
+         std::lock_guard lock { finishedMutex };
+         indices.swap(finished);
+      }
+      if (!failed.load() && !poll(indices))
+         failed.store(true);
+   };
+   pool.ParallelForPolling(
+      jobs.size(),
+      [&](size_t ii, size_t) {
+         if (runJob(ii))
+         {
+            std::lock_guard lock { finishedMutex };
+            finished.push_back(ii);
+         }
+      },
+      report, interval);
+   report();
+
+   return !failed.load();
+}
+
+auto TrackSpectrumTransformer::MakeSegments(
+   sampleCount len, size_t stepSize, size_t nSegments, size_t warmUpSteps,
+   size_t lookAheadSteps) -> std::vector<Segment>
+{
+   const auto total = std::max<long long>(0, len.as_long_long());
+   const long long step = std::max<size_t>(1, stepSize);
+   const auto nSteps = (total + step - 1) / step;
+   const auto count =
+      std::max<long long>(1, std::min<long long>(nSegments, nSteps));
+   const long long warmUp = warmUpSteps * step;
+   const long long lookAhead = lookAheadSteps * step;
+
+   std::vector<Segment> result;
+   result.reserve(count);
+   for (long long ii = 0; ii < count; ++ii)
+   {
+      const auto first = nSteps * ii / count * step;
+      const auto last =
+         (ii + 1 == count) ? total : nSteps * (ii + 1) / count * step;
+      const auto start = std::max(0LL, first - warmUp);
+      const auto end = std::min(total, last + lookAhead);
+      result.push_back({ start, end - start, first - start, last - first });
+   }
+   return result;
+}
+
 bool TrackSpectrumTransformer::DoFinish()
 {
    return SpectrumTransformer::DoFinish();
@@ -68,5 +190,6 @@ TrackSpectrumTransformer::~TrackSpectrumTransformer() = default;
 
 bool TrackSpectrumTransformer::DoStart()
 {
+   mOutputPosition = 0;
    return SpectrumTransformer::DoStart();
 }
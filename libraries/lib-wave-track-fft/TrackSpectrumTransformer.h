@@ -11,9 +11,19 @@ Paul Licameli
 
 #include "SpectrumTransformer.h"
 
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
 class WaveChannel;
 class WaveTrack;
 
+namespace audacity::concurrency
+{
+class ThreadPool;
+}
+
 //! Subclass of SpectrumTransformer that rewrites a track
 class WAVE_TRACK_FFT_API TrackSpectrumTransformer /* not final */ :
     public SpectrumTransformer
@@ -43,6 +53,75 @@ public:
       const WindowProcessor& processor, const WaveChannel& channel,
       size_t queueLength, sampleCount start, sampleCount len);
 
+   //! Output only part of what Process() computes
+   /*!
+    Of the output samples, which correspond one to one with the input samples
+    from the start of Process(), discard the first `skip`, then keep at most
+    `count`.  Applies to each following call of Process().
+    */
+   void SetOutputRange(sampleCount skip, sampleCount count);
+
+   //! Arguments of Process() for one transformer
+   struct Job
+   {
+      TrackSpectrumTransformer& transformer;
+      const WaveChannel& channel;
+      size_t queueLength;
+      sampleCount start;
+      sampleCount len;
+   };
+
+   //! Part of a channel that one transformer may process by itself
+   struct Segment
+   {
+      //! Offset of the first input sample from the start of the channel range
+      sampleCount start;
+      //! Number of input samples
+      sampleCount len;
+      //! Arguments for SetOutputRange()
+      sampleCount skip;
+      sampleCount keep;
+   };
+
+   //! Cut a range of `len` samples into segments, that overlap enough to be
+   //! processed independently and joined without seams
+   /*!
+    The kept outputs of the segments cover the range in order, and are divided
+    at multiples of `stepSize`, so that every transformer sees windows at the
+    same positions as one transformer processing the whole range would.  Each
+    segment also reads `warmUpSteps` steps before its kept part, to refill the
+    window queue and any state the processor carries from window to window,
+    and `lookAheadSteps` after it, for the windows that the processor examines
+    before the last kept window leaves the queue.  If these cover all the
+    windows on which the output of a window depends, the joined outputs equal
+    the output of one pass.
+    @return at most `nSegments` segments, none empty, or one if `len` is not
+    positive
+    */
+   static std::vector<Segment> MakeSegments(
+      sampleCount len, size_t stepSize, size_t nSegments, size_t warmUpSteps,
+      size_t lookAheadSteps);
+
+   //! Invokes Process() for each job, on several threads
+   /*!
+    Each transformer runs on one thread only, so results are the same as from
+    calling Process() for the jobs in turn, if the processor changes no state
+    shared among transformers.  Outputs to channels of one track are
+    serialized.  Once a job fails, the processor is not called again.
+
+    If `poll` is given, the calling thread runs no jobs, but calls it about
+    every `interval`, and once more at the end, with the indices of the jobs
+    that succeeded since the previous call, so that it can report progress and
+    consume finished outputs.  It returns false to cancel the remaining jobs.
+    @return whether all jobs succeeded and no call to `poll` returned false
+    */
+   static bool ProcessParallel(
+      const WindowProcessor& processor, const std::vector<Job>& jobs,
+      audacity::concurrency::ThreadPool& pool,
+      const std::function<bool(const std::vector<size_t>& finished)>& poll =
+         {},
+      std::chrono::milliseconds interval = std::chrono::milliseconds { 50 });
+
    //! Final flush and trimming of tail samples
    static bool PostProcess(WaveTrack& outputTrack, sampleCount len);
 
@@ -53,4 +132,10 @@ protected:
 
 private:
    WaveChannel* const mOutputTrack;
+   //! Held while appending, if other transformers output to the same track
+   std::mutex* mpOutputMutex {};
+   sampleCount mOutputStart { 0 };
+   sampleCount mOutputEnd { sampleCount::max() };
+   //! Number of samples output so far by the current Process()
+   sampleCount mOutputPosition { 0 };
 };
@@ -0,0 +1,252 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  TrackSpectrumTransformerTests.cpp
+
+**********************************************************************/
+#include "TrackSpectrumTransformer.h"
+
+#include "FFT.h"
+#include "MockSampleBlockFactory.h"
+#include "MockedAudio.h"
+#include "MockedPrefs.h"
+#include "WaveTrack.h"
+#include "concurrency/ThreadPool.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+MockedPrefs prefs;
+MockedAudio audio;
+
+constexpr double sampleRate = 44100;
+constexpr size_t windowSize = 256;
+constexpr unsigned stepsPerWindow = 4;
+constexpr size_t stepSize = windowSize / stepsPerWindow;
+constexpr size_t queueLength = 5;
+
+// Enough for a processor that looks only at the windows in the queue
+constexpr size_t warmUpSteps = stepsPerWindow + queueLength;
+constexpr size_t lookAheadSteps = stepsPerWindow + queueLength;
+
+using Processor = SpectrumTransformer::WindowProcessor;
+
+//! Changes nothing
+bool Identity(SpectrumTransformer&)
+{
+   return true;
+}
+
+//! Attenuates each bin of the window leaving the queue by the power in that
+//! bin of all the windows in the queue, as noise reduction does
+bool Neighbourhood(SpectrumTransformer& transformer)
+{
+   if (!transformer.QueueIsFull())
+      return true;
+   auto& latest = transformer.Latest();
+   const auto nBins = latest.mRealFFTs.size();
+   const auto nWindows = transformer.CurrentQueueSize();
+   for (size_t bin = 0; bin < nBins; ++bin)
+   {
+      float power = 0;
+      for (size_t ii = 0; ii < nWindows; ++ii)
+      {
+         const auto& window = transformer.Nth(ii);
+         power += window.mRealFFTs[bin] * window.mRealFFTs[bin] +
+                  window.mImagFFTs[bin] * window.mImagFFTs[bin];
+      }
+      const auto gain = 1 / (1 + power);
+      latest.mRealFFTs[bin] *= gain;
+      latest.mImagFFTs[bin] *= gain;
+   }
+   return true;
+}
+
+class Transformer final : public TrackSpectrumTransformer
+{
+public:
+   explicit Transformer(WaveChannel& output)
+       : TrackSpectrumTransformer { &output,       true,
+                                    eWinFuncHann,  eWinFuncHann,
+                                    windowSize,    stepsPerWindow,
+                                    true,          true }
+   {
+   }
+};
+
+WaveTrack::Holder MakeTrack(size_t len)
+{
+   const auto track = WaveTrack::Create(
+      std::make_shared<MockSampleBlockFactory>(), floatSample, sampleRate);
+   std::mt19937 engine { 0 };
+   std::uniform_real_distribution<float> distribution { -1.f, 1.f };
+   std::vector<float> samples(len);
+   for (auto& sample : samples)
+      sample = distribution(engine);
+   (*track->Channels().begin())
+      ->Append(reinterpret_cast<constSamplePtr>(samples.data()), floatSample,
+               len);
+   track->Flush();
+   return track;
+}
+
+std::vector<float> GetSamples(WaveTrack& track, sampleCount len)
+{
+   TrackSpectrumTransformer::PostProcess(track, len);
+   std::vector<float> result(len.as_size_t());
+   (*track.Channels().begin())->GetFloats(result.data(), 0, result.size());
+   return result;
+}
+
+//! Output of one transformer processing [start, start + len) of the track
+std::vector<float> ProcessWhole(
+   const Processor& processor, const WaveTrack& track, sampleCount start,
+   sampleCount len)
+{
+   const auto output = track.EmptyCopy();
+   Transformer transformer { **output->Channels().begin() };
+   REQUIRE(transformer.Process(
+      processor, **track.Channels().begin(), queueLength, start, len));
+   return GetSamples(*output, len);
+}
+
+//! Outputs of several transformers processing segments of the same range
+//! concurrently, joined
+std::vector<float> ProcessSegmented(
+   const Processor& processor, const WaveTrack& track, sampleCount start,
+   sampleCount len, size_t nSegments, bool polling = false)
+{
+   const auto segments = TrackSpectrumTransformer::MakeSegments(
+      len, stepSize, nSegments, warmUpSteps, lookAheadSteps);
+   REQUIRE(!segments.empty());
+   REQUIRE(segments.size() <= nSegments);
+
+   std::vector<WaveTrack::Holder> outputs;
+   std::vector<std::unique_ptr<Transformer>> transformers;
+   std::vector<TrackSpectrumTransformer::Job> jobs;
+   sampleCount covered = 0;
+   for (const auto& segment : segments)
+   {
+      // The kept parts cover the range in order, divided at steps
+      REQUIRE(segment.start + segment.skip == covered);
+      REQUIRE(segment.skip + segment.keep <= segment.len);
+      REQUIRE((covered % stepSize) == 0);
+      covered += segment.keep;
+
+      outputs.push_back(track.EmptyCopy());
+      transformers.push_back(
+         std::make_unique<Transformer>(**outputs.back()->Channels().begin()));
+      transformers.back()->SetOutputRange(segment.skip, segment.keep);
+      jobs.push_back({ *transformers.back(), **track.Channels().begin(),
+                       queueLength, start + segment.start, segment.len });
+   }
+   REQUIRE(covered == len);
+
+   audacity::concurrency::ThreadPool pool { 2 };
+   if (!polling)
+      REQUIRE(TrackSpectrumTransformer::ProcessParallel(processor, jobs, pool));
+   else
+   {
+      // Each job is reported finished exactly once
+      std::vector<size_t> finished;
+      REQUIRE(TrackSpectrumTransformer::ProcessParallel(
+         processor, jobs, pool,
+         [&](const std::vector<size_t>& indices) {
+            finished.insert(finished.end(), indices.begin(), indices.end());
+            return true;
+         },
+         std::chrono::milliseconds { 1 }));
+      std::sort(finished.begin(), finished.end());
+      REQUIRE(finished.size() == jobs.size());
+      for (size_t ii = 0; ii < finished.size(); ++ii)
+         REQUIRE(finished[ii] == ii);
+   }
+
+   std::vector<float> result;
+   for (size_t ii = 0; ii < segments.size(); ++ii)
+   {
+      const auto samples = GetSamples(*outputs[ii], segments[ii].keep);
+      result.insert(result.end(), samples.begin(), samples.end());
+   }
+   return result;
+}
+} // namespace
+
+TEST_CASE("TrackSpectrumTransformer segments")
+{
+   const std::vector<Processor> processors { Identity, Neighbourhood };
+
+   SECTION("join without seams")
+   {
+      const auto track = MakeTrack(30000);
+      // A range neither starting nor ending at a step
+      const sampleCount start = 1001, len = 25003;
+      for (const auto& processor : processors)
+      {
+         const auto whole = ProcessWhole(processor, *track, start, len);
+         for (const size_t nSegments : { 2, 3, 7, 40 })
+            REQUIRE(
+               ProcessSegmented(processor, *track, start, len, nSegments) ==
+               whole);
+      }
+   }
+
+   SECTION("join without seams when polled")
+   {
+      const auto track = MakeTrack(30000);
+      const sampleCount start = 1001, len = 25003;
+      for (const auto& processor : processors)
+      {
+         const auto whole = ProcessWhole(processor, *track, start, len);
+         for (const size_t nSegments : { 1, 3, 40 })
+            REQUIRE(
+               ProcessSegmented(
+                  processor, *track, start, len, nSegments, true) == whole);
+      }
+   }
+
+   SECTION("stop when the poll cancels")
+   {
+      const auto track = MakeTrack(300000);
+      const auto output = track->EmptyCopy();
+      std::vector<std::unique_ptr<Transformer>> transformers;
+      std::vector<TrackSpectrumTransformer::Job> jobs;
+      for (size_t ii = 0; ii < 8; ++ii)
+      {
+         transformers.push_back(
+            std::make_unique<Transformer>(**output->Channels().begin()));
+         jobs.push_back({ *transformers.back(), **track->Channels().begin(),
+                          queueLength, 0, 300000 });
+      }
+      audacity::concurrency::ThreadPool pool { 2 };
+      size_t nPolls = 0;
+      REQUIRE(!TrackSpectrumTransformer::ProcessParallel(
+         Neighbourhood, jobs, pool,
+         [&](const std::vector<size_t>&) { return ++nPolls < 2; },
+         std::chrono::milliseconds { 1 }));
+      REQUIRE(nPolls == 2);
+   }
+
+   SECTION("handle short ranges")
+   {
+      const auto track = MakeTrack(2000);
+      for (const auto& processor : processors)
+         for (const size_t len :
+              { size_t { 1 }, size_t { 10 }, stepSize, stepSize + 1,
+                windowSize, windowSize + 1, 3 * windowSize })
+         {
+            const auto whole = ProcessWhole(processor, *track, 0, len);
+            for (const size_t nSegments : { 1, 2, 4 })
+               REQUIRE(
+                  ProcessSegmented(processor, *track, 0, len, nSegments) ==
+                  whole);
+         }
+   }
+}
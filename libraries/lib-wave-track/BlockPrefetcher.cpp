@@ -0,0 +1,181 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+BlockPrefetcher.cpp
+
+**********************************************************************/
+
+#include "BlockPrefetcher.h"
+#include "BasicUI.h"
+#include "SampleBlockCache.h"
+#include "Sequence.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+// Don't let requests pile up faster than they can be served
+constexpr size_t MaxQueued = 256;
+}
+
+IntSetting BlockPrefetchDistance{ L"/Sequence/PrefetchBlocks", 2 };
+
+std::atomic<size_t> BlockPrefetcher::sDistance{
+   static_cast<size_t>(BlockPrefetchDistance.GetDefault()) };
+
+BlockPrefetcher::BlockPrefetcher()
+   : mSlots{ std::make_unique<Slot[]>(MaxQueued) }
+   , mpReleased{ std::make_shared<Released>() }
+{
+   for (size_t ii = 0; ii < MaxQueued; ++ii)
+      mSlots[ii].sequence.store(ii, std::memory_order_relaxed);
+   mThread = std::thread{ [this]{ ThreadFunc(); } };
+}
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+   Stop();
+}
+
+void BlockPrefetcher::SetDistance(size_t nBlocks)
+{
+   sDistance.store(nBlocks, std::memory_order_relaxed);
+}
+
+size_t BlockPrefetcher::GetDistance()
+{
+   return sDistance.load(std::memory_order_relaxed);
+}
+
+void BlockPrefetcher::Request(const BlockArray &blocks, size_t first)
+{
+   const auto last = std::min(blocks.size(), first + GetDistance());
+   if (first >= last || mStop.load(std::memory_order_relaxed))
+      return;
+
+   // Blocks already cached or queued are skipped by the loading thread
+   bool added = false;
+   for (auto ii = first; ii < last; ++ii) {
+      const auto &sb = blocks[ii].sb;
+      if (sb && Push(sb))
+         added = true;
+   }
+   if (added) {
+      mPending.store(true);
+      // Not holding the mutex, so the wakeup may rarely be missed; the
+      // loading thread also wakes up periodically
+      mCondition.notify_one();
+   }
+}
+
+void BlockPrefetcher::Stop()
+{
+   {
+      auto lock = std::lock_guard{ mMutex };
+      mStop.store(true);
+   }
+   mCondition.notify_one();
+   if (mThread.joinable())
+      mThread.join();
+
+   std::weak_ptr<SampleBlock> wBlock;
+   while (Pop(wBlock))
+      ;
+   ReleaseBlocks(*mpReleased);
+}
+
+bool BlockPrefetcher::Push(const std::shared_ptr<SampleBlock> &pBlock)
+{
+   auto position = mPushPosition.load(std::memory_order_relaxed);
+   while (true) {
+      auto &slot = mSlots[position % MaxQueued];
+      const auto sequence = slot.sequence.load(std::memory_order_acquire);
+      const auto difference =
+         static_cast<long long>(sequence) - static_cast<long long>(position);
+      if (difference == 0) {
+         // The slot is free in this lap; claim it
+         if (mPushPosition.compare_exchange_weak(
+            position, position + 1, std::memory_order_relaxed)) {
+            slot.wBlock = pBlock;
+            slot.sequence.store(position + 1, std::memory_order_release);
+            return true;
+         }
+      }
+      else if (difference < 0)
+         // Not yet read in the previous lap: full
+         return false;
+      else
+         position = mPushPosition.load(std::memory_order_relaxed);
+   }
+}
+
+bool BlockPrefetcher::Pop(std::weak_ptr<SampleBlock> &wBlock)
+{
+   const auto position = mPopPosition.load(std::memory_order_relaxed);
+   auto &slot = mSlots[position % MaxQueued];
+   if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+      return false;
+   mPopPosition.store(position + 1, std::memory_order_relaxed);
+   // Leave the slot empty, so that the next writer destroys nothing
+   wBlock = std::move(slot.wBlock);
+   slot.sequence.store(position + MaxQueued, std::memory_order_release);
+   return true;
+}
+
+void BlockPrefetcher::Release(std::shared_ptr<SampleBlock> pBlock)
+{
+   auto &released = *mpReleased;
+   bool first = false;
+   {
+      auto lock = std::lock_guard{ released.mutex };
+      first = released.blocks.empty();
+      released.blocks.push_back(std::move(pBlock));
+   }
+   if (first)
+      BasicUI::CallAfter([pReleased = mpReleased]{
+         ReleaseBlocks(*pReleased);
+      });
+}
+
+void BlockPrefetcher::ReleaseBlocks(Released &released)
+{
+   std::vector<std::shared_ptr<SampleBlock>> blocks;
+   {
+      auto lock = std::lock_guard{ released.mutex };
+      blocks.swap(released.blocks);
+   }
+   // Blocks that nothing else holds are destroyed here
+}
+
+void BlockPrefetcher::ThreadFunc()
+{
+   using namespace std::chrono;
+   auto &cache = SampleBlockCache::Get();
+   while (true) {
+      {
+         auto lock = std::unique_lock{ mMutex };
+         mCondition.wait_for(lock, 50ms, [this]{
+            return mStop.load() || mPending.load(); });
+         if (mStop.load())
+            return;
+      }
+      mPending.store(false);
+
+      std::weak_ptr<SampleBlock> wBlock;
+      while (!mStop.load(std::memory_order_relaxed) && Pop(wBlock)) {
+         // Hold the block while it loads, so that its address stays valid
+         auto pBlock = wBlock.lock();
+         wBlock.reset();
+         if (!pBlock)
+            continue;
+         try {
+            cache.Load(*pBlock);
+         }
+         catch (...) {
+            // The reader will meet the same error, and report it
+         }
+         Release(std::move(pBlock));
+      }
+   }
+}
@@ -0,0 +1,110 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+BlockPrefetcher.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_PREFETCHER__
+#define __AUDACITY_BLOCK_PREFETCHER__
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MemoryX.h"
+#include "Prefs.h"
+
+class BlockArray;
+class SampleBlock;
+
+///\brief Loads sample blocks into SampleBlockCache on a background thread
+/*!
+ Sequence::Get() requests the blocks that follow those it has just read, so
+ that sequential reads, as in playback and export, seldom wait for storage.
+
+ There is one prefetcher for each connection to storage, which the
+ SampleBlockFactory supplies; its thread must be stopped before the
+ connection closes.  Requests take no lock, so that the threads that
+ fill playback buffers never wait for the loading thread.  Blocks are
+ released on the main thread, so that the loading thread never destroys
+ the last reference to a block, which would delete its storage.
+ */
+class WAVE_TRACK_API BlockPrefetcher final
+{
+public:
+   BlockPrefetcher();
+   ~BlockPrefetcher();
+
+   BlockPrefetcher(const BlockPrefetcher&) = delete;
+   BlockPrefetcher &operator=(const BlockPrefetcher&) = delete;
+
+   //! Number of blocks to read ahead of the position of each request, for
+   //! all prefetchers
+   /*! Zero disables prefetching */
+   static void SetDistance(size_t nBlocks);
+   static size_t GetDistance();
+
+   //! Queue the blocks from `first` up to the distance
+   /*!
+    Lock-free, and may be called from any thread.  Requests are dropped while
+    the queue is full.
+    */
+   void Request(const BlockArray &blocks, size_t first);
+
+   //! Join the thread and release loaded blocks; later requests are ignored
+   /*! Call on the main thread */
+   void Stop();
+
+private:
+   void ThreadFunc();
+
+   //! Add to the queue, or return false if it is full
+   bool Push(const std::shared_ptr<SampleBlock> &pBlock);
+   //! Take from the queue, or return false if it is empty; only the loading
+   //! thread calls this
+   bool Pop(std::weak_ptr<SampleBlock> &wBlock);
+
+   //! Blocks that the loading thread is done with
+   struct Released {
+      std::mutex mutex;
+      std::vector<std::shared_ptr<SampleBlock>> blocks;
+   };
+   //! Called on the loading thread
+   void Release(std::shared_ptr<SampleBlock> pBlock);
+   //! Called on the main thread
+   static void ReleaseBlocks(Released &released);
+
+   static std::atomic<size_t> sDistance;
+
+   //! Bounded queue, for many producers and one consumer
+   struct Slot {
+      //! Tells whether the slot may be written or read, in each lap of the
+      //! positions around the queue
+      std::atomic<size_t> sequence;
+      std::weak_ptr<SampleBlock> wBlock;
+   };
+   const std::unique_ptr<Slot[]> mSlots;
+   NonInterfering<std::atomic<size_t>> mPushPosition{ 0 };
+   NonInterfering<std::atomic<size_t>> mPopPosition{ 0 };
+
+   //! Set after pushing, so the loading thread need not poll the queue
+   std::atomic<bool> mPending{ false };
+   std::atomic<bool> mStop{ false };
+
+   //! Shared with actions pending on the main thread
+   const std::shared_ptr<Released> mpReleased;
+
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+   std::thread mThread;
+};
+
+//! Number of blocks read ahead; applied with BlockPrefetcher::SetDistance()
+extern WAVE_TRACK_API IntSetting BlockPrefetchDistance;
+
+#endif
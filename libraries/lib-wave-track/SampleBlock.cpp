@@ -9,6 +9,7 @@ SampleBlock.cpp
 
 #include "InconsistencyException.h"
 #include "SampleBlock.h"
+#include "SampleBlockCache.h"
 #include "SampleFormat.h"
 
 #include <wx/defs.h>
@@ -66,14 +67,89 @@ SampleBlockPtr SampleBlockFactory::CreateFromId(
    return result;
 }
 
-SampleBlock::~SampleBlock() = default;
+size_t SampleBlockFactory::GetSamplesBatch(const BlockRead *reads,
+   size_t nReads, samplePtr dest, sampleFormat destformat, bool mayThrow)
+{
+   try{
+      auto &cache = SampleBlockCache::Get();
+      const auto sampleSize = SAMPLE_SIZE(destformat);
+      size_t result = 0;
+      // Serve the cached blocks, and pass each run of the others to the
+      // override
+      size_t first = 0;
+      auto runDest = dest;
+      auto readDest = dest;
+      for (size_t ii = 0; ii < nReads; ++ii) {
+         const auto &read = reads[ii];
+         const auto nextDest = readDest + read.numsamples * sampleSize;
+         if (cache.Fetch(*read.block, readDest, destformat,
+            read.sampleoffset, read.numsamples)) {
+            if (first < ii)
+               result += DoGetSamplesBatch(
+                  reads + first, ii - first, runDest, destformat);
+            result += read.numsamples;
+            first = ii + 1;
+            runDest = nextDest;
+         }
+         readDest = nextDest;
+      }
+      if (first < nReads)
+         result += DoGetSamplesBatch(
+            reads + first, nReads - first, runDest, destformat);
+      return result;
+   }
+   catch( ... ) {
+      if( mayThrow )
+         throw;
+      size_t total = 0;
+      for (size_t ii = 0; ii < nReads; ++ii)
+         total += reads[ii].numsamples;
+      ClearSamples( dest, destformat, 0, total );
+      return 0;
+   }
+}
+
+size_t SampleBlockFactory::DoGetSamplesBatch(const BlockRead *reads,
+   size_t nReads, samplePtr dest, sampleFormat destformat)
+{
+   size_t result = 0;
+   for (size_t ii = 0; ii < nReads; ++ii) {
+      const auto &read = reads[ii];
+      result += read.block->GetSamples(dest, destformat,
+         read.sampleoffset, read.numsamples);
+      dest += read.numsamples * SAMPLE_SIZE(destformat);
+   }
+   return result;
+}
+
+BlockPrefetcher *SampleBlockFactory::GetPrefetcher()
+{
+   return nullptr;
+}
+
+SampleBlock::~SampleBlock()
+{
+   SampleBlockCache::Get().Erase(*this);
+}
+
+void SampleBlock::StoreDerivedData(const std::string &, const void *, size_t)
+{
+}
+
+std::vector<char> SampleBlock::LoadDerivedData(const std::string &)
+{
+   return {};
+}
 
 size_t SampleBlock::GetSamples(samplePtr dest,
                    sampleFormat destformat,
                    size_t sampleoffset,
                    size_t numsamples, bool mayThrow)
 {
-   try{ return DoGetSamples(dest, destformat, sampleoffset, numsamples); }
+   try{
+      return SampleBlockCache::Get()
+         .GetSamples(*this, dest, destformat, sampleoffset, numsamples);
+   }
    catch( ... ) {
       if( mayThrow )
          throw;
@@ -15,12 +15,15 @@ SampleBlock.h
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "Observer.h"
 #include "XMLTagHandler.h"
 
 class AudacityProject;
+class BlockPrefetcher;
 class ProjectFileIO;
 class XMLWriter;
 
@@ -85,9 +88,25 @@ public:
 
    virtual size_t GetSpaceUsage() const = 0;
 
+   //! Keep data computed from the samples, such as spectra, with the block
+   /*!
+    The data may be found again by LoadDerivedData() in a later session, and
+    is discarded with the block, or sooner, as when compacting.  Storage may
+    be limited, so that only some blocks keep their data.  Non-throwing; may be called from any thread.
+    The default does nothing.
+    */
+   virtual void StoreDerivedData(
+      const std::string &key, const void *data, size_t size);
+
+   //! Non-throwing; may be called from any thread
+   /*! @return what was stored with the key, or empty if nothing was */
+   virtual std::vector<char> LoadDerivedData(const std::string &key);
+
    virtual void SaveXML(XMLWriter &xmlFile) = 0;
 
 protected:
+   friend class SampleBlockCache;
+
    virtual size_t DoGetSamples(samplePtr dest,
                      sampleFormat destformat,
                      size_t sampleoffset,
@@ -146,7 +165,33 @@ public:
    /*! @return ids of all sample blocks created by this factory and still extant */
    virtual SampleBlockIDs GetActiveBlockIDs() = 0;
 
+   //! Describes a range of samples in one block, for GetSamplesBatch()
+   struct BlockRead {
+      SampleBlock *block;
+      size_t sampleoffset;
+      size_t numsamples;
+   };
+
+   //! Reads ranges of several blocks into consecutive parts of one buffer
+   /*!
+    Has the same effect as calling SampleBlock::GetSamples() for each range in
+    turn, but the factory may fetch the blocks together, as with one query.
+    If !mayThrow and there is an error, ignores it, fills the whole buffer
+    with zeroes and returns zero.
+    @return the total number of samples read
+    */
+   size_t GetSamplesBatch(const BlockRead *reads, size_t nReads,
+      samplePtr dest, sampleFormat destformat, bool mayThrow = true);
+
+   //! Loader of blocks ahead of sequential reads, for the current storage
+   /*! Default returns null, and nothing is prefetched */
+   virtual BlockPrefetcher *GetPrefetcher();
+
 protected:
+   //! Default implementation reads the blocks one at a time
+   virtual size_t DoGetSamplesBatch(const BlockRead *reads, size_t nReads,
+      samplePtr dest, sampleFormat destformat);
+
    // The override should throw more informative exceptions on error than the
    // default InconsistencyException thrown by Create
    virtual SampleBlockPtr DoCreate(constSamplePtr src,
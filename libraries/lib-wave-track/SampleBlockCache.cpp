@@ -0,0 +1,174 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SampleBlockCache.cpp
+
+**********************************************************************/
+
+#include "SampleBlockCache.h"
+#include "SampleBlock.h"
+
+#include <algorithm>
+
+SampleBlockCache &SampleBlockCache::Get()
+{
+   // Never destroyed, because blocks held in static storage of other
+   // libraries may be destroyed after it and call Erase()
+   static auto pInstance = new SampleBlockCache;
+   return *pInstance;
+}
+
+SampleBlockCache::SampleBlockCache()
+   : mBudget{ static_cast<size_t>(SampleBlockCacheSize.GetDefault()) << 20 }
+{
+}
+
+bool SampleBlockCache::Fetch(const SampleBlock &block,
+   samplePtr dest, sampleFormat destformat,
+   size_t sampleoffset, size_t numsamples)
+{
+   auto pData = Find(block);
+   if (!pData)
+      return false;
+   Copy(*pData, dest, destformat, sampleoffset, numsamples);
+   return true;
+}
+
+size_t SampleBlockCache::GetSamples(SampleBlock &block,
+   samplePtr dest, sampleFormat destformat,
+   size_t sampleoffset, size_t numsamples)
+{
+   auto pData = Find(block);
+   if (!pData)
+      pData = DoLoad(block);
+   if (!pData)
+      // Too big to cache
+      return block.DoGetSamples(dest, destformat, sampleoffset, numsamples);
+   Copy(*pData, dest, destformat, sampleoffset, numsamples);
+   return numsamples;
+}
+
+bool SampleBlockCache::Contains(const SampleBlock &block) const
+{
+   auto lock = std::lock_guard{ mMutex };
+   return mEntries.find(&block) != mEntries.end();
+}
+
+void SampleBlockCache::Load(SampleBlock &block)
+{
+   if (!Contains(block))
+      DoLoad(block);
+}
+
+void SampleBlockCache::Erase(const SampleBlock &block) noexcept
+{
+   auto lock = std::lock_guard{ mMutex };
+   auto iter = mEntries.find(&block);
+   if (iter != mEntries.end()) {
+      mBytes -= iter->second.pData->Bytes();
+      mOrder.erase(iter->second.position);
+      mEntries.erase(iter);
+   }
+}
+
+void SampleBlockCache::Clear()
+{
+   auto lock = std::lock_guard{ mMutex };
+   mEntries.clear();
+   mOrder.clear();
+   mBytes = 0;
+}
+
+void SampleBlockCache::SetBudget(size_t bytes)
+{
+   auto lock = std::lock_guard{ mMutex };
+   mBudget = bytes;
+   Trim();
+}
+
+size_t SampleBlockCache::GetBudget() const
+{
+   auto lock = std::lock_guard{ mMutex };
+   return mBudget;
+}
+
+auto SampleBlockCache::GetStats() const -> Stats
+{
+   auto lock = std::lock_guard{ mMutex };
+   return { mHits, mMisses, mEvictions, mEntries.size(), mBytes };
+}
+
+void SampleBlockCache::ResetStats()
+{
+   auto lock = std::lock_guard{ mMutex };
+   mHits = mMisses = mEvictions = 0;
+}
+
+auto SampleBlockCache::Find(const SampleBlock &block)
+   -> std::shared_ptr<const Data>
+{
+   auto lock = std::lock_guard{ mMutex };
+   auto iter = mEntries.find(&block);
+   if (iter == mEntries.end()) {
+      ++mMisses;
+      return nullptr;
+   }
+   ++mHits;
+   auto &entry = iter->second;
+   mOrder.splice(mOrder.end(), mOrder, entry.position);
+   return entry.pData;
+}
+
+auto SampleBlockCache::DoLoad(SampleBlock &block)
+   -> std::shared_ptr<const Data>
+{
+   const auto format = block.GetSampleFormat();
+   const auto count = block.GetSampleCount();
+   if (count * SAMPLE_SIZE(format) > GetBudget())
+      return nullptr;
+
+   auto pData = std::make_shared<Data>();
+   pData->format = format;
+   pData->count = count;
+   pData->samples.Allocate(count, format);
+   // Bypass SampleBlock::GetSamples(), which would look here again
+   block.DoGetSamples(pData->samples.ptr(), format, 0, count);
+
+   auto lock = std::lock_guard{ mMutex };
+   auto [iter, inserted] = mEntries.try_emplace(&block);
+   if (!inserted)
+      // Another thread was quicker
+      return iter->second.pData;
+   mBytes += pData->Bytes();
+   iter->second.pData = pData;
+   iter->second.position = mOrder.insert(mOrder.end(), &block);
+   Trim();
+   // Return the data even if the budget shrank meanwhile and they are gone
+   return pData;
+}
+
+void SampleBlockCache::Copy(const Data &data,
+   samplePtr dest, sampleFormat destformat,
+   size_t sampleoffset, size_t numsamples)
+{
+   // Called outside of the lock; the data are immutable
+   sampleoffset = std::min(sampleoffset, data.count);
+   const auto copied = std::min(numsamples, data.count - sampleoffset);
+   CopySamples(data.samples.ptr() + sampleoffset * SAMPLE_SIZE(data.format),
+      data.format, dest, destformat, copied);
+   ClearSamples(dest, destformat, copied, numsamples - copied);
+}
+
+void SampleBlockCache::Trim()
+{
+   while (mBytes > mBudget && !mOrder.empty()) {
+      auto iter = mEntries.find(mOrder.front());
+      mBytes -= iter->second.pData->Bytes();
+      mEntries.erase(iter);
+      mOrder.pop_front();
+      ++mEvictions;
+   }
+}
+
+IntSetting SampleBlockCacheSize{ L"/SampleBlockCache/SizeMB", 256 };
@@ -0,0 +1,127 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SampleBlockCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_BLOCK_CACHE__
+#define __AUDACITY_SAMPLE_BLOCK_CACHE__
+
+#include "Prefs.h"
+#include "SampleFormat.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class SampleBlock;
+
+///\brief Process-wide store of the decoded samples of recently read blocks
+/*!
+ SampleBlock::GetSamples() looks here before reading the block's storage, and
+ on a miss loads the whole block here.  It is safe to use from any thread.
+
+ Entries are keyed by the address of the block, rather than by its
+ SampleBlockID, which is unique only within one project; they are removed
+ when the block is destroyed.  The cache holds samples up to a budget of
+ bytes, discarding the least recently used blocks first.
+ */
+class WAVE_TRACK_API SampleBlockCache final
+{
+public:
+   struct Stats {
+      unsigned long long hits = 0;
+      unsigned long long misses = 0;
+      unsigned long long evictions = 0;
+      size_t blocks = 0;
+      size_t bytes = 0;
+   };
+
+   static SampleBlockCache &Get();
+
+   SampleBlockCache(const SampleBlockCache&) = delete;
+   SampleBlockCache &operator=(const SampleBlockCache&) = delete;
+
+   //! If the samples of the block are cached, copy a range of them
+   /*!
+    Counts a hit or a miss, and makes a hit the most recently used block.
+    Samples past the end of the block are zeroed.
+    @return whether the block was found
+    */
+   bool Fetch(const SampleBlock &block, samplePtr dest, sampleFormat destformat,
+      size_t sampleoffset, size_t numsamples);
+
+   //! Copy a range of samples of the block, first loading it all on a miss
+   /*!
+    Reads the storage directly if the block can't be cached at all.
+    May throw what the storage throws.
+    @return the number of samples copied
+    */
+   size_t GetSamples(SampleBlock &block, samplePtr dest,
+      sampleFormat destformat, size_t sampleoffset, size_t numsamples);
+
+   //! Whether the samples of the block are cached; not counted as a lookup
+   bool Contains(const SampleBlock &block) const;
+
+   //! Read all samples of the block from its storage, if not yet cached
+   //! and not bigger than the whole budget
+   /*! May throw what the storage throws */
+   void Load(SampleBlock &block);
+
+   //! Forget the block; called by its destructor
+   void Erase(const SampleBlock &block) noexcept;
+
+   void Clear();
+
+   //! Change the maximum number of bytes of samples, discarding any excess
+   void SetBudget(size_t bytes);
+   size_t GetBudget() const;
+
+   Stats GetStats() const;
+   void ResetStats();
+
+private:
+   SampleBlockCache();
+
+   struct Data {
+      sampleFormat format;
+      size_t count;
+      SampleBuffer samples;
+
+      size_t Bytes() const { return count * SAMPLE_SIZE(format); }
+   };
+   using Order = std::list<const SampleBlock*>;
+   struct Entry {
+      std::shared_ptr<const Data> pData;
+      Order::iterator position;
+   };
+
+   //! Find the data, counting a hit or a miss
+   std::shared_ptr<const Data> Find(const SampleBlock &block);
+   //! Read the storage and insert the data, unless it exceeds the budget
+   std::shared_ptr<const Data> DoLoad(SampleBlock &block);
+   static void Copy(const Data &data, samplePtr dest, sampleFormat destformat,
+      size_t sampleoffset, size_t numsamples);
+
+   //! Discard least recently used entries until within budget;
+   //! mMutex must be held
+   void Trim();
+
+   mutable std::mutex mMutex;
+   std::unordered_map<const SampleBlock*, Entry> mEntries;
+   //! Least recently used first
+   Order mOrder;
+   size_t mBudget;
+   size_t mBytes{ 0 };
+   unsigned long long mHits{ 0 };
+   unsigned long long mMisses{ 0 };
+   unsigned long long mEvictions{ 0 };
+};
+
+//! Budget of SampleBlockCache in megabytes; applied with SetBudget()
+extern WAVE_TRACK_API IntSetting SampleBlockCacheSize;
+
+#endif
@@ -41,6 +41,7 @@
 #include <wx/log.h>
 
 #include "BasicUI.h"
+#include "BlockPrefetcher.h"
 #include "Dither.h"
 #include "SampleBlock.h"
 #include "InconsistencyException.h"
@@ -1180,22 +1181,53 @@ bool Sequence::Get(samplePtr buffer, sampleFormat format,
 bool Sequence::Get(int b, samplePtr buffer, sampleFormat format,
    sampleCount start, size_t len, bool mayThrow) const
 {
+   // Gather the ranges of several blocks at a time, so that the factory
+   // may fetch them together
+   constexpr size_t MaxBatch = 16;
+   SampleBlockFactory::BlockRead reads[MaxBatch];
+
    bool result = true;
    while (len) {
-      const SeqBlock &block = mBlock[b];
-      // start is in block
-      const auto bstart = (start - block.start).as_size_t();
-      // bstart is not more than block length
-      const auto blen = std::min(len, block.sb->GetSampleCount() - bstart);
+      size_t nReads = 0;
+      size_t batchLen = 0;
+      while (len && nReads < MaxBatch) {
+         const SeqBlock &block = mBlock[b];
+         // start is in block
+         const auto bstart = (start - block.start).as_size_t();
+         // bstart is not more than block length
+         const auto blen = std::min(len, block.sb->GetSampleCount() - bstart);
+
+         reads[nReads++] = { block.sb.get(), bstart, blen };
+
+         len -= blen;
+         batchLen += blen;
+         b++;
+         start += blen;
+      }
 
-      if (! Read(buffer, format, block, bstart, blen, mayThrow) )
-         result = false;
+      if (nReads == 1) {
+         if (! Read(buffer, format, mBlock[b - 1],
+            reads[0].sampleoffset, reads[0].numsamples, mayThrow) )
+            result = false;
+      }
+      else {
+         // Either throws, or of !mayThrow, tells how many were really read
+         const auto got = mpFactory->GetSamplesBatch(
+            reads, nReads, buffer, format, mayThrow);
+         if (got != batchLen) {
+            wxLogWarning(wxT("Expected to read %ld samples, got %ld samples."),
+                         batchLen, got);
+            result = false;
+         }
+      }
 
-      len -= blen;
-      buffer += (blen * SAMPLE_SIZE(format));
-      b++;
-      start += blen;
+      buffer += (batchLen * SAMPLE_SIZE(format));
    }
+
+   // Start loading what a sequential reader will want next
+   if (const auto pPrefetcher = mpFactory->GetPrefetcher())
+      pPrefetcher->Request(mBlock, b);
+
    return result;
 }
 
@@ -15,6 +15,8 @@
 *//*******************************************************************/
 #include "WaveClip.h"
 
+#include <atomic>
+#include <chrono>
 #include <math.h>
 #include <numeric>
 #include <optional>
@@ -28,6 +30,7 @@
 #include "Sequence.h"
 #include "TimeAndPitchInterface.h"
 #include "UserException.h"
+#include "concurrency/ThreadPool.h"
 
 const char *WaveClip::WaveClip_tag = "waveclip";
 
@@ -1613,6 +1616,77 @@ PitchAndSpeedPreset WaveClip::GetPitchAndSpeedPreset() const
    return mPitchAndSpeedPreset;
 }
 
+namespace {
+//! Resample part of one sequence, appending the outputs the segment keeps
+/*!
+ Stops early, without appending all outputs, if `cancelled` is set.
+ @param resample a new constant-rate resampler
+ @param done incremented by the count of input samples consumed
+ @throws SimpleMessageBoxException if the input can't be read
+ */
+void ResampleSegment(const Sequence &sequence, Sequence &newSequence,
+   ::Resample &resample, double factor, const ::Resample::Segment &segment,
+   std::atomic<long long> &done, std::atomic<bool> &cancelled)
+{
+   const size_t bufsize = 65536;
+   Floats inBuffer{ bufsize };
+   Floats outBuffer{ bufsize };
+   auto pos = segment.inStart;
+   auto skip = segment.skip;
+   auto keep = segment.keep;
+   size_t outGenerated = 0;
+
+   /**
+    * We want to keep going as long as we have something to feed the resampler
+    * with OR as long as the resampler spews out samples (which could continue
+    * for a few iterations after we stop feeding it)
+    */
+   while ((pos < segment.inEnd || outGenerated > 0) && !(keep && *keep == 0))
+   {
+      if (cancelled)
+         return;
+      try {
+         const auto inLen =
+            limitSampleBufferSize(bufsize, segment.inEnd - pos);
+         bool isLast = ((pos + inLen) == segment.inEnd);
+         if (inLen > 0 &&
+            !sequence.Get(
+               (samplePtr)inBuffer.get(), floatSample, pos, inLen, true))
+            throw SimpleMessageBoxException{
+               ExceptionType::Internal,
+               XO("Resampling failed."),
+               XO("Warning"),
+               "Error:_Resampling"
+            };
+
+         const auto results = resample.Process(factor, inBuffer.get(), inLen,
+            isLast, outBuffer.get(), bufsize);
+         outGenerated = results.second;
+
+         // Discard the warm-up, and anything after what is kept
+         const auto first = limitSampleBufferSize(outGenerated, skip);
+         skip -= first;
+         auto count = outGenerated - first;
+         if (keep) {
+            count = limitSampleBufferSize(count, *keep);
+            *keep -= count;
+         }
+         newSequence.Append((samplePtr)(outBuffer.get() + first), floatSample,
+            count, 1,
+            widestSampleFormat /* computed samples need dither */
+         );
+
+         pos += results.first;
+         done += results.first;
+      }
+      catch (...) {
+         cancelled = true;
+         throw;
+      }
+   }
+}
+}
+
 /*! @excsafety{Strong} */
 void WaveClip::Resample(int rate, BasicUI::ProgressDialog *progress)
 {
@@ -1626,101 +1700,76 @@ void WaveClip::Resample(int rate, BasicUI::ProgressDialog *progress)
 
    // This function does its own RAII without a Transaction
 
+   using audacity::concurrency::ThreadPool;
+
    double factor = (double)rate / (double)mRate;
+   const auto numSamples = GetNumSamples();
+   const auto nChannels = mSequences.size();
+
+   // Resample channels concurrently, and when there are fewer channels than
+   // threads, cut long channels into segments too
+   const auto nThreads = ThreadPool::HardwareConcurrency();
+   const auto segments = ::Resample::MakeSegments(mRate, rate, numSamples,
+      (nThreads + nChannels - 1) / nChannels);
+   const auto nSegments = segments.size();
+
+   // Each segment of each channel is appended to its own sequence
+   std::vector<std::vector<std::unique_ptr<Sequence>>> segmentSequences;
+   long long total = 0;
+   for (const auto &segment : segments) {
+      segmentSequences.push_back(GetEmptySequenceCopies());
+      total += static_cast<long long>(nChannels) *
+         (segment.inEnd - segment.inStart).as_long_long();
+   }
+
    //Resample is always configured to have single channel.
-   //Create Resample instance per each channel in the clip
+   //Create Resample instance per each channel in each segment, here, because
+   //the constructor reads preferences
    std::vector<::Resample> resample;
-   for (unsigned n = 0; n < mSequences.size(); ++n)
+   for (size_t ii = 0; ii < nChannels * nSegments; ++ii)
       resample.emplace_back(true, factor, factor);// constant rate resampling
 
-   const size_t bufsize = 65536;
-   Floats inBuffer{ bufsize };
-   Floats outBuffer{ bufsize };
-   sampleCount pos = 0;
-   bool error = false;
-   int outGenerated = 0;
-   const auto numSamples = GetNumSamples();
-
-   // These sequences are appended to below
-   auto newSequences = GetEmptySequenceCopies();
-
-   /**
-    * We want to keep going as long as we have something to feed the resampler
-    * with OR as long as the resampler spews out samples (which could continue
-    * for a few iterations after we stop feeding it)
-    */
-   while (pos < numSamples || outGenerated > 0) {
-      const auto inLen = limitSampleBufferSize( bufsize, numSamples - pos );
-
-      bool isLast = ((pos + inLen) == numSamples);
-
-      auto ppNewSequence = newSequences.begin();
-      std::optional<std::pair<size_t, size_t>> results{};
-      size_t nSequence = 0;
-      for (auto &pSequence : mSequences) {
-         auto &pNewSequence = *ppNewSequence++;
-         if (
-            inLen > 0 &&
-            !pSequence->Get(
-               (samplePtr)inBuffer.get(), floatSample, pos, inLen, true))
-         {
-            error = true;
-            break;
-         }
-
-         // Expect the same results for all channels, or else fail
-         auto newResults = resample[nSequence].Process(factor, inBuffer.get(), inLen,
-            isLast, outBuffer.get(), bufsize);
-         if (!results)
-            results.emplace(newResults);
-         else if (*results != newResults) {
-            error = true;
-            break;
-         }
-
-         outGenerated = results->second;
-         if (outGenerated < 0) {
-            error = true;
-            break;
+   std::atomic<long long> done{ 0 };
+   std::atomic<bool> cancelled{ false };
+   // The workers do all the resampling, while this thread shows their
+   // combined progress and checks for cancellation
+   ThreadPool pool{ std::min(nChannels * nSegments, nThreads) };
+   pool.ParallelForPolling(nChannels * nSegments,
+      [&](size_t index, size_t) {
+         const auto iChannel = index % nChannels;
+         const auto iSegment = index / nChannels;
+         ResampleSegment(*mSequences[iChannel],
+            *segmentSequences[iSegment][iChannel], resample[index], factor,
+            segments[iSegment], done, cancelled);
+      },
+      [&]{
+         if (progress) {
+            auto updateResult = progress->Poll(done.load(), total);
+            if (updateResult != BasicUI::ProgressResult::Success) {
+               cancelled = true;
+               throw UserException{};
+            }
          }
+      },
+      std::chrono::milliseconds{ 50 });
 
-         pNewSequence->Append((samplePtr)outBuffer.get(), floatSample,
-            outGenerated, 1,
-            widestSampleFormat /* computed samples need dither */
-         );
-         ++nSequence;
-      }
-      if (results)
-         pos += results->first;
-
-      if (progress)
-      {
-         auto updateResult = progress->Poll(
-            pos.as_long_long(),
-            numSamples.as_long_long()
-         );
-         error = (updateResult != BasicUI::ProgressResult::Success);
-         if (error)
-            throw UserException{};
+   // These sequences replace the old ones
+   auto newSequences = GetEmptySequenceCopies();
+   for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
+      auto &newSequence = *newSequences[iChannel];
+      for (auto &sequences : segmentSequences) {
+         auto &segmentSequence = *sequences[iChannel];
+         segmentSequence.Flush();
+         newSequence.Paste(newSequence.GetNumSamples(), &segmentSequence);
       }
    }
 
-   if (error)
-      throw SimpleMessageBoxException{
-         ExceptionType::Internal,
-         XO("Resampling failed."),
-         XO("Warning"),
-         "Error:_Resampling"
-      };
-   else
-   {
-      // Use No-fail-guarantee in these steps
-      mSequences = std::move(newSequences);
-      mRate = rate;
-      Flush();
-      Attachments::ForEach( std::mem_fn( &WaveClipListener::Invalidate ) );
-      MarkChanged();
-   }
+   // Use No-fail-guarantee in these steps
+   mSequences = std::move(newSequences);
+   mRate = rate;
+   Flush();
+   Attachments::ForEach( std::mem_fn( &WaveClipListener::Invalidate ) );
+   MarkChanged();
 }
 
 void WaveClip::SetName(const wxString& name)
@@ -12,6 +12,7 @@
 #define __AUDACITY_WAVETRACK__
 
 #include "ClipInterface.h"
+#include "GlobalVariable.h"
 #include "PlaybackDirection.h"
 #include "Prefs.h"
 #include "SampleCount.h"
@@ -527,6 +528,16 @@ public:
    XMLTagHandler *HandleXMLChild(const std::string_view& tag) override;
    void WriteXML(XMLWriter &xmlFile) const override;
 
+   //! Whether WriteXML() must be called on the main thread
+   /*!
+    Writers registered in WaveTrackIORegistry that are not safe on other
+    threads install this, answering true when they have something to write.
+    Answers false when nothing is installed.
+    */
+   struct WAVE_TRACK_API XMLNeedsMainThread : GlobalHook<XMLNeedsMainThread,
+      bool(const WaveTrack &)
+   >{};
+
    // Returns true if an error occurred while reading from XML
    std::optional<TranslatableString> GetErrorOpening() const override;
 
@@ -26,6 +26,14 @@
 
 #include <wx/wx.h>
 #include <wx/ffile.h>
+#include <wx/file.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
 
 #include "sndfile.h"
 
@@ -39,8 +47,16 @@
 #include "ImportProgressListener.h"
 #include "ImportUtils.h"
 #include "WaveTrack.h"
+#include "concurrency/ThreadPool.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef USE_LIBID3TAG
    #include <id3tag.h>
@@ -98,6 +114,27 @@ public:
    {}
 
 private:
+   //! Append interleaved frames of all channels to the tracks
+   using AppendChunk = std::function<
+      void(constSamplePtr buffer, sampleFormat format, size_t frames)>;
+
+   //! Feed the tracks directly from a memory mapping of the file
+   /*!
+    @return false, having appended nothing, if the file is not of a simple
+    enough format
+    */
+   bool ImportMapped(ImportProgressListener& progressListener,
+      audacity::concurrency::ThreadPool& pool,
+      const AppendChunk& appendChunk, size_t maxBlock);
+
+   //! Feed the tracks with samples read by libsndfile
+   /*! @return false if buffers could not be allocated */
+   bool ImportBuffered(ImportProgressListener& progressListener,
+      const AppendChunk& appendChunk, size_t maxBlock);
+
+   void ReportProgress(
+      ImportProgressListener& progressListener, sampleCount framescompleted);
+
    SFFile                mFile;
    const SF_INFO         mInfo;
    sampleFormat          mEffectiveFormat;
@@ -292,8 +329,6 @@ void PCMImportFileHandle::Import(
    const auto format = ImportUtils::ChooseFormat(mFormat);
    auto trackList = trackFactory->CreateMany(mInfo.channels, format, mInfo.samplerate);
 
-   auto fileTotalFrames =
-      (sampleCount)mInfo.frames; // convert from sf_count_t
    auto maxBlockSize = (*trackList->Any<WaveTrack>().begin())->GetMaxBlockSize();
 
    {
@@ -318,63 +353,49 @@ void PCMImportFileHandle::Import(
          return;
       }
 
-      SampleBuffer srcbuffer, buffer;
-      wxASSERT(mInfo.channels >= 0);
-      while (NULL == srcbuffer.Allocate(maxBlock * mInfo.channels, mFormat).ptr() ||
-             NULL == buffer.Allocate(maxBlock, mFormat).ptr())
-      {
-         maxBlock /= 2;
-         if (maxBlock < 1)
-         {
-            progressListener.OnImportResult(ImportProgressListener::ImportResult::Error);
-            return;
-         }
+      // Channels of one track share a clip, so they are appended together,
+      // but the tracks are appended concurrently
+      std::vector<WaveTrack*> tracks;
+      for (auto track : trackList->Any<WaveTrack>())
+         tracks.push_back(track);
+      std::vector<unsigned> firstChannels;
+      unsigned nChannels = 0;
+      for (auto track : tracks) {
+         firstChannels.push_back(nChannels);
+         nChannels += track->NChannels();
       }
 
-      decltype(fileTotalFrames) framescompleted = 0;
-
-      long block;
-      do {
-         block = maxBlock;
-
-         if (mFormat == int16Sample)
-            block = SFCall<sf_count_t>(sf_readf_short, mFile.get(), (short *)srcbuffer.ptr(), block);
-         //import 24 bit int as float and have the append function convert it.  This is how PCMAliasBlockFile worked too.
-         else
-            block = SFCall<sf_count_t>(sf_readf_float, mFile.get(), (float *)srcbuffer.ptr(), block);
+      // Conversion of mapped samples is split by sample range, not by
+      // track, so the pool has workers even for a mono file
+      audacity::concurrency::ThreadPool pool{
+         audacity::concurrency::ThreadPool::HardwareConcurrency() - 1 };
 
-         if(block < 0 || block > (long)maxBlock) {
-            wxASSERT(false);
-            block = maxBlock;
-         }
-
-         if (block) {
-            unsigned c = 0;
-            ImportUtils::ForEachChannel(*trackList, [&](auto& channel)
+      const AppendChunk appendChunk =
+         [&](constSamplePtr buffer, sampleFormat bufferFormat, size_t frames)
+      {
+         const auto sampleSize = SAMPLE_SIZE(bufferFormat);
+         pool.ParallelFor(tracks.size(), [&](size_t iTrack, size_t)
+         {
+            // Append with a stride, which deinterleaves the channels
+            auto c = firstChannels[iTrack];
+            ImportUtils::ForEachChannel(*tracks[iTrack], [&](auto& channel)
             {
-               if (mFormat==int16Sample) {
-                  for(int j=0; j<block; j++)
-                     ((short *)buffer.ptr())[j] =
-                        ((short *)srcbuffer.ptr())[mInfo.channels*j+c];
-               }
-               else {
-                  for(int j=0; j<block; j++)
-                     ((float *)buffer.ptr())[j] =
-                        ((float *)srcbuffer.ptr())[mInfo.channels*j+c];
-               }
-
                channel.AppendBuffer(
-                  buffer.ptr(),
-                  (mFormat == int16Sample) ? int16Sample : floatSample,
-                  block, 1, mEffectiveFormat
+                  buffer + c * sampleSize,
+                  bufferFormat,
+                  frames, mInfo.channels, mEffectiveFormat
                );
                ++c;
             });
-            framescompleted += block;
-         }
-         if(fileTotalFrames > 0)
-            progressListener.OnImportProgress(framescompleted.as_double() / fileTotalFrames.as_double());
-      } while (block > 0 && !IsCancelled() && !IsStopped());
+         });
+      };
+
+      if (!ImportMapped(progressListener, pool, appendChunk, maxBlock) &&
+          !ImportBuffered(progressListener, appendChunk, maxBlock))
+      {
+         progressListener.OnImportResult(ImportProgressListener::ImportResult::Error);
+         return;
+      }
    }
 
    if(IsCancelled())
@@ -586,6 +607,325 @@ void PCMImportFileHandle::Import(
                                    : ImportProgressListener::ImportResult::Success);
 }
 
+namespace {
+//! Read-only view of a whole file, mapped into memory
+class MappedFile final
+{
+public:
+   explicit MappedFile(const wxString &path)
+   {
+      if (!mFile.Open(path, wxFile::read))
+         return;
+      const auto length = mFile.Length();
+      if (length <= 0 ||
+          static_cast<unsigned long long>(length) >
+             std::numeric_limits<size_t>::max())
+         return;
+#ifdef _WIN32
+      const auto hFile =
+         reinterpret_cast<HANDLE>(_get_osfhandle(mFile.fd()));
+      mMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!mMapping)
+         return;
+      const auto data = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+      if (!data)
+         return;
+#else
+      const auto data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE,
+         mFile.fd(), 0);
+      if (data == MAP_FAILED)
+         return;
+      // Import reads the file once, from beginning to end
+      madvise(data, length, MADV_SEQUENTIAL);
+#endif
+      mData = static_cast<const unsigned char *>(data);
+      mSize = length;
+   }
+
+   ~MappedFile()
+   {
+#ifdef _WIN32
+      if (mData)
+         UnmapViewOfFile(mData);
+      if (mMapping)
+         CloseHandle(mMapping);
+#else
+      if (mData)
+         munmap(const_cast<unsigned char *>(mData), mSize);
+#endif
+   }
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile &operator=(const MappedFile&) = delete;
+
+   const unsigned char *Data() const { return mData; }
+   size_t Size() const { return mSize; }
+
+private:
+   wxFile mFile;
+#ifdef _WIN32
+   HANDLE mMapping{};
+#endif
+   const unsigned char *mData{};
+   size_t mSize{};
+};
+
+uint32_t ReadLE32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+//! Find the data chunk of a RIFF WAVE file
+/*! @return the offset and length of the chunk, or {0, 0} if not found */
+std::pair<size_t, size_t> FindWaveData(const unsigned char *data, size_t size)
+{
+   if (size < 12 || memcmp(data, "RIFF", 4) != 0 ||
+       memcmp(data + 8, "WAVE", 4) != 0)
+      return { 0, 0 };
+   uint64_t offset = 12;
+   while (offset + 8 <= size) {
+      const auto id = data + offset;
+      const uint64_t length = ReadLE32(id + 4);
+      offset += 8;
+      if (memcmp(id, "data", 4) == 0)
+         // The length may be a placeholder if writing was interrupted; only
+         // the bytes present can be trusted
+         return { offset, std::min<uint64_t>(length, size - offset) };
+      // Chunks are padded to even lengths
+      offset += length + (length & 1);
+   }
+   return { 0, 0 };
+}
+}
+
+void PCMImportFileHandle::ReportProgress(
+   ImportProgressListener& progressListener, sampleCount framescompleted)
+{
+   const auto fileTotalFrames =
+      (sampleCount)mInfo.frames; // convert from sf_count_t
+   if(fileTotalFrames > 0)
+      progressListener.OnImportProgress(framescompleted.as_double() / fileTotalFrames.as_double());
+}
+
+bool PCMImportFileHandle::ImportMapped(
+   ImportProgressListener& progressListener,
+   audacity::concurrency::ThreadPool& pool,
+   const AppendChunk& appendChunk, size_t maxBlock)
+{
+   // Only the common little endian WAV encodings are decoded here;
+   // libsndfile handles all else
+#if wxBYTE_ORDER != wxLITTLE_ENDIAN
+   return false;
+#else
+   const auto major = mInfo.format & SF_FORMAT_TYPEMASK;
+   const auto subtype = mInfo.format & SF_FORMAT_SUBMASK;
+   const auto endian = mInfo.format & SF_FORMAT_ENDMASK;
+   if (major != SF_FORMAT_WAV && major != SF_FORMAT_WAVEX)
+      return false;
+   if (endian != SF_ENDIAN_FILE && endian != SF_ENDIAN_LITTLE)
+      return false;
+   size_t bytesPerSample;
+   switch (subtype) {
+   case SF_FORMAT_PCM_16:
+      bytesPerSample = 2; break;
+   case SF_FORMAT_PCM_24:
+      bytesPerSample = 3; break;
+   case SF_FORMAT_PCM_32:
+   case SF_FORMAT_FLOAT:
+      bytesPerSample = 4; break;
+   default:
+      return false;
+   }
+   if (mInfo.frames <= 0)
+      return false;
+
+   MappedFile file{ GetFilename() };
+   if (!file.Data())
+      return false;
+   const auto [offset, length] = FindWaveData(file.Data(), file.Size());
+   const auto frameBytes = bytesPerSample * mInfo.channels;
+   const sampleCount totalFrames = mInfo.frames;
+   if (offset == 0 ||
+       static_cast<unsigned long long>(mInfo.frames) > length / frameBytes)
+      return false;
+   const auto data = file.Data() + offset;
+
+   // 16 bit and float samples are appended straight from the mapping, if
+   // aligned for their type, which the chunk is sure to be only for two
+   // bytes; others are converted to float, as libsndfile would, by all
+   // workers of the pool, each taking a range of frames of the chunk
+   const auto aligned = [&](sampleFormat format) {
+      return reinterpret_cast<uintptr_t>(data) % SAMPLE_SIZE(format) == 0;
+   };
+   const bool direct =
+      (subtype == SF_FORMAT_PCM_16 && mFormat == int16Sample &&
+         aligned(int16Sample)) ||
+      (subtype == SF_FORMAT_FLOAT && aligned(floatSample));
+   const auto appendFormat = direct && subtype == SF_FORMAT_PCM_16
+      ? int16Sample : floatSample;
+   SampleBuffer converted;
+   if (!direct &&
+       !converted.Allocate(maxBlock * mInfo.channels, floatSample).ptr())
+      return false;
+
+   const auto convert = [&](const unsigned char *src, float *dest, size_t count)
+   {
+      if (subtype == SF_FORMAT_PCM_24)
+         for (size_t ii = 0; ii < count; ++ii, src += 3) {
+            const int32_t value = int32_t(
+               (uint32_t(src[0]) << 8) | (uint32_t(src[1]) << 16) |
+               (uint32_t(src[2]) << 24)) >> 8;
+            dest[ii] = float(value) * (1.0f / 8388608.0f);
+         }
+      else if (subtype == SF_FORMAT_PCM_32)
+         for (size_t ii = 0; ii < count; ++ii, src += 4)
+            dest[ii] = float(int32_t(ReadLE32(src))) * (1.0f / 2147483648.0f);
+      else if (subtype == SF_FORMAT_FLOAT)
+         // Float samples that are not aligned
+         memcpy(dest, src, count * sizeof(float));
+      else {
+         // 16 bit samples imported as float
+         for (size_t ii = 0; ii < count; ++ii, src += 2)
+            dest[ii] = float(int16_t(src[0] | (src[1] << 8))) *
+               (1.0f / 32768.0f);
+      }
+   };
+
+   // Split conversion of a chunk into this many frames per job
+   constexpr size_t ConversionFrames = 16384;
+
+   sampleCount framescompleted = 0;
+   while (framescompleted < totalFrames && !IsCancelled() && !IsStopped()) {
+      const auto block =
+         limitSampleBufferSize(maxBlock, totalFrames - framescompleted);
+      const auto src =
+         data + framescompleted.as_size_t() * frameBytes;
+      if (direct)
+         appendChunk(reinterpret_cast<constSamplePtr>(src), appendFormat,
+            block);
+      else {
+         const auto dest = reinterpret_cast<float *>(converted.ptr());
+         const auto nJobs = (block + ConversionFrames - 1) / ConversionFrames;
+         pool.ParallelFor(nJobs, [&](size_t iJob, size_t)
+         {
+            const auto first = iJob * ConversionFrames;
+            const auto frames = std::min(ConversionFrames, block - first);
+            convert(src + first * frameBytes, dest + first * mInfo.channels,
+               frames * mInfo.channels);
+         });
+         appendChunk(converted.ptr(), floatSample, block);
+      }
+      framescompleted += block;
+      ReportProgress(progressListener, framescompleted);
+   }
+   return true;
+#endif
+}
+
+bool PCMImportFileHandle::ImportBuffered(
+   ImportProgressListener& progressListener,
+   const AppendChunk& appendChunk, size_t maxBlock)
+{
+   // Reading of the file is pipelined with the appending of samples to
+   // the tracks, which builds the sample blocks.  One reader thread, alive
+   // for the whole import, fills a bounded ring of buffers that the
+   // appenders drain in order.
+   constexpr size_t NBuffers = 2;
+   SampleBuffer srcbuffers[NBuffers];
+   wxASSERT(mInfo.channels >= 0);
+   const auto allocate = [&]{
+      for (auto &srcbuffer : srcbuffers)
+         if (!srcbuffer.Allocate(maxBlock * mInfo.channels, mFormat).ptr())
+            return false;
+      return true;
+   };
+   while (!allocate())
+   {
+      maxBlock /= 2;
+      if (maxBlock < 1)
+         return false;
+   }
+
+   const auto read = [&](SampleBuffer &srcbuffer) -> long {
+      long block = maxBlock;
+
+      if (mFormat == int16Sample)
+         block = SFCall<sf_count_t>(sf_readf_short, mFile.get(), (short *)srcbuffer.ptr(), block);
+      //import 24 bit int as float and have the append function convert it.  This is how PCMAliasBlockFile worked too.
+      else
+         block = SFCall<sf_count_t>(sf_readf_float, mFile.get(), (float *)srcbuffer.ptr(), block);
+
+      if(block < 0 || block > (long)maxBlock) {
+         wxASSERT(false);
+         block = maxBlock;
+      }
+      return block;
+   };
+
+   // Guarded by mutex
+   long frames[NBuffers]{};
+   size_t nFull = 0;
+   bool stop = false;
+   std::mutex mutex;
+   std::condition_variable condition;
+
+   std::thread reader{ [&]{
+      for (size_t ii = 0;; ii = (ii + 1) % NBuffers) {
+         {
+            std::unique_lock<std::mutex> lock{ mutex };
+            condition.wait(lock, [&]{ return stop || nFull < NBuffers; });
+            if (stop)
+               return;
+         }
+         const auto block = read(srcbuffers[ii]);
+         {
+            std::lock_guard<std::mutex> lock{ mutex };
+            frames[ii] = block;
+            ++nFull;
+         }
+         condition.notify_all();
+         if (block == 0)
+            return;
+      }
+   } };
+   // Don't leave the reader running past the lifetime of the buffers, even
+   // if appending throws
+   auto cleanup = finally([&]{
+      {
+         std::lock_guard<std::mutex> lock{ mutex };
+         stop = true;
+      }
+      condition.notify_all();
+      reader.join();
+   });
+
+   const auto appendFormat =
+      (mFormat == int16Sample) ? int16Sample : floatSample;
+
+   sampleCount framescompleted = 0;
+   for (size_t ii = 0; !IsCancelled() && !IsStopped();
+        ii = (ii + 1) % NBuffers) {
+      long block;
+      {
+         std::unique_lock<std::mutex> lock{ mutex };
+         condition.wait(lock, [&]{ return nFull > 0; });
+         block = frames[ii];
+      }
+      if (block == 0)
+         break;
+
+      appendChunk(srcbuffers[ii].ptr(), appendFormat, block);
+      framescompleted += block;
+      {
+         std::lock_guard<std::mutex> lock{ mutex };
+         --nFull;
+      }
+      condition.notify_all();
+      ReportProgress(progressListener, framescompleted);
+   }
+   return true;
+}
+
 PCMImportFileHandle::~PCMImportFileHandle()
 {
 }
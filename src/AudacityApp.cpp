@@ -69,6 +69,8 @@ It handles initialization and termination by subclassing wxApp.
 #include "AudacityFileConfig.h"
 #include "AudioIO.h"
 #include "Benchmark.h"
+#include "BlockPrefetcher.h"
+#include "SampleBlockCache.h"
 #include "Clipboard.h"
 #include "CommandLineArgs.h"
 #include "commands/CommandHandler.h"
@@ -1174,6 +1176,13 @@ bool AudacityApp::InitPart2()
       Sequence::SetMaxDiskBlockSize(lval);
    }
 
+   if (parser->Found(wxT("profile-open")))
+      ProjectFileIO::SetProfileOpening(true);
+
+   BlockPrefetcher::SetDistance(BlockPrefetchDistance.Read());
+   SampleBlockCache::Get().SetBudget(
+      static_cast<size_t>(SampleBlockCacheSize.Read()) << 20);
+
    if (playingJournal)
       Journal::SetInputFileName( journalFileName );
 
@@ -1986,6 +1995,10 @@ std::unique_ptr<wxCmdLineParser> AudacityApp::ParseCommandLine()
    /*i18n-hint: This displays the Audacity version */
    parser->AddSwitch(wxT("v"), wxT("version"), _("display Tenacity version"));
 
+   /*i18n-hint: This writes timings of opening projects to the log */
+   parser->AddSwitch(wxEmptyString, wxT("profile-open"),
+                     _("log where the time goes when opening projects"));
+
    /*i18n-hint: This is a list of one or more files that Audacity
     *           should open upon startup */
    parser->AddParam(_("audio or project file name"),
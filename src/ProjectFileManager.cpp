@@ -1758,19 +1758,15 @@ void ProjectFileManager::Compact()
       if (&mProject == clipboard.Project().lock().get())
          clipboard.Clear();
 
-      // Refresh the before space usage since it may have changed due to the
-      // above actions.
-      auto before = wxFileName::GetSize(projectFileIO.GetFileName());
-
       projectFileIO.Compact(trackLists, true);
 
-      auto after = wxFileName::GetSize(projectFileIO.GetFileName());
-
       if (!isBatch)
       {
+         // Not the change in file size, which, after compaction in place,
+         // happens only at the next checkpoint
          AudacityMessageBox(
             XO("Compacting actually freed %s of disk space.")
-            .Format(Internat::FormatSize((before - after).GetValue())),
+            .Format(Internat::FormatSize(projectFileIO.GetReclaimedBytes())),
             XO("Compact Project"));
       }
 
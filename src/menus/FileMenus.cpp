@@ -5,6 +5,7 @@
 #include "PluginManager.h"
 #include "Prefs.h"
 #include "Project.h"
+#include "ProjectBlockCompression.h"
 #include "../ProjectFileManager.h"
 #include "ProjectHistory.h"
 #include "../ProjectManager.h"
@@ -251,6 +252,15 @@ void OnCompact(const CommandContext &context)
    ProjectFileManager::Get(context.project).Compact();
 }
 
+void OnCompressBlocks(const CommandContext &context)
+{
+   auto &project = context.project;
+   auto &compression = ProjectBlockCompression::Get(project);
+   compression.SetEnabled(!compression.IsEnabled());
+   // The setting is saved with the project
+   UndoManager::Get(project).MarkUnsaved();
+}
+
 void OnSave(const CommandContext &context )
 {
    auto &project = context.project;
@@ -517,7 +527,12 @@ auto FileMenu()
             Command( wxT("SaveAs"), XXO("Save Project &As..."), OnSaveAs,
                AudioIONotBusyFlag() ),
             Command( wxT("SaveCopy"), XXO("&Backup Project..."), OnSaveCopy,
-               AudioIONotBusyFlag() )
+               AudioIONotBusyFlag() ),
+            Command( wxT("CompressBlocks"), XXO("Com&press New Audio"),
+               OnCompressBlocks, AlwaysEnabledFlag,
+               Options{}.CheckTest( []( const AudacityProject &project ) {
+                  return ProjectBlockCompression::Get( project ).IsEnabled();
+               } ) )
          )//,
 
          // Bug 2600: Compact has interactions with undo/history that are bound
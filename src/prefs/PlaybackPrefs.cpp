@@ -24,6 +24,9 @@
 #include <wx/defs.h>
 #include <wx/textctrl.h>
 
+#include "AudioIO.h"
+#include "BlockPrefetcher.h"
+#include "SampleBlockCache.h"
 #include "ShuttleGui.h"
 #include "Prefs.h"
 
@@ -152,8 +155,21 @@ void PlaybackPrefs::PopulateOrExchange(ShuttleGui & S)
          S.TieCheckBox(XXO("Always scrub un&pinned"),
             {UnpinnedScrubbingPreferenceKey(),
              UnpinnedScrubbingPreferenceDefault()});
+         S.TieCheckBox(XXO("Wake audio thread on &demand"),
+            AudioIOEventDrivenThread);
       }
       S.EndVerticalLay();
+
+      S.StartMultiColumn(2);
+      {
+         S.TieSpinCtrl(XXO("Mixing &threads (0 for automatic):"),
+            AudioIOPlaybackMixerThreads, 64, 0);
+         S.TieSpinCtrl(XXO("&Read-ahead blocks:"),
+            BlockPrefetchDistance, 64, 0);
+         S.TieSpinCtrl(XXO("Sample &cache (MB):"),
+            SampleBlockCacheSize, 65536, 0);
+      }
+      S.EndMultiColumn();
    }
    S.EndStatic();
 
@@ -180,6 +196,10 @@ bool PlaybackPrefs::Commit()
    ShuttleGui S(this, eIsSavingToPrefs);
    PopulateOrExchange(S);
 
+   BlockPrefetcher::SetDistance(BlockPrefetchDistance.Read());
+   SampleBlockCache::Get().SetBudget(
+      static_cast<size_t>(SampleBlockCacheSize.Read()) << 20);
+
    return true;
 }
 
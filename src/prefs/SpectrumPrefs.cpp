@@ -28,6 +28,7 @@
 
 #include "../TrackPanel.h"
 #include "WaveTrack.h"
+#include "../tracks/playabletrack/wavetrack/ui/SpectrumCache.h"
 #include "../tracks/playabletrack/wavetrack/ui/WaveChannelView.h"
 
 #include <algorithm>
@@ -286,6 +287,15 @@ void SpectrumPrefs::PopulateOrExchange(ShuttleGui & S)
    S.EndStatic();
 #endif
 
+   if (!mWc) {
+      S.StartStatic(XO("Drawing"));
+      {
+         S.TieCheckBox(XXO("Draw at low resolution &first"),
+            SpectrogramProgressiveDrawing);
+      }
+      S.EndStatic();
+   }
+
    } S.EndScroller();
    
    // Enabling and disabling belongs outside this function.
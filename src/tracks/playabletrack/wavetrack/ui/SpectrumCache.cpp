@@ -10,6 +10,7 @@
 
 #include "SpectrumCache.h"
 
+#include "SampleBlock.h"
 #include "SampleCount.h"
 #include "SpectrogramSettings.h"
 #include "RealFFTf.h"
@@ -18,11 +19,31 @@
 #include "WaveClipUIUtilities.h"
 #include "WaveTrack.h"
 #include "WideSampleSequence.h"
+#include "concurrency/ThreadPool.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
 
 namespace {
 
+// Populate() skips columns only if calculating at least so many
+constexpr int ProgressiveColumns = 256;
+// and then calculates one in so many
+constexpr int CoarseStride = 4;
+
+audacity::concurrency::ThreadPool &GetThreadPool()
+{
+   // Shared by all caches, which are populated only while drawing
+   static audacity::concurrency::ThreadPool pool{
+      audacity::concurrency::ThreadPool::HardwareConcurrency() - 1 };
+   return pool;
+}
+
 static void ComputeSpectrumUsingRealFFTf
    (float * __restrict buffer, const FFTParam *hFFT,
     const float * __restrict window, size_t len, float * __restrict out)
@@ -72,6 +93,145 @@ void ComputeSpectrogramGainFactors
    }
 }
 
+// Tiles are the spectra of whole sample blocks, at columns spaced by the
+// window size times a power of two, the level.  They are used when zoomed
+// out so far that a pixel spans at least one such column, and a block has
+// no more than so many of them:
+constexpr size_t MaxTileColumns = 64;
+constexpr unsigned MaxTileLevel = 16;
+// Bytes of tiles kept in memory
+constexpr size_t TileCacheBytes = 64 * 1024 * 1024;
+
+using Tile = std::vector<float>;
+using TilePtr = std::shared_ptr<const Tile>;
+
+//! Most recently used tiles, for all projects
+/*! Keyed by the address of the block, like SampleBlockCache, but holding
+ the block weakly to detect reuse of the address */
+class TileCache final
+{
+public:
+   static TileCache &Get()
+   {
+      static TileCache instance;
+      return instance;
+   }
+
+   TilePtr Find(const SampleBlockPtr &pBlock, const std::string &key)
+   {
+      auto lock = std::lock_guard{ mMutex };
+      auto iter = mEntries.find({ pBlock.get(), key });
+      if (iter == mEntries.end())
+         return {};
+      auto &entry = iter->second;
+      if (entry.wBlock.lock() != pBlock) {
+         Remove(iter);
+         return {};
+      }
+      mOrder.splice(mOrder.end(), mOrder, entry.position);
+      return entry.pTile;
+   }
+
+   void Insert(
+      const SampleBlockPtr &pBlock, const std::string &key, TilePtr pTile)
+   {
+      auto lock = std::lock_guard{ mMutex };
+      Index index{ pBlock.get(), key };
+      if (auto iter = mEntries.find(index); iter != mEntries.end())
+         Remove(iter);
+      mBytes += pTile->size() * sizeof(float);
+      auto position = mOrder.insert(mOrder.end(), index);
+      mEntries.emplace(
+         std::move(index), Entry{ pBlock, std::move(pTile), position });
+      while (mBytes > TileCacheBytes && !mOrder.empty())
+         Remove(mEntries.find(mOrder.front()));
+   }
+
+private:
+   using Index = std::pair<const SampleBlock*, std::string>;
+   using Order = std::list<Index>;
+   struct Entry {
+      std::weak_ptr<SampleBlock> wBlock;
+      TilePtr pTile;
+      Order::iterator position;
+   };
+   using Entries = std::map<Index, Entry>;
+
+   // mMutex must be held
+   void Remove(Entries::iterator iter)
+   {
+      mBytes -= iter->second.pTile->size() * sizeof(float);
+      mOrder.erase(iter->second.position);
+      mEntries.erase(iter);
+   }
+
+   std::mutex mMutex;
+   Entries mEntries;
+   //! Least recently used first
+   Order mOrder;
+   size_t mBytes{ 0 };
+};
+
+//! Level of tiles to compose columns spaced by samplesPerPixel, if any
+std::optional<unsigned> ChooseTileLevel(
+   const SpectrogramSettings &settings, double samplesPerPixel,
+   size_t maxBlockSize)
+{
+   if (settings.algorithm != SpectrogramSettings::algSTFT)
+      return {};
+   const auto windowSize = settings.WindowSize();
+   std::optional<unsigned> result;
+   for (unsigned level = 0; level <= MaxTileLevel; ++level) {
+      const auto hop = windowSize << level;
+      if (hop > samplesPerPixel)
+         break;
+      if (maxBlockSize / hop <= MaxTileColumns)
+         result = level;
+   }
+   return result;
+}
+
+//! Identifies the tiles of a level among other data derived from a block
+std::string TileKey(const SpectrogramSettings &settings, unsigned level)
+{
+   char buffer[80];
+   snprintf(buffer, sizeof buffer, "spectrogram/1/t%d/w%zu/z%zu/l%u",
+      settings.windowType, settings.WindowSize(),
+      settings.ZeroPaddingFactor(), level);
+   return buffer;
+}
+
+//! Spectra without gain of whole windows of the block, each centered in its
+//! hop, so that none reads past the ends of the block
+/*! @return empty if the block is shorter than one hop */
+Tile ComputeTile(const SpectrogramSettings &settings, SampleBlock &block,
+   size_t hop, float *scratch)
+{
+   const auto windowSize = settings.WindowSize();
+   const auto fftLen = windowSize * settings.ZeroPaddingFactor();
+   const auto padding = (fftLen - windowSize) / 2;
+   const auto nBins = settings.NBins();
+   const auto count = block.GetSampleCount();
+   const auto nColumns = count / hop;
+   if (nColumns == 0)
+      return {};
+
+   std::vector<float> samples(count);
+   constexpr auto mayThrow = false; // Don't throw just for display
+   block.GetSamples(reinterpret_cast<samplePtr>(samples.data()),
+      floatSample, 0, count, mayThrow);
+
+   Tile tile(nColumns * nBins);
+   for (size_t ii = 0; ii < nColumns; ++ii) {
+      const auto from = ii * hop + (hop - windowSize) / 2;
+      std::fill(scratch, scratch + fftLen, 0.0f);
+      std::copy_n(&samples[from], windowSize, scratch + padding);
+      ComputeSpectrumUsingRealFFTf(scratch, settings.hFFT.get(),
+         settings.window.get(), fftLen, &tile[ii * nBins]);
+   }
+   return tile;
+}
+
 }
 
 bool SpecCache::isWaveletAnalysis(const SpectrogramSettings& settings) const
@@ -114,7 +274,7 @@ bool SpecCache::CalculateOneSpectrum(
    const SpectrogramSettings& settings, const WaveChannelInterval& clip,
    const int xx, double pixelsPerSecond, int lowerBoundX, int upperBoundX,
    const std::vector<float>& gainFactors, float* __restrict scratch,
-   float* __restrict out) const
+   float* __restrict out, size_t worker) const
 {
    bool result = false;
    const bool reassignment =
@@ -188,10 +348,10 @@ bool SpecCache::CalculateOneSpectrum(
          if (myLen > 0) {
             constexpr auto iChannel = 0u;
             constexpr auto mayThrow = false; // Don't throw just for display
-            mSampleCacheHolder.emplace(
-               clip.GetSampleView(from, myLen, mayThrow));
+            auto &holder = mSampleCacheHolders[worker];
+            holder.emplace(clip.GetSampleView(from, myLen, mayThrow));
             floats.resize(myLen);
-            mSampleCacheHolder->Copy(floats.data(), myLen);
+            holder->Copy(floats.data(), myLen);
             useBuffer = floats.data();
             if (copy) {
                if (useBuffer)
@@ -332,7 +492,7 @@ bool SpecCache::CalculateOneWaveletSpectrum(
    const SpectrogramSettings& settings, const WaveChannelInterval& clip,
    const int xx, double pixelsPerSecond, int lowerBoundX, int upperBoundX,
    const std::vector<float>& gainFactors,
-   float* __restrict out) const
+   float* __restrict out, size_t worker) const
 {
    bool result = false;
    sampleCount from;
@@ -392,10 +552,10 @@ bool SpecCache::CalculateOneWaveletSpectrum(
       if (myLen > 0) {
          constexpr auto iChannel = 0u;
          constexpr auto mayThrow = false; // Don't throw just for display
-         mSampleCacheHolder.emplace(
-             clip.GetSampleView(from, myLen, mayThrow));
+         auto &holder = mSampleCacheHolders[worker];
+         holder.emplace(clip.GetSampleView(from, myLen, mayThrow));
          floats.resize(myLen);
-         mSampleCacheHolder->Copy(floats.data(), myLen);
+         holder->Copy(floats.data(), myLen);
          float *useBuffer = floats.data();
          memcpy(adj, useBuffer, myLen * sizeof(float));
       }
@@ -478,10 +638,143 @@ void SpecCache::Resize(
    mCorrection = correction;
 }
 
+void SpecCache::CalculateColumns(
+   const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+   double pixelsPerSecond, int lowerBoundX, int upperBoundX,
+   const std::vector<float>& gainFactors, int first, int stride)
+{
+   const int begin = lowerBoundX + first;
+   if (begin >= upperBoundX)
+      return;
+   const size_t count = (upperBoundX - begin + stride - 1) / stride;
+
+   auto &pool = GetThreadPool();
+   const size_t fftLen = settings.WindowSize() * settings.ZeroPaddingFactor();
+   std::vector<float> scratch(fftLen * pool.GetConcurrency());
+   mSampleCacheHolders.resize(pool.GetConcurrency());
+
+   // Columns are independent, except in reassignment, which is not done here
+   pool.ParallelFor(count, [&](size_t ii, size_t worker) {
+      const int xx = begin + ii * stride;
+      if (isWaveletAnalysis(settings))
+         CalculateOneWaveletSpectrum(
+            settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
+            gainFactors, &freq[0], worker);
+      else
+         CalculateOneSpectrum(
+            settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
+            gainFactors, &scratch[worker * fftLen], &freq[0], worker);
+   });
+}
+
+bool SpecCache::ComposeColumns(
+   const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+   int lowerBoundX, int upperBoundX, double pixelsPerSecond,
+   const std::vector<float>& gainFactors)
+{
+   if (lowerBoundX >= upperBoundX)
+      return false;
+   const auto &sequence = clip.GetSequence();
+   const auto level =
+      ChooseTileLevel(settings, spp, sequence.GetMaxBlockSize());
+   if (!level)
+      return false;
+
+   const auto hop = settings.WindowSize() << *level;
+   const auto key = TileKey(settings, *level);
+   const auto nBins = settings.NBins();
+   const auto &blocks = sequence.GetBlockArray();
+   const auto numSamples = sequence.GetNumSamples();
+   const auto trim = clip.TimeToSamples(clip.GetTrimLeft());
+
+   // Find the block under each column, and the distinct blocks
+   const size_t count = upperBoundX - lowerBoundX;
+   std::vector<int> blockOfColumn(count, -1);
+   std::vector<int> neededBlocks;
+   for (size_t ii = 0; ii < count; ++ii) {
+      const auto pos = where[lowerBoundX + ii] + trim;
+      if (pos < 0 || pos >= numSamples)
+         continue;
+      const auto iBlock = sequence.FindBlock(pos);
+      blockOfColumn[ii] = iBlock;
+      if (neededBlocks.empty() || neededBlocks.back() != iBlock)
+         neededBlocks.push_back(iBlock);
+   }
+
+   // Find tiles in memory, else in the project, else compute and keep them
+   auto &pool = GetThreadPool();
+   const size_t fftLen = settings.WindowSize() * settings.ZeroPaddingFactor();
+   std::vector<float> scratch(fftLen * pool.GetConcurrency());
+   std::vector<TilePtr> tiles(neededBlocks.size());
+   pool.ParallelFor(neededBlocks.size(), [&](size_t ii, size_t worker) {
+      const auto &pBlock = blocks[neededBlocks[ii]].sb;
+      auto &cache = TileCache::Get();
+      if ((tiles[ii] = cache.Find(pBlock, key)))
+         return;
+      const auto nColumns = pBlock->GetSampleCount() / hop;
+      auto stored = pBlock->LoadDerivedData(key);
+      Tile tile;
+      if (stored.size() == nColumns * nBins * sizeof(float)) {
+         tile.resize(nColumns * nBins);
+         memcpy(tile.data(), stored.data(), stored.size());
+      }
+      else {
+         tile = ComputeTile(
+            settings, *pBlock, hop, &scratch[worker * fftLen]);
+         if (!tile.empty())
+            pBlock->StoreDerivedData(
+               key, tile.data(), tile.size() * sizeof(float));
+      }
+      tiles[ii] = std::make_shared<const Tile>(std::move(tile));
+      cache.Insert(pBlock, key, tiles[ii]);
+   });
+
+   // Copy the nearest column of each tile; calculate the rest directly, as
+   // for blocks shorter than a hop, or samples not yet in any block
+   std::vector<int> missed;
+   for (size_t ii = 0, iTile = 0; ii < count; ++ii) {
+      const int xx = lowerBoundX + ii;
+      const auto iBlock = blockOfColumn[ii];
+      if (iBlock < 0) {
+         missed.push_back(xx);
+         continue;
+      }
+      while (neededBlocks[iTile] != iBlock)
+         ++iTile;
+      const auto &tile = *tiles[iTile];
+      const auto nColumns = tile.size() / nBins;
+      if (nColumns == 0) {
+         missed.push_back(xx);
+         continue;
+      }
+      const auto offset = (where[xx] + trim - blocks[iBlock].start);
+      const auto column = std::min<size_t>(offset.as_size_t() / hop,
+         nColumns - 1);
+      float *const results = &freq[nBins * xx];
+      std::copy_n(&tile[column * nBins], nBins, results);
+      if (!gainFactors.empty()) {
+         // Apply a frequency-dependent gain factor
+         for (size_t bin = 0; bin < nBins; ++bin)
+            results[bin] += gainFactors[bin];
+      }
+   }
+
+   mSampleCacheHolders.resize(pool.GetConcurrency());
+   pool.ParallelFor(missed.size(), [&](size_t ii, size_t worker) {
+      CalculateOneSpectrum(
+         settings, clip, missed[ii], pixelsPerSecond, lowerBoundX, upperBoundX,
+         gainFactors, &scratch[worker * fftLen], &freq[0], worker);
+   });
+   return true;
+}
+
 void SpecCache::Populate(
    const SpectrogramSettings& settings, const WaveChannelInterval& clip,
-   int copyBegin, int copyEnd, size_t numPixels, double pixelsPerSecond)
+   int copyBegin, int copyEnd, size_t numPixels, double pixelsPerSecond,
+   bool progressive)
 {
+   mCoarseRanges.clear();
+
    const auto sampleRate = clip.GetRate();
    const int &frequencyGainSetting = settings.frequencyGain;
    const size_t windowSizeSetting = settings.WindowSize();
@@ -496,9 +789,13 @@ void SpecCache::Populate(
    const size_t fftLen = windowSizeSetting * zeroPaddingFactorSetting;
    const auto nBins = settings.NBins();
 
-   const size_t bufferSize = fftLen;
-   const size_t scratchSize = reassignment ? 3 * bufferSize : bufferSize;
-   std::vector<float> scratch(scratchSize);
+   // Reassignment is done on this thread only, in three buffers
+   std::vector<float> scratch;
+   if (reassignment) {
+      scratch.resize(3 * fftLen);
+      if (mSampleCacheHolders.empty())
+         mSampleCacheHolders.resize(1);
+   }
 
    std::vector<float> gainFactors;
    if (!autocorrelation)
@@ -511,23 +808,35 @@ void SpecCache::Populate(
       const int lowerBoundX = jj == 0 ? 0 : copyEnd;
       const int upperBoundX = jj == 0 ? copyBegin : numPixels;
 
-      for (auto xx = lowerBoundX; xx < upperBoundX; ++xx)
-      {
-         if (isWaveletAnalysis(settings))
-         {
-             CalculateOneWaveletSpectrum(settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
-                                         gainFactors, &freq[0]);
-         } else
-         {
-            float* buffer = &scratch[0];
-
-            CalculateOneSpectrum(
-               settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
-               gainFactors, buffer, &freq[0]);
+      if (!reassignment) {
+         // Zoomed far out, the spectra of whole blocks may serve
+         if (ComposeColumns(settings, clip, lowerBoundX, upperBoundX,
+               pixelsPerSecond, gainFactors))
+            continue;
+         if (progressive && upperBoundX - lowerBoundX >= ProgressiveColumns) {
+            CalculateColumns(settings, clip, pixelsPerSecond,
+               lowerBoundX, upperBoundX, gainFactors, 0, CoarseStride);
+            // Until refined, repeat each calculated column in the skipped ones
+            for (auto xx = lowerBoundX; xx < upperBoundX; ++xx) {
+               const auto offset = (xx - lowerBoundX) % CoarseStride;
+               if (offset != 0)
+                  std::copy_n(&freq[nBins * (xx - offset)], nBins,
+                     &freq[nBins * xx]);
+            }
+            mCoarseRanges.emplace_back(lowerBoundX, upperBoundX);
          }
+         else
+            CalculateColumns(settings, clip, pixelsPerSecond,
+               lowerBoundX, upperBoundX, gainFactors, 0, 1);
       }
+      else {
+         // Time reassignment adds into neighboring columns, so calculate
+         // in order on this thread
+         for (auto xx = lowerBoundX; xx < upperBoundX; ++xx)
+            CalculateOneSpectrum(
+               settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
+               gainFactors, &scratch[0], &freq[0]);
 
-      if (reassignment) {
          // Need to look beyond the edges of the range to accumulate more
          // time reassignments.
          // I'm not sure what's a good stopping criterion?
@@ -575,6 +884,23 @@ void SpecCache::Populate(
    }
 }
 
+void SpecCache::Refine(
+   const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+   double pixelsPerSecond)
+{
+   const size_t fftLen = settings.WindowSize() * settings.ZeroPaddingFactor();
+   std::vector<float> gainFactors;
+   if (settings.algorithm != SpectrogramSettings::algPitchEAC)
+      ComputeSpectrogramGainFactors(
+         fftLen, clip.GetRate(), settings.frequencyGain, gainFactors);
+
+   for (const auto &[lowerBoundX, upperBoundX] : mCoarseRanges)
+      for (int first = 1; first < CoarseStride; ++first)
+         CalculateColumns(settings, clip, pixelsPerSecond,
+            lowerBoundX, upperBoundX, gainFactors, first, CoarseStride);
+   mCoarseRanges.clear();
+}
+
 auto SpecCache::Start(void) const -> sampleCount {
    return start;
 }
@@ -639,9 +965,19 @@ bool WaveClipSpectrumCache::GetSpectrogram(
    {
       spectrogram = &mSpecCache->freq[0];
 
+      if (mSpecCache->IsCoarse()) {
+         // Second pass of progressive drawing
+         mSpecCache->Refine(settings, clip, pixelsPerSecond);
+         return true;
+      }
+
       return false;  //hit cache completely
    }
 
+   // Don't reuse columns that were not yet calculated
+   if (mSpecCache->IsCoarse())
+      match = false;
+
    // Caching is not implemented for reassignment, unless for
    // a complete hit, because of the complications of time reassignment
    if (settings.algorithm == SpectrogramSettings::algReassignment)
@@ -714,7 +1050,8 @@ bool WaveClipSpectrumCache::GetSpectrogram(
       samplesPerPixel);
 
    mSpecCache->Populate(
-      settings, clip, copyBegin, copyEnd, numPixels, pixelsPerSecond);
+      settings, clip, copyBegin, copyEnd, numPixels, pixelsPerSecond,
+      SpectrogramProgressiveDrawing.Read());
 
    mSpecCache->SetDirty(mDirty);
 
@@ -787,3 +1124,6 @@ void WaveClipSpectrumCache::Erase(size_t index)
    if (index < mSpecPxCaches.size())
       mSpecPxCaches.erase(mSpecPxCaches.begin() + index);
 }
+
+BoolSetting SpectrogramProgressiveDrawing{
+   L"/Spectrum/ProgressiveDrawing", false };
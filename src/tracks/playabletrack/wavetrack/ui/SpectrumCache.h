@@ -19,6 +19,7 @@ class WideSampleSequence;
 
 #include <vector>
 #include "MemoryX.h"
+#include "Prefs.h"
 #include "WaveClip.h" // to inherit WaveClipListener
 
 using Floats = ArrayOf<float>;
@@ -40,9 +41,20 @@ public:
       const WaveChannelInterval& clip);
 
    // Calculate the dirty columns at the begin and end of the cache
+   // If progressive, long ranges may be calculated only at every few
+   // columns, leaving the rest for Refine()
    void Populate(
       const SpectrogramSettings& settings, const WaveChannelInterval& clip,
-      int copyBegin, int copyEnd, size_t numPixels, double pixelsPerSecond);
+      int copyBegin, int copyEnd, size_t numPixels, double pixelsPerSecond,
+      bool progressive = false);
+
+   // Whether some columns were skipped by Populate()
+   bool IsCoarse() const { return !mCoarseRanges.empty(); }
+
+   // Calculate the columns skipped by Populate()
+   void Refine(
+      const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+      double pixelsPerSecond);
 
    void SetDirty(int dirty);
 
@@ -72,21 +84,49 @@ private:
 
    int          mDirty { -1 };
 
+   // Ranges of columns of which Populate() calculated only every
+   // mCoarseStride-th, copying it into those that follow
+   std::vector<std::pair<int, int>> mCoarseRanges;
+
+   // Calculate columns lowerBoundX + first, then every stride-th after,
+   // up to upperBoundX, on several threads; not for reassignment
+   void CalculateColumns(
+      const SpectrogramSettings& settings, const WaveChannelInterval &clip,
+      double pixelsPerSecond, int lowerBoundX, int upperBoundX,
+      const std::vector<float>& gainFactors, int first, int stride);
+
+   // Fill columns from lowerBoundX up to upperBoundX from the spectra of
+   // whole sample blocks, which are kept in memory and in the project;
+   // return false if the settings or zoom level don't allow that
+   bool ComposeColumns(
+      const SpectrogramSettings& settings, const WaveChannelInterval &clip,
+      int lowerBoundX, int upperBoundX, double pixelsPerSecond,
+      const std::vector<float>& gainFactors);
+
    // Calculate one column of the spectrum
+   // worker identifies the thread, which has its own sample cache holder
    bool CalculateOneSpectrum(
       const SpectrogramSettings& settings, const WaveChannelInterval &clip,
       const int xx, double pixelsPerSecond, int lowerBoundX, int upperBoundX,
       const std::vector<float>& gainFactors, float* __restrict scratch,
-      float* __restrict out) const;
+      float* __restrict out, size_t worker = 0) const;
 
    bool CalculateOneWaveletSpectrum(
       const SpectrogramSettings& settings, const WaveChannelInterval &clip,
       const int xx, double pixelsPerSecond, int lowerBoundX, int upperBoundX,
       const std::vector<float>& gainFactors,
-      float* __restrict out) const;
-   mutable std::optional<AudioSegmentSampleView> mSampleCacheHolder;
+      float* __restrict out, size_t worker = 0) const;
+
+   // One per worker thread, keeping the samples of the last column read
+   // in memory for the next
+   mutable std::vector<std::optional<AudioSegmentSampleView>>
+      mSampleCacheHolders;
 };
 
+// Whether to draw spectrograms at reduced resolution first, when much is to be
+// calculated, and fill in the rest at the next paint
+extern TENACITY_DLL_API BoolSetting SpectrogramProgressiveDrawing;
+
 class SpecPxCache {
 public:
    SpecPxCache(size_t cacheLen)
@@ -24,11 +24,13 @@ Paul Licameli split from WaveChannelView.cpp
 #include "../../../ui/BrushHandle.h"
 
 #include "AColor.h"
+#include "BasicUI.h"
 #include "PendingTracks.h"
 #include "Prefs.h"
 #include "NumberScale.h"
 #include "../../../../TrackArt.h"
 #include "../../../../TrackArtist.h"
+#include "../../../../TrackPanel.h"
 #include "../../../../TrackPanelDrawingContext.h"
 #include "ViewInfo.h"
 #include "WaveClip.h"
@@ -39,6 +41,7 @@ Paul Licameli split from WaveChannelView.cpp
 
 #include <wx/dcmemory.h>
 #include <wx/graphics.h>
+#include <wx/weakref.h>
 
 #include "float_cast.h"
 
@@ -416,6 +419,14 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    bool updated = WaveClipSpectrumCache::Get(clip).GetSpectrogram(
       clip, freq, settings, (size_t)mid.width, t0,
       averagePixelsPerSecond);
+   if (artist->parent && WaveClipSpectrumCache::Get(clip)
+          .mSpecCaches[clip.GetChannelIndex()]->IsCoarse())
+      // Paint again soon, to fill in the columns skipped by progressive
+      // drawing
+      BasicUI::CallAfter([wParent = wxWeakRef<TrackPanel>{ artist->parent }]{
+         if (wParent)
+            wParent->Refresh(false);
+      });
    auto nBins = settings.NBins();
 
    float minFreq, maxFreq;